@@ -1,1592 +1,10117 @@
-/*************************
- * @author: Nicole Berty
- * All the header files are listed first, then all the cpp files. Each file's name is in a single comment, eg. //game.cpp
- * Each concept is marked like this in the code: //1. Destructors
- * Here is a list of each concept and where they are implemented:
- * 1. Destructors:
- *          - enemy.h/enemy.cpp (declared and defined)
- *          - player.h/player.cpp (declared and defined)
- *          - character.h/character.cpp (declared and defined)
- * 2. Inheritance (including virtual methods) and cascading constructors
- *          - character.h/character.cpp (base class)
- *          - player.h/player.cpp (derived class of Character)
- *          - enemy.h/enemy.cpp (derived class of Character)
- *          - item.h/item.cpp (base class)
- *          - weapon.h/weapon.cpp (derived class of Item)
- * 3. Templates
- *          - item.h/item.cpp (method setWeight(const T& weight) declared and defined)
- * 4. Unary Operator Overloading
- *          - player.h/player.cpp (declared and defined)
- *          - game.cpp (example usage)
- * 5. Binary Operator Overloading
- *          - enemy.h/enemy.cpp (declared and defined)
- *          - item.h/item.cpp (declared and defined)
- *          - room.cpp (examples of enemy and item binary operator usage)
- * 6. Friends
- *          - character.h (friend class Game)
- *          - enemy.h (friend function operator==)
- *          - item.h (friend function operator==)
- *          - room.h (friend classes Game, enterRoomListener)
- * 7. Virtual functions and polymorphism
- *          - item.h (base class, virtual function getLongDescription())
- *          - weapon.h/weapon.cpp (derived class, different implementation of virtual function getLongDescription())
- *          - player.cpp (example of runtime polymorphism occurring in getItems() function)
- *              (declaration Item *sword = new Weapon() is in game.h/.cpp)
- * 8. Abstract classes and pure virtual functions
- *          - character.h/character.cpp (is abstract base class, has 2 pure virtual functions setHealth and setStamina)
- *          - enemy.h/enemy.cpp (derived class, has implementation of pure virtual functions setHealth and setStamina)
- *          - player.h/player.cpp (derived class, has implementation of pure virtual functions setHealth and setStamina)
- * 9. Initialiser List
- *          - character.cpp
- *          - enemy.cpp
- *          - item.cpp
- *          - player.cpp
- *          - weapon.cpp
- * 10. Dynamic and static dispatch
- *          - item.h/item.cpp (base class, virtual function getLongDescription() declared and defined)
- *          - weapon.h/weapon.cpp (derived class, different implementation of virtual function getLongDescription())
- *          - player.cpp (example of dynamic dispatch occurring in getItems() function)
- *  
- * ***********************/
-
-#include<string>
-#include <map>
-#include <iostream>
-#include <math.h>
-#include <vector>
-#include <algorithm>
-#include<cstdlib> 
-#include<ctime>
-using namespace std;
-
-// EventListener.h
-/** Parent class of all listeners. (It is abstract and can't be instantiated) */
-class EventListener
-{
-public:
-    // "void *" is a generic pointer to anything!
-    // 10x worse than regular pointers in potential problems
-    virtual void run(void *args) = 0;
-};
-
-//attacklistener.h
-class Game;
-
-class AttackListener : public EventListener
-{
-public:
-    AttackListener(Game *game);
-    void run(void *args) override;
-private:
-    Game  *game;
-    string enemyName;
-};
-
-//character.h
-// No need to include room since we're only working with pointers.
-// This is how we tell the compiler "there will be a room eventually".
-// This is called a "forward declaration".
-class Room;
-
-//2. Inheritance (including virtual methods) and cascading constructors (Base Class)
-class Character
-{
-public:
-
-    string getName();
-    int    getHealth();
-
-    //6. Friends
-    friend class Game;
-
-protected:
-    Character(string name);
-    ~Character();
-    string name;
-    int health;
-    int stamina;
-    Room *currentRoom;
-
-    int    getStamina();
-    Room  *getCurrentRoom();
-
-    void setName(string name);
-    void setCurrentRoom(Room *next); 
-
-    //8. Abstract classes and pure virtual functions
-    virtual void setHealth(int setHealth) = 0;
-    virtual void setStamina(int stamina) = 0;
-};
-
-//characterdeathlistener.h
-
-class Game;
-// A listener for the bad ending
-class CharacterDeathListener : public EventListener
-{
-public:
-    CharacterDeathListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-//curselistener.h
-class Game;
-
-// A listener for the cursed item being picked up
-class CurseListener : public EventListener
-{
-public:
-    CurseListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-//defeatlistener.h
-class Game;
-
-// A listener for the bad ending
-class DefeatListener : public EventListener
-{
-public:
-    DefeatListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-//enemy.h
-
-//2. Inheritance (including virtual methods) and cascading constructors
-class Enemy : public Character
-{
-public:
-    Enemy(string name, string description);
-
-    //1. Destructors
-    ~Enemy();
-
-    //8. Abstract classes and pure virtual functions (derived class)
-    virtual void setHealth(int setHealth);
-    virtual void setStamina(int stamina);
-
-    void setDescription(string description);
-    string getDescription();
-
-private:
-    string description;
-    
-    //5. Binary Operator Overloading
-    //6. Friends
-    friend bool operator== (const Enemy &e1, const Enemy &e2);
-};
-
-//enterroomlistener.h
-class Game;
-
-// A listener for the good ending
-class EnterRoomListener : public EventListener
-{
-public:
-    EnterRoomListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-// EventManager.h (Implemented as a Singleton)
-/** This class manages the event loop and all the event calls */
-struct EventManager // Structs in C++ are the same as classes, but default to "public" instead of "private".
-{
-    // static inside a class or struct works exactly like in java
-    // Only one instance per class.
-    static EventManager &getInstance(); // Gets an instance of the class (an object)
-
-    // Making sure I can't have copies of this instance.
-    EventManager(EventManager const& copy);            // Not Implemented (Copy constructor)
-    EventManager& operator=(EventManager const& copy); // Not Implemented (Assignment operator)
-
-    // Registers an event.
-    void listen(string event_name, EventListener *listener);
-
-    // Emits an event
-    // "void *" is a generic pointer to anything.
-    // !!! Highly unsafe, please don't do this at home without the presence of your parents !!!
-    void trigger(string event_name, void *args = nullptr);
-
-    // Returns true if still running
-    bool is_running();
-
-    // Stops the event loop
-    void stop();
-
-    // Reads the input and calls an input event
-    void check_events();
-
-    // constantly checks for new inputs until the program ends.
-    void event_loop();
-
-private:
-    // True if running
-    bool running;
-
-    // map<K, V> is a collection of V's indexed by S.
-    // In this case, we have lists/vectors of events indexed by their names.
-    map<string, vector<EventListener*>> registeredEvents;
-
-    // Only EventManager can call the constructor, so the only way to get an instance
-    // is by calling getInstance.
-    EventManager();
-};
-
-//exitlistener.h
-class Game;
-
-// A listener for the exit command
-class ExitListener : public EventListener
-{
-public:
-    ExitListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-//item.h
-class Item {
-protected:
-	string description;
-	float weightGrams;
-	int multiplier;
-
-public:
-    Item (string description, float inWeight, int multiplier = 0);
-	float getWeight();
-	int getMultiplier();
-	string getShortDescription();
-
-	//7. Virtual functions and polymorphism
-	//10. Dynamic and static dispatch (derived class is weapon.h)
-	virtual string getLongDescription();
-
-	//3. Templates
-	template <typename T>
-	void setWeight(const T& weightGrams);
-
-	//5. Binary Operator Overloading
-	//6. Friends
-	friend bool operator== (const Item &item1, const Item &item2);
-};
-
-//player.h
-
-//2. Inheritance (including virtual methods) and cascading constructors
-class Player : public Character
-{
-public:
-    Player(string newName);
-
-    //1. Destructors
-    ~Player();
-
-    vector < Item* > itemInventory;
-
-    //8. Abstract classes and pure virtual functions (derived class)
-    virtual void setHealth(int setHealth);
-    virtual void setStamina(int stamina);
-
-    void addItem(Item*);
-    void emptyInventory();
-    void removeItem(Item*);
-    string getItems();
-    bool hasItem(string); 
-
-    //4. Unary Operator Overloading
-    void operator--();
-    void operator++();
-};
-
-//game.h
-class Game
-{
-public:
-    Game();
-    void reset(bool show_update = true);
-
-    void map();
-    void info();
-    void go(string direction);
-    void teleport();
-    void take(string itemName);
-    void use(string itemName);
-    void inventory();
-    void attack(string name);
-    void enemyMove();
-
-    void update_screen();
-
-    Player &getPlayer();
-    void setOver(bool over);
-    bool is_over();
-    void setCurrentRoom(Room *next);
-
-private:
-    Player      player;
-    vector<Room *> rooms;
-    bool           gameOver;
-    Enemy          mojo;
-    Item           *key;
-    Item           *sword;
-    
-    bool        enemyCheck();
-};
-
-//golistener.h
-class Game;
-
-// A listener for the Go command
-class GoListener : public EventListener
-{
-public:
-    GoListener(Game *game);
-    void run(void *args) override;
-private:
-    Game  *game;
-    string direction;
-};
-
-//infolistener.h
-class Game;
-
-class InfoListener : public EventListener
-{
-public:
-    InfoListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-//inputlistener.h
-// No need to include if we're just using pointers.
-class Game;
-
-// A listener that gets called when a new input is received.
-struct InputListener : EventListener // Structs default to public even in inheritance.
-{
-    InputListener(Game *game);
-    void run(void *args) override;
-
-private:
-    // We store a game pointer for easy access.
-    Game *game;
-    vector<string> args;
-};
-
-//inventorylistener.h
-class Game;
-
-// A listener for the Inventory command
-class InventoryListener : public EventListener
-{
-public:
-    InventoryListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-//maplistener.h
-class Game;
-// A listener for the map command
-class MapListener : public EventListener
-{
-public:
-    MapListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-//restartlistener.h
-class Game;
-
-// A listener for the good ending
-class RestartListener : public EventListener
-{
-public:
-    RestartListener(Game *game);
-    void run(void *args) override;
-private:
-   Game *game;
-};
-
-//room.h
-class Room
-{
-private:
-    string name;
-    map<string, Room *> exits;
-
-    Room(string name);
-    vector<Item*> itemsInRoom;
-    vector<Enemy*> enemiesInRoom;
-
-    int numberOfItems();
-    vector<Item*> getItems();
-    void addItem(Item *inItem);
-    void removeItem(Item*);
-    string displayItems();
-    string getName();
-    void setExits(Room *north, Room *east, Room *south, Room *west);
-    Room *getExit(string direction);
-    bool hasItem(Item*);
-    bool hasEnemy(Enemy*);
-
-    vector<Enemy*>getEnemies();
-    void addEnemy(Enemy *enemy);
-    string displayEnemies();
-    void removeEnemy(Enemy*);
-
-    public:
-    
-    //6. Friends
-    friend class Game;
-    friend class EnterRoomListener;
-};
-
-//takelistener.h
-class Game;
-// A listener for the Take command
-class TakeListener : public EventListener
-{
-public:
-    TakeListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-    string itemName;
-};
-
-//teleportlistener.h
-class Game;
-// A listener for the Teleport command
-class TeleportListener : public EventListener
-{
-public:
-    TeleportListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-};
-
-//uselistener.h
-class Game;
-
-// A listener for the Use command
-class UseListener : public EventListener
-{
-public:
-    UseListener(Game *game);
-    void run(void *args) override;
-private:
-    Game *game;
-    string itemName;
-};
-
-//victorylistener.h
-class Game;
-// A listener for the good ending
-class VictoryListener : public EventListener
-{
-public:
-    VictoryListener(Game *game);
-    void run(void *args) override;
-private:
-   Game *game;
-};
-
-//weapon.h
-//2. Inheritance (including virtual methods) and cascading constructors
-class Weapon : public Item {
-
-public:
-
-    Weapon (string description, float inWeight, int multiplier);
-
-//7. Virtual functions and polymorphism
-//10. Dynamic and static dispatch
-    virtual string getLongDescription();
-
-};
-
-//attacklistener.cpp
-AttackListener::AttackListener(Game *game)
-{
-    this->game = game;
-    enemyName = "";
-}
-
-void AttackListener::run(void *args_ptr)
-{
-    if (game->is_over()) {
-        return;
-    }
-
-    vector<string> *args = (vector<string> *) args_ptr;
-
-    if (args->size() > 1) {
-        game->attack(args->at(1));
-    } else {
-        cout << "Need to specify an enemy to attack!" << endl;
-    }
-}
-
-//character.cpp
-
-//9. Initializer list
-Character::Character(string name) : name(name)
-{ 
-    health      = 100;
-    stamina     = 100;
-    currentRoom = nullptr;
-    cout << "Character created (base class)" << endl;
-}
-
-//1. Destructors 
-Character::~Character() {
-  cout << "Character destructor: Goodbye cruel world!" << endl;
-}
-
-string Character::getName()
-{
-    return name;
-}
-
-int Character::getHealth()
-{
-    return health;
-}
-
-int Character::getStamina()
-{
-    return stamina;
-}
-
-Room *Character::getCurrentRoom()
-{
-    return currentRoom;
-}
-
-void Character::setName(string name)
-{
-    this->name = name;
-}
-
-void Character::setCurrentRoom(Room *next)
-{
-    currentRoom = next;
-}
-
-//characterdeathlistener.cpp
-
-CharacterDeathListener::CharacterDeathListener(Game *game)
-{
-    this->game = game;
-}
-
-void CharacterDeathListener::run(void *args)
-{
-    if (game->is_over()) {
-        return;
-    }
-
-    Player *character = (Player *) args;
-
-    if (character->getName() == game->getPlayer().getName()) {
-        EventManager::getInstance().trigger("defeat");
-    }
-}
-
-//curselistener.cpp
-CurseListener::CurseListener(Game *game)
-{
-    this->game = game;
-}
-
-void CurseListener::run(void *args)
-{
-    Player *player1 = (Player *) args;
-    player1->setHealth(player1->getHealth() - 20);
-    cout << "You've lost some health points due to the cursed item." << endl;
-}
-
-//defeatlistener.cpp
-DefeatListener::DefeatListener(Game *game)
-{
-    this->game = game;
-}
-
-void DefeatListener::run(void *)
-{
-    cout << endl;
-    cout << "Defeat!" << endl;
-    game->setOver(true);
-}
-
-//enemy.cpp
-
-//2. Inheritance (including virtual methods) and cascading constructors
-//9. Initializer list
-Enemy::Enemy(string name, string description) : Character(name), description(description)
-{
-    cout << "Enemy created (child class)" << endl;
-}
-
-//1. Destructors
-Enemy::~Enemy() {
-    cout << "Enemy destructor: Bye bye" << endl;
-}
-
-string Enemy::getDescription()
-{
-    return description;
-}
-
-//8. Abstract classes and pure virtual functions
-void Enemy::setDescription(string description)
-{
-    this->description = description;
-}
-
-//8. Abstract classes and pure virtual functions
-void Enemy::setHealth(int health)
-{
-    if (health <= 0) {
-        health = 0;
-    }
-
-    this->health = health;
-}
-
-void Enemy::setStamina(int stamina)
-{
-    if (stamina <= 0) {
-        stamina = 0;
-    }
-
-    this->stamina = stamina;
-}
-
-//5. Binary Operator Overloading
-bool operator==(const Enemy &e1, const Enemy &e2) {
-    return e1.name == e2.name;
-}
-
-//enterroomlistener.cpp
-
-EnterRoomListener::EnterRoomListener(Game *game)
-{
-    this->game = game;
-}
-
-void EnterRoomListener::run(void *args)
-{
-    if (game->is_over()) {
-        return;
-    }
-
-    Room *room = (Room *) args;
-
-    if (room->getName() == "J") {
-        EventManager::getInstance().trigger("victory");
-    }
-}
-
-//eventmanager.cpp
-/** Converts strings from UPPERCASE or MiXedCasE to lowercase. */
-// This is a regular old C-style function not a method.
-string tolower(string &s)
-{
-    string ns;
-    for (auto c : s) {
-        ns += tolower(c);
-    }
-    return ns;
-}
-
-EventManager::EventManager()
-{
-    running = true;
-}
-
-EventManager &EventManager::getInstance()
-{
-    // static inside functions creates an instance of this variable for all the calls of this function, and initializes only once.
-    static EventManager instance;
-    return instance;
-}
-
-void EventManager::listen(string event_name, EventListener *listener)
-{
-    registeredEvents[tolower(event_name)].push_back(listener);
-}
-
-void EventManager::trigger(string event_name, void *args)
-{
-    for (auto listener : registeredEvents[tolower(event_name)]) {
-        listener->run(args);
-    }
-}
-
-bool EventManager::is_running()
-{
-    return running;
-}
-
-void EventManager::stop()
-{
-    running = false;
-}
-
-void EventManager::check_events()
-{
-    string buffer;
-    vector<string> words;
-
-    cout << "> ";               // print prompt
-    getline(cin, buffer, '\n');	// read a line from cin to "buffer"
-    buffer = tolower(buffer);
-
-    string::size_type pos = 0, last_pos = 0;
-
-    // Break "buffer" up by spaces
-    bool finished = false;
-    while (!finished) {
-        pos = buffer.find_first_of(' ', last_pos);	// find and remember first space.
-        if (pos == string::npos ) {			// if we found the last word,
-            words.push_back(buffer.substr(last_pos));	// add it to vector "words"
-            finished = true;				// and finish searching.
-        } else {					// otherwise add to vector and move on to next word.
-            words.push_back(buffer.substr(last_pos, pos - last_pos));
-            last_pos = pos + 1;
-        }
-    }
-
-    trigger("input", &words);
-}
-
-void EventManager::event_loop()
-{
-    EventManager &eventManager = EventManager::getInstance();
-
-    while (eventManager.is_running()) {
-        eventManager.check_events();
-    }
-}
-
-//exitlistener.cpp
-
-ExitListener::ExitListener(Game *game)
-{
-    this->game = game;
-}
-
-void ExitListener::run(void *)
-{
-    EventManager::getInstance().stop();
-}
-
-//player.cpp
-
-//2. Inheritance (including virtual methods) and cascading constructors
-//9. Initializer list
-Player::Player(string newName): Character(newName) {
-    cout << "Player created (child class)" << endl;
-}
-
-
-//1. Destructors
-Player::~Player() {
-    cout << "Player destructor: The end is nigh" << endl;
-}
-
-//8. Abstract classes and pure virtual functions
-void Player::setHealth(int health)
-{
-    if (health <= 0) {
-        health = 0;
-        EventManager::getInstance().trigger("characterDeath", this);
-    }
-
-    this->health = health;
-}
-
-//8. Abstract classes and pure virtual functions
-void Player::setStamina(int stamina)
-{
-    if (stamina <= 0) {
-        stamina = 0;
-        EventManager::getInstance().trigger("characterDeath", this);
-    }
-
-    this->stamina = stamina;
-}
-
-string Player::getItems() { 
-    string ret = "\nInventory:\n";
-    for (vector<Item*>::iterator it = itemInventory.begin(); it != itemInventory.end(); it++)
-    //7. Virtual Functions and Polymorphism (example of runtime polymorphism occurring)
-    //10. Dynamic and static dispatch
-    //(Item has virtual func getLongDescription, weapon inherits from Item and overrides this method)
-        ret += "\t"+ (*it)->getLongDescription() + "\n";
-    return ret;
-}
-
-void Player::addItem(Item *newItem) {
-    if (! (std::find(itemInventory.begin(), itemInventory.end(), newItem) != itemInventory.end() )) {
-        itemInventory.push_back(newItem);
-        std::cout << "You have picked up a new item! It has been added to your inventory.\n"; 
-    }
-}
-
-bool Player::hasItem(string item) {
-    for (unsigned int i = 0; i < itemInventory.size(); i++) {
-        if (itemInventory.at(i)->getShortDescription().compare(item) == 0) {
-                return true;
-        }
-    }
-    return false;
-}
-
-void Player::emptyInventory() { this->itemInventory.clear(); }
-
-void Player::removeItem(Item *newItem) {
-        for (unsigned int i = 0; i < itemInventory.size(); i++) {
-            //5. Binary Operator Overloading (Item class)
-            if(itemInventory.at(i) == newItem) {
-                itemInventory.erase(itemInventory.begin() + i);
-            }
-        }
-}
-
-//4. Unary Operator Overloading
-void Player::operator--() {
-    health = health - 20;
-}
-
-//4. Unary Operator Overloading
-void Player::operator++() {
-    health = health + 20;
-}
-
-//game.cpp
-Game::Game() :
-    player("Hero"),
-    mojo("mojo", "is a moving enemy")
-{
-    srand(time(nullptr));
-    
-    // Commands
-    EventManager::getInstance().listen("go",        new GoListener(this));
-    EventManager::getInstance().listen("map",       new MapListener(this));
-    EventManager::getInstance().listen("info",      new InfoListener(this));
-    EventManager::getInstance().listen("restart",   new RestartListener(this));
-    EventManager::getInstance().listen("teleport",  new TeleportListener(this));
-    EventManager::getInstance().listen("exit",      new ExitListener(this));
-    EventManager::getInstance().listen("take",      new TakeListener(this));
-    EventManager::getInstance().listen("use",       new UseListener(this));
-    EventManager::getInstance().listen("inventory", new InventoryListener(this));
-    EventManager::getInstance().listen("attack",    new AttackListener(this));
-
-    // State changes
-    EventManager::getInstance().listen("characterDeath", new CharacterDeathListener(this));
-    EventManager::getInstance().listen("enterRoom",      new EnterRoomListener(this));
-    EventManager::getInstance().listen("victory",        new VictoryListener(this));
-    EventManager::getInstance().listen("defeat",         new DefeatListener(this));
-    EventManager::getInstance().listen("curse",          new CurseListener(this));
-
-    rooms.push_back(new Room("A")); // 0
-    rooms.push_back(new Room("B")); // 1
-    rooms.push_back(new Room("C")); // 2
-    rooms.push_back(new Room("D")); // 3
-    rooms.push_back(new Room("E")); // 4
-    rooms.push_back(new Room("F")); // 5
-    rooms.push_back(new Room("G")); // 6
-    rooms.push_back(new Room("H")); // 7
-    rooms.push_back(new Room("I")); // 8
-    rooms.push_back(new Room("J")); // 9
-
-    //                 N         E         S         W
-    rooms[0]->setExits(rooms[4], rooms[2], rooms[7], rooms[1]);
-    rooms[1]->setExits(nullptr,  rooms[0], nullptr,  nullptr);
-    rooms[2]->setExits(nullptr,  nullptr,  nullptr,  rooms[0]);
-    rooms[3]->setExits(nullptr,  rooms[4], nullptr,  nullptr);
-    rooms[4]->setExits(nullptr,  rooms[5], rooms[0], rooms[3]);
-    rooms[5]->setExits(nullptr,  nullptr,  nullptr,  rooms[4]);
-    rooms[6]->setExits(nullptr,  rooms[7], nullptr,  nullptr);
-    rooms[7]->setExits(rooms[0], rooms[8], rooms[9], rooms[6]);
-    rooms[8]->setExits(nullptr,  nullptr,  nullptr,  rooms[7]);
-    rooms[9]->setExits(rooms[7], nullptr,  nullptr,  nullptr);
-
-    reset();
-}
-
-void Game::reset(bool show_update)
-{
-    gameOver = false;
-
-    for (unsigned int i = 0; i < rooms.size(); i++) {
-          rooms.at(i)->itemsInRoom.clear();  
-          rooms.at(i)->enemiesInRoom.clear();
-    }
-        
-    key = new Item("key", 22);
-    key->setWeight(27);
-    rooms[2]->addItem(key);
-    rooms[6]->addItem(new Item("cursed_item", 15.56));
-    rooms[3]->addItem(new Item("potion", 10.25));
-
-    sword = new Weapon("sword", 150, 5);
-    rooms[5]->addItem(sword);
-
-    rooms[2]->addEnemy(new Enemy("stationary-man", "is a non-moving enemy"));
-    
-    mojo.setCurrentRoom(rooms[3]);
-    mojo.setHealth(100);
-    mojo.setStamina(100);
-
-    player.setCurrentRoom(rooms[0]);
-    player.setHealth(100);
-    player.setStamina(100);
-
-    player.emptyInventory();
-    
-    cout << "Welcome to Zork!" << endl;
-    cout << "To pick up items, type take x where x is the name of the item exactly as it is written in the room description, eg. take cursed_item\n";
-    cout << "To attack enemies, type attack x where x is the enemy name exactly as it is\nwritten in the room description" << endl;
-    if (show_update) {
-        update_screen();
-    }
-}
-
-void Game::setOver(bool over)
-{
-    this->gameOver = over;
-}
-
-void Game::map()
-{
-    cout << "Subtitle: [player] !enemy! [player & Enemy!" << endl;
-
-    vector<string> roomNames= {" A ", " B ", " C ", " D ", " E ", " F ", " G ", " H ", " I ", " J "};
-
-    for (int i = 0; i < roomNames.size(); i++)
-    {
-        if (player.getCurrentRoom() == rooms.at(i))
-        {
-            roomNames.at(i) = "[" + rooms.at(i)->getName() + "]";
-        }
-        if (mojo.getCurrentRoom() == rooms.at(i) && enemyCheck()) {
-            roomNames.at(i) = "!" + rooms.at(i)->getName() + "!";
-        }
-        if (rooms.at(i)->getEnemies().size() > 0) {
-            roomNames.at(i) = "!" + rooms.at(i)->getName() + "!";
-        }
-        if(player.getCurrentRoom() == rooms.at(i) && ((mojo.getCurrentRoom() == rooms.at(i) && enemyCheck()) || rooms.at(i)->getEnemies().size() > 0)) {
-            roomNames.at(i) = "[" + rooms.at(i)->getName() + "!";
-        }
-    }
-    cout << " " << roomNames.at(3) << " -  " << roomNames.at(4) << "  - " << roomNames.at(5) << endl;
-    cout << "         |   " << endl;
-    cout << " " << roomNames.at(1) << " -  " << roomNames.at(0) << "  - " << roomNames.at(2) << endl;
-    cout << "         |    " << endl;
-    cout << " " << roomNames.at(6) << " -  " << roomNames.at(7) << "  - " << roomNames.at(8) << endl;
-    cout << "         |    " << endl;
-    cout << "        "<< roomNames.at(9) << endl;
-}
-
-void Game::info()
-{
-    cout << "Available commands:" << endl;
-    cout << " - go <direction>"   << endl;
-    cout << " - teleport"         << endl;
-    cout << " - take <itemName>"  << endl;
-    cout << " - inventory"        << endl;
-    cout << " - map"              << endl;
-    cout << " - info"             << endl;
-    cout << " - attack <enemyName>" << endl;
-    cout << " - use <itemName>" << endl;
-    cout << endl;
-    cout << "The more items you have in your inventory, the more stamina you use when you move!" << endl;
-    cout << "If you have a weapon, you will be more likely to hurt the enemy when attacking" << endl;
-}
-
-bool Game::enemyCheck() {
-    if(mojo.getHealth() <= 0 || mojo.getStamina() <= 0) {
-        return false;
-    }
-    return true;
-}
-
-void Game::enemyMove() {
-    if(enemyCheck()) {
-        string direction = "";
-        Room *enemyNext = mojo.getCurrentRoom()->getExit(direction);
-
-        while(enemyNext == nullptr) {
-            int random = rand() % 4;
-            string directions[4] = {"north", "east", "south", "west"};
-            enemyNext = mojo.getCurrentRoom()->getExit(directions[random]);
-        }
-        mojo.setCurrentRoom(enemyNext);
-        mojo.setStamina(mojo.getStamina() - 4);
-        if(!enemyCheck()) {
-            cout << "An enemy died due to a lack of stamina!";
-        }
-    }
-}
-
-void Game::go(string direction)
-{
-    Room *next = player.getCurrentRoom()->getExit(direction);
-
-    if(next == rooms[6] && !(player.hasItem("key"))) {
-        cout << "You need a key to enter this room." << endl;
-        cout << "Search for it in another room and then you can enter this one." << endl;
-    } else {
-        if (next != nullptr) {
-            enemyMove();
-            player.setCurrentRoom(next);
-            if(player.itemInventory.size() > 0) {
-                double sumWeight = 0;
-                for(unsigned int i = 0; i < player.itemInventory.size(); i++) {
-                    sumWeight += player.itemInventory.at(i)->getWeight();
-                }
-                if(sumWeight > 100) {
-                    player.setStamina(player.getStamina() - 7);
-                } else if(sumWeight >= 30) {
-                    player.setStamina(player.getStamina() - 5);
-                } else {
-                    player.setStamina(player.getStamina() - 3);
-                }
-            } else {
-                player.setStamina(player.getStamina() - 1);
-            }
-            EventManager::getInstance().trigger("enterRoom", next);
-        } else {
-            cout << "You hit a wall" << endl;
-        }
-    }
-}
-
-void Game::teleport()
-{
-    int selected = rand() % rooms.size();
-    while(rooms[selected] == rooms [6] && !(player.hasItem("key"))) {
-        selected = rand() % rooms.size();
-    }
-    player.setCurrentRoom(rooms[selected]);
-    player.setStamina(player.getStamina() - 30);
-    EventManager::getInstance().trigger("enterRoom", rooms[selected]);
-
-    enemyMove();
-}
-
-void Game::use(string itemName) {
-    if(itemName.compare("potion") == 0 && player.getHealth() <= 80) {
-        //4. Unary operator overloading (example)
-        ++player;
-        cout << "You have used a replenishing potion!" << endl;
-    } else {
-        cout << "You must have 80 or less health points to use the health potion." << endl;
-    }
-}
-
-void Game::take(string itemName) {
-    vector<Item*> items = player.getCurrentRoom()->getItems();
-    if(items.size() == 0) {
-           cout << "No items in room.";
-    } else {
-            for(unsigned int i = 0; i < items.size(); i++) {
-                if(items.at(i)->getShortDescription().compare(itemName) == 0) {
-                    Item *newItem = (Item *) items.at(i);
-                    player.addItem(newItem);
-                    player.getCurrentRoom()->removeItem(newItem);
-                    if(newItem->getShortDescription().compare("cursed_item") == 0) {
-                        cout << "Oh no! You've picked up a cursed item.\n" << endl;
-                        EventManager::getInstance().trigger("curse", &player);
-                    }
-                    if(newItem->getShortDescription().compare("potion") == 0) {
-                        this->use("potion");
-                    }
-                }
-            }
-    }    
-    cout << player.getItems() << endl;
-}
-
-void Game::attack(string name) {
-    vector<Enemy*> enemies = player.getCurrentRoom()->getEnemies();
-    int winner;
-       if(enemies.size() > 0 || (mojo.getCurrentRoom() == player.getCurrentRoom() && enemyCheck())) {
-            if(player.hasItem("sword")) {
-                winner = (rand() % 20) + sword->getMultiplier();
-            } else {
-               winner = rand() % 20;
-            }
-            if(winner < 10) {
-                //4. Unary Operator Overloading (example)
-                --player;
-                if(player.getHealth() <= 0) player.setHealth(0);
-                    cout << "\nYou were injured by the enemy!\n";
-                } else {
-                    if(name.compare("mojo") == 0 && mojo.getCurrentRoom() == player.getCurrentRoom() && enemyCheck()) {
-                        mojo.setHealth(mojo.getHealth() - 15);
-                        if(enemyCheck()) {
-                            cout << "\nYou injured the enemy!\n";
-                        } else {
-                            cout << "\nYou killed the enemy!\n"; 
-                        }
-                    } else {
-                        for(unsigned int i = 0; i < enemies.size(); i++) {
-                            if(enemies.at(i)->getName().compare(name) == 0 ) {
-                                enemies.at(i)->setHealth(enemies.at(i)->getHealth() - 20);
-                                if(enemies.at(i)->getHealth() <= 0) {
-                                    player.getCurrentRoom()->removeEnemy(enemies.at(i));
-                                    cout << "\nYou killed the enemy!\n";
-                                } else {
-                                    cout << "\nYou injured the enemy!\n";
-                                }
-                            }
-                        }
-                    } 
-                }
-        
-        } else {
-            cout << "\nNo enemies to attack\n";
-    }
-}
-
-void Game::inventory()
-{
-    cout << player.getItems() << endl;
-}
-
-bool Game::is_over()
-{
-    return gameOver;
-}
-
-Player &Game::getPlayer()
-{
-    return player;
-}
-
-void Game::update_screen()
-{
-    if (!gameOver) {
-        Room *currentRoom = player.getCurrentRoom();
-
-        cout << endl;
-        cout << "You are in " << currentRoom->getName() << endl;
-        cout << player.getCurrentRoom()->displayItems() << endl;
-        
-        vector<Enemy*> enemies = player.getCurrentRoom()->getEnemies();
-        cout << "Enemies in room = ";
-        if(enemies.size() != 0) {
-          for(unsigned int i = 0; i < enemies.size(); i++) {
-            cout << enemies.at(i)->getName() << " - ";
-            cout << "HP: " << enemies.at(i)->getHealth() << " ST: " << enemies.at(i)->getStamina() << "     ";
-          }
-          if(player.getCurrentRoom() == mojo.getCurrentRoom()) {
-                if(enemyCheck()) {
-                    cout << "Mojo - HP: " << mojo.getHealth() << " ST: " << mojo.getStamina();
-                } else {
-                    cout << "";
-                }
-            }
-            cout << endl;
-        } else {
-            if(player.getCurrentRoom() != mojo.getCurrentRoom()) {
-                cout << "none" << endl;
-            } else {
-                if(enemyCheck()) {
-                    cout << "Mojo - HP: " << mojo.getHealth() << " ST: " << mojo.getStamina() << endl;
-                } else {
-                    cout << "none" << endl;
-                }
-            }
-        }
-
-        cout << "Exits:";
-        if (currentRoom->getExit("north") != nullptr) { cout << " north"; }
-        if (currentRoom->getExit("east")  != nullptr) { cout << " east";  }
-        if (currentRoom->getExit("south") != nullptr) { cout << " south"; }
-        if (currentRoom->getExit("west")  != nullptr) { cout << " west";  }
-        cout << endl;
-
-        cout << "HP: " << player.getHealth() << " ST: " << player.getStamina() << endl;
-
-    } else {
-        cout << "Type \"restart\" or \"exit\"." << endl;
-    }
-}
-
-
-//golistener.cpp
-GoListener::GoListener(Game *game)
-{
-    this->game = game;
-    direction  = "";
-}
-
-void GoListener::run(void *args_ptr)
-{
-    if (game->is_over()) {
-        return;
-    }
-
-    vector<string> *args = (vector<string> *) args_ptr;
-
-    if (args->size() > 1) {
-        game->go(args->at(1));
-    } else {
-        cout << "Need a direction!" << endl;
-    }
-}
-
-//infolistener.cpp
-InfoListener::InfoListener(Game *game)
-{
-    this->game = game;
-}
-
-void InfoListener::run(void *)
-{
-    game->info();
-}
-
-//inputlistener.cpp
-
-InputListener::InputListener(Game *game)
-{
-    this->game = game;
-}
-
-void InputListener::run(void *args_ptr)
-{
-    // Let's make this thing a bit safer by "translating" the pointer back to what we expect
-    // This is exactly what makes this "void *" pointer dangerous.
-    vector<string> *args = (vector<string> *) args_ptr;
-
-    EventManager &eventManager = EventManager::getInstance();
-
-    if (args->size() > 0) {
-        // If arg[0] is "input", we are going to ignore the input.
-        // If we do not ignore the input, it's an infinite loop.
-        if (args->at(0) == "input") {
-            return;
-        }
-
-        eventManager.trigger(args->at(0), args);
-
-        if (eventManager.is_running()) {
-            game->update_screen();
-        }
-    } else {
-        eventManager.trigger("no_command", nullptr);
-    }
-}
-
-//inventorylistener.cpp
-InventoryListener::InventoryListener(Game *game)
-{
-    this->game = game;
-}
-
-void InventoryListener::run(void *args_ptr)
-{
-    game->inventory();
-}
-
-//item.cpp
-//9. Initializer list
-Item::Item (string inDescription, float inWeightGrams, int multiplier) : description(inDescription), multiplier(multiplier) {
-	setWeight(inWeightGrams);
-}
-
-//3. Templates
-template <typename T>
-void Item::setWeight(const T& inWeightGrams)
-{
-    if (inWeightGrams > 9999 || inWeightGrams < 0)
-       cout << "weight invalid, must be 0<weight<9999" ;
-    else
-	   weightGrams = inWeightGrams;
-}
-template void Item::setWeight<int>(const int&);
-template void Item::setWeight<float>(const float&);
-
-float Item::getWeight() {
-    return weightGrams;
-}
-
-int Item::getMultiplier() {
-    return multiplier;
-}
-
-string Item::getShortDescription()
-{
-	return description;
-}
-
-string Item::getLongDescription()
-{
-    string temp = to_string(getWeight());
-    temp.erase(temp.find_last_not_of('0') + 1, std::string::npos);
-    temp.erase(temp.find_last_not_of('.') + 1, std::string::npos );
-    return description + ", weight: " + temp + "g.\n";
-}
-
-//5. Binary Operator Overloading
-bool operator==(const Item &item1, const Item &item2) {
-    return item1.description == item2.description;
-}
-
-//maplistener.cpp
-
-MapListener::MapListener(Game *game)
-{
-    this->game = game;
-}
-
-void MapListener::run(void *)
-{
-    game->map();
-}
-
-//restartlistener.cpp
-RestartListener::RestartListener(Game *game)
-{
-    this->game = game;
-}
-
-void RestartListener::run(void *)
-{
-    game->reset(false);
-}
-
-//room.cpp
-Room::Room(string name) :
-    name(name)
-{
-    exits["north"] = nullptr;
-    exits["east"]  = nullptr;
-    exits["south"] = nullptr;
-    exits["west"]  = nullptr;
-}
-
-string Room::getName()
-{
-    return name;
-}
-
-void Room::setExits(Room *north, Room *east, Room *south, Room *west)
-{
-    exits["north"] = north;
-    exits["east"]  = east;
-    exits["south"] = south;
-    exits["west"]  = west;
-}
-
-Room *Room::getExit(string direction)
-{
-    return exits[direction];
-}
-
-void Room::addItem(Item *inItem) {
-    itemsInRoom.push_back(inItem);
-}
-
-string Room::displayItems() {
-    string tempString = "Items in room = ";
-    int sizeItems = (itemsInRoom.size());
-    if (itemsInRoom.size() < 1) {
-        tempString = "No items in room";
-        }
-    else if (itemsInRoom.size() > 0) {
-       int x = (0);
-        for (int n = sizeItems; n > 0; n--) {
-            tempString = tempString + itemsInRoom[x]->getShortDescription() + "  " ;
-            x++;
-            }
-        }
-    return tempString;
-    }
-
-int Room::numberOfItems() {
-    return itemsInRoom.size();
-}
-
-vector<Item*> Room::getItems() { return itemsInRoom; }
-
-void Room::removeItem(Item *newItem) {
-        for (unsigned int i = 0; i < itemsInRoom.size(); i++) {
-            //5. Binary Operator Overloading (item class)
-            if(itemsInRoom.at(i) == newItem) {
-                itemsInRoom.erase(itemsInRoom.begin() + i);
-            }
-        }
-}
-
-bool Room::hasItem(Item *inItem) {
-    for (unsigned int i = 0; i < itemsInRoom.size(); i++) {
-        //5. Binary Operator Overloading (item class)
-        if (itemsInRoom.at(i) == inItem) {
-                return true;
-        }
-    }
-    return false;
-}
-
-bool Room::hasEnemy(Enemy *enemy) {
-    for (unsigned int i = 0; i < enemiesInRoom.size(); i++) {
-        //5. Binary Operator Overloading (enemy class)
-        if (enemiesInRoom.at(i) == enemy) {
-                return true;
-        }
-    }
-    return false;
-}
-
-void Room::addEnemy(Enemy *enemy) {
-    enemiesInRoom.push_back(enemy);
-}
-
-vector<Enemy*> Room::getEnemies() { return this->enemiesInRoom; }
-
-string Room::displayEnemies() {
-    string tempString = "Enemies in room = ";
-    int sizeEnemies = (enemiesInRoom.size());
-    if (enemiesInRoom.size() < 1) {
-        tempString = "No enemies in room";
-        }
-    else if (enemiesInRoom.size() > 0) {
-       int x = (0);
-        for (int n = sizeEnemies; n > 0; n--) {
-            tempString = tempString + enemiesInRoom[x]->getName() + "  " ;
-            x++;
-            }
-        }
-    return tempString;
-}
-
-void Room::removeEnemy(Enemy *enemy) {
-        for (unsigned int i = 0; i < enemiesInRoom.size(); i++) {
-            //5. Binary Operator Overloading (enemy class)
-             if(enemiesInRoom.at(i) == enemy) {
-                enemiesInRoom.erase(enemiesInRoom.begin() + i);
-            }
-        }
-}
-
-//takelistener.cpp
-TakeListener::TakeListener(Game *game)
-{
-    this->game = game;
-    itemName = "";
-}
-
-void TakeListener::run(void *args_ptr)
-{
-    if (game->is_over()) {
-        return;
-    }
-
-    vector<string> *args = (vector<string> *) args_ptr;
-
-    if (args->size() > 1) {
-        game->take(args->at(1));
-    } else {
-        cout << "Need to choose an item to take!" << endl;
-    }
-}
-
-//teleportlistener.cpp
-TeleportListener::TeleportListener(Game *game)
-{
-    this->game = game;
-}
-
-void TeleportListener::run(void *)
-{
-    if (game->is_over()) {
-        return;
-    }
-
-    this->game->teleport();
-}
-
-//uselistener.cpp 
-UseListener::UseListener(Game *game)
-{
-    this->game = game;
-    itemName = "";
-}
-
-void UseListener::run(void *args_ptr)
-{
-    if (game->is_over()) {
-        return;
-    }
-
-    vector<string> *args = (vector<string> *) args_ptr;
-
-    if (args->size() > 1) {
-        game->use(args->at(1));
-    } else {
-        cout << "Need to choose an item to use!" << endl;
-    }
-}
-
-//victorylistener.cpp
-VictoryListener::VictoryListener(Game *game)
-{
-    this->game = game;
-}
-
-void VictoryListener::run(void *)
-{
-    cout << endl;
-    cout << "Victory!" << endl;
-    game->setOver(true);
-}
-
-//weapon.cpp
-//2. Inheritance (including virtual methods) and cascading constructors
-//9. Initializer list
-Weapon::Weapon(string inDescription, float inWeightGrams, int multiplier) : Item(inDescription, inWeightGrams, multiplier) {
-	
-}
-
-//7. Virtual functions and polymorphism
-//10. Dynamic and static dispatch
-string Weapon::getLongDescription()
-{
-    string temp = to_string(getWeight());
-    temp.erase(temp.find_last_not_of('0') + 1, std::string::npos);
-    temp.erase(temp.find_last_not_of('.') + 1, std::string::npos );
-    return description + ", is a weapon, weight: " + temp + "g, " + "multiplier: " + to_string(multiplier) + "\n";
-}
-
-//main.cpp
-int main()
-{
-    Game game;
-    EventManager::getInstance().listen("input", new InputListener(&game));
-    EventManager::getInstance().event_loop();
-    return EXIT_SUCCESS;
+/*************************
+ * @author: Nicole Berty
+ * All the header files are listed first, then all the cpp files. Each file's name is in a single comment, eg. //game.cpp
+ * Each concept is marked like this in the code: //1. Destructors
+ * Here is a list of each concept and where they are implemented:
+ * 1. Destructors:
+ *          - enemy.h/enemy.cpp (declared and defined)
+ *          - player.h/player.cpp (declared and defined)
+ *          - character.h/character.cpp (declared and defined)
+ * 2. Inheritance (including virtual methods) and cascading constructors
+ *          - character.h/character.cpp (base class)
+ *          - player.h/player.cpp (derived class of Character)
+ *          - enemy.h/enemy.cpp (derived class of Character)
+ *          - item.h/item.cpp (base class)
+ *          - weapon.h/weapon.cpp (derived class of Item)
+ * 3. Templates
+ *          - item.h/item.cpp (method setWeight(const T& weight) declared and defined)
+ * 4. Unary Operator Overloading
+ *          - player.h/player.cpp (declared and defined)
+ *          - game.cpp (example usage)
+ * 5. Binary Operator Overloading
+ *          - enemy.h/enemy.cpp (declared and defined)
+ *          - item.h/item.cpp (declared and defined)
+ *          - room.cpp (examples of enemy and item binary operator usage)
+ * 6. Friends
+ *          - character.h (friend class Game)
+ *          - enemy.h (friend function operator==)
+ *          - item.h (friend function operator==)
+ *          - room.h (friend classes Game, enterRoomListener)
+ * 7. Virtual functions and polymorphism
+ *          - item.h (base class, virtual function formatLongDescription())
+ *          - weapon.h/weapon.cpp (derived class, different implementation of virtual function formatLongDescription())
+ *          - item.cpp (example of runtime polymorphism occurring in getLongDescription() function)
+ *              (declaration Item *sword = new Weapon() is in game.h/.cpp)
+ * 8. Abstract classes and pure virtual functions
+ *          - character.h/character.cpp (is abstract base class, has 2 pure virtual functions setHealth and setStamina)
+ *          - enemy.h/enemy.cpp (derived class, has implementation of pure virtual functions setHealth and setStamina)
+ *          - player.h/player.cpp (derived class, has implementation of pure virtual functions setHealth and setStamina)
+ * 9. Initialiser List
+ *          - character.cpp
+ *          - enemy.cpp
+ *          - item.cpp
+ *          - player.cpp
+ *          - weapon.cpp
+ * 10. Dynamic and static dispatch
+ *          - item.h/item.cpp (base class, virtual function formatLongDescription() declared and defined)
+ *          - weapon.h/weapon.cpp (derived class, different implementation of virtual function formatLongDescription())
+ *          - item.cpp (example of dynamic dispatch occurring in getLongDescription() function)
+ *  
+ * ***********************/
+
+#include<string>
+#include <map>
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include<cstdlib> 
+#include<ctime>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <sstream>
+#include <string_view>
+#include <charconv>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <cstddef>
+#include <new>
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <sys/resource.h>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <condition_variable>
+#include <memory>
+#include <climits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <deque>
+#include <cassert>
+#if __cpp_impl_coroutine
+#include <coroutine>
+#endif
+using namespace std;
+
+//memorytracker.h
+// What a piece of heap memory is for. Classes pick theirs by deriving from Tracked<tag>;
+// anything else is charged to the innermost MemoryScope on the thread (OTHER if there isn't one).
+enum MemoryTag { TAG_OTHER, TAG_ROOMS, TAG_ITEMS, TAG_ENEMIES, TAG_LISTENERS, TAG_STRINGS, TAG_HISTORY, TAG_POOLS, NUMBER_OF_TAGS };
+
+/** Counts every heap allocation made through operator new, per tag: bytes live now,
+ *  the most that were ever live, and how many allocations were made. */
+struct MemoryTracker
+{
+    static void  *allocate(size_t size);
+    static void   release(void *pointer);
+
+    static long   totalAllocations();
+    static long   totalLiveBytes();
+    static long   liveBytes(MemoryTag tag);
+
+    // A table of live/peak bytes and allocation rate per tag.
+    static void   report(ostream &out);
+
+    // Prints the report to stderr once everything has been destroyed, so whatever is
+    // still live then has leaked.
+    static void   reportAtExit();
+
+    static MemoryTag currentTag();
+
+private:
+    friend struct MemoryScope;
+    static thread_local MemoryTag tag;
+};
+
+// Charges allocations made while it exists to the given tag.
+struct MemoryScope
+{
+    MemoryScope(MemoryTag tag);
+    ~MemoryScope();
+private:
+    MemoryTag previous;
+};
+
+class WorldArena;
+void *operator new(size_t size, WorldArena &arena);
+void  operator delete(void *pointer, WorldArena &arena);
+
+// Gives a class its own operator new that charges the memory to TAG.
+template <MemoryTag TAG>
+struct Tracked
+{
+    static void *operator new(size_t size)
+    {
+        MemoryScope scope(TAG);
+        return ::operator new(size);
+    }
+    static void operator delete(void *pointer)
+    {
+        ::operator delete(pointer);
+    }
+
+    // Objects placed in a WorldArena aren't on the heap, so there's nothing to count.
+    static void *operator new(size_t size, WorldArena &arena)
+    {
+        return ::operator new(size, arena);
+    }
+    static void operator delete(void *pointer, WorldArena &arena)
+    {
+        ::operator delete(pointer, arena);
+    }
+};
+
+//random.h
+// The hash behind every random roll in the game: the counter-th number for a seed. There's
+// no hidden state, so any roll can be recomputed (or computed many at a time) from its counter.
+inline uint32_t randomAt(uint32_t seed, uint32_t counter)
+{
+    uint32_t x = seed + 0x9e3779b9u * counter;
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Whether an attack with this roll lands: a d20 plus the weapon's multiplier must reach 10.
+inline bool attackHits(uint32_t roll, int multiplier)
+{
+    return (int) (roll % 20) + multiplier >= 10;
+}
+
+// The stamina a move costs: 1 empty-handed, and more the heavier what's carried.
+inline int moveStaminaCost(size_t itemsCarried, double carriedWeight)
+{
+    if (itemsCarried == 0) {
+        return 1;
+    }
+    return carriedWeight > 100 ? 7 : carriedWeight >= 30 ? 5 : 3;
+}
+
+//symboltable.h
+// A name interned in the SymbolTable. Two names are the same exactly when their symbols are.
+typedef uint32_t Symbol;
+
+/** Every name the game compares (items, enemies, rooms, commands) is stored here once and
+ *  referred to by its number, so checking identity is an integer compare. Strings only come
+ *  back out for display. Shared by all threads; names are never removed. */
+struct SymbolTable
+{
+    static const Symbol NO_SYMBOL = 0; // what find() returns for a name nobody has interned
+
+    // The name's symbol, adding it if it's new.
+    static Symbol intern(string_view name);
+    // The name's symbol without adding it: NO_SYMBOL for a name the game has never used,
+    // which can't match anything.
+    static Symbol find(string_view name);
+    static const string &name(Symbol symbol);
+    static size_t size();
+};
+
+// EventListener.h
+/** Parent class of all listeners. (It is abstract and can't be instantiated) */
+class EventListener : public Tracked<TAG_LISTENERS>
+{
+public:
+    // "void *" is a generic pointer to anything!
+    // 10x worse than regular pointers in potential problems
+    virtual void run(void *args) = 0;
+    virtual ~EventListener() = default;
+};
+
+//attacklistener.h
+class Game;
+
+class AttackListener : public EventListener
+{
+public:
+    AttackListener(Game *game);
+    void run(void *args) override;
+private:
+    Game  *game;
+    string enemyName;
+};
+
+//character.h
+// No need to include room since we're only working with pointers.
+// This is how we tell the compiler "there will be a room eventually".
+// This is called a "forward declaration".
+class Room;
+
+//2. Inheritance (including virtual methods) and cascading constructors (Base Class)
+class Character
+{
+public:
+
+    const string &getName();
+    Symbol getSymbol();  // the name's symbol, for comparing characters
+    int    getHealth();
+
+    //6. Friends
+    friend class Game;
+    friend class SharedWorld;
+    friend class RuleSet;
+
+protected:
+    Character(string name);
+    virtual ~Character();
+    string name;
+    Symbol symbol;
+    int health;
+    int stamina;
+    Room *currentRoom;
+
+    int    getStamina();
+    Room  *getCurrentRoom();
+
+    void setName(string name);
+    void setCurrentRoom(Room *next); 
+
+    //8. Abstract classes and pure virtual functions
+    virtual void setHealth(int setHealth) = 0;
+    virtual void setStamina(int stamina) = 0;
+};
+
+//characterdeathlistener.h
+
+class Game;
+// A listener for the bad ending
+class CharacterDeathListener : public EventListener
+{
+public:
+    CharacterDeathListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//combat.h
+/** Many fights resolved in one call. Each pair is one swing: if it lands the defender loses
+ *  damage, otherwise the attacker loses MISS_DAMAGE, the way Game::attack works. Health stops
+ *  at 0. Pair i uses the roll randomAt(seed, firstCounter + 1 + i), which is what the i-th
+ *  next call to Game::nextRandom would give. */
+struct CombatBatch
+{
+    static const int MISS_DAMAGE = 20;
+
+    vector<int32_t> attackerHealth;
+    vector<int32_t> defenderHealth;
+    vector<int32_t> multiplier;
+    vector<int32_t> damage;
+    vector<uint8_t> hit;     // filled in by resolve: 1 where the attack landed
+
+    void   add(int attackerHealth, int defenderHealth, int multiplier, int damage);
+    size_t size() const;
+
+    // Eight pairs at a time in vector registers.
+    void resolve(uint32_t seed, uint32_t firstCounter);
+    // One pair at a time; the reference resolve() must agree with.
+    void resolveScalar(uint32_t seed, uint32_t firstCounter);
+};
+
+// Resolves the same random battle both ways, checks they agree and prints rolls per second.
+bool runCombatBenchmark(long pairs, uint32_t seed);
+
+//commandprofiler.h
+/** Hardware counters (cycles, instructions, cache misses, branch misses) around each command,
+ *  added up per command name. Uses perf_event_open; where that isn't allowed (containers,
+ *  perf_event_paranoid) it says so once and only measures time. */
+class CommandProfiler
+{
+public:
+    enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, NUMBER_OF_COUNTERS };
+
+    CommandProfiler();
+    ~CommandProfiler();
+
+    // Counts whatever runs between begin() and end(name) towards name.
+    void begin();
+    void end(const string &name);
+
+    bool hasCounters();
+
+    // Count, average time and average of each counter per command, slowest first.
+    void report(ostream &out);
+
+private:
+    struct Totals
+    {
+        long     count = 0;
+        double   nanoseconds = 0;
+        uint64_t counters[NUMBER_OF_COUNTERS] = {};
+    };
+
+    int      leader;                         // group leader's fd, -1 when timing only
+    int      fds[NUMBER_OF_COUNTERS];        // -1 for counters this CPU doesn't have
+    int      opened;                         // how many counters the group has
+    int      groupIndex[NUMBER_OF_COUNTERS]; // each counter's place in a group read
+    uint64_t started[NUMBER_OF_COUNTERS];
+    chrono::steady_clock::time_point startedAt;
+    map<string, Totals> totals;
+
+    bool readCounters(uint64_t *values);
+};
+
+//defeatlistener.h
+class Game;
+
+// A listener for the bad ending
+class DefeatListener : public EventListener
+{
+public:
+    DefeatListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//enemy.h
+
+//2. Inheritance (including virtual methods) and cascading constructors
+class Enemy : public Character, public Tracked<TAG_ENEMIES>
+{
+public:
+    Enemy(string name, string description);
+
+    //1. Destructors
+    ~Enemy();
+
+    //8. Abstract classes and pure virtual functions (derived class)
+    virtual void setHealth(int setHealth);
+    virtual void setStamina(int stamina);
+
+    void setDescription(string description);
+    string getDescription();
+
+private:
+    string description;
+    
+    //5. Binary Operator Overloading
+    //6. Friends
+    friend bool operator== (const Enemy &e1, const Enemy &e2);
+};
+
+//enterroomlistener.h
+class Game;
+
+// Runs the rules (eg. the good ending) for the room the player just entered
+class EnterRoomListener : public EventListener
+{
+public:
+    EnterRoomListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//entitystore.h
+typedef uint32_t Entity;
+
+// The component arrays without their owner, so systems can run over arrays that live
+// somewhere else (eg. a mapped file, see PersistentWorld).
+struct EntityColumns
+{
+    int32_t *position;
+    int32_t *health;
+    int32_t *stamina;
+    float   *weight;
+    int32_t *multiplier;
+    uint8_t *flags;
+    size_t   count;
+};
+
+/** Items and enemies as rows of plain arrays, one array ("component") per property.
+ *  A system that only needs positions and weights walks just those two arrays from start
+ *  to end, instead of chasing a pointer and a virtual call per object. */
+struct EntityStore
+{
+    enum Flag : uint8_t {
+        ITEM       = 1,
+        ENEMY      = 2,
+        WEAPON     = 4,
+        CURSED     = 8,   // curses whoever picks it up
+        CONSUMABLE = 16,  // used as soon as it's picked up
+        KEY        = 32,  // opens locked rooms
+        DEAD       = 64,
+        PLAYER     = 128, // only in ShardedWorld, which moves players as entities
+    };
+
+    static const int32_t CARRIED   = -1;         // position of anything in the player's inventory
+    static const Entity  NO_ENTITY = UINT32_MAX; // an item's entity before it's placed
+
+    // Components, indexed by Entity.
+    vector<int32_t> position;   // room index, or CARRIED
+    vector<int32_t> health;
+    vector<int32_t> stamina;
+    vector<float>   weight;
+    vector<int32_t> multiplier;
+    vector<uint8_t> flags;
+
+    Entity createItem(int32_t room, float weight, int multiplier, uint8_t flags);
+    Entity createEnemy(int32_t room, int health, int stamina);
+    void   reserve(size_t entities);
+    void   clear();
+    size_t size() const;
+
+    bool has(Entity entity, uint8_t flag) const;
+
+    // Systems
+
+    // Total weight of everything the player carries.
+    double carriedWeight() const;
+    // True if the player carries anything with all of the given flags.
+    bool   carrying(uint8_t flag) const;
+    // The best multiplier among the carried weapons (0 without one).
+    int    carriedMultiplier() const;
+
+    // Moves every living enemy one room through an exit picked from (seed, tick, entity),
+    // charges it stamina and marks it DEAD when that runs out. exits holds 4 entries per
+    // room, -1 for a wall. Returns how many enemies are still alive.
+    long   wander(const vector<int32_t> &exits, uint32_t seed, uint32_t tick, int staminaCost);
+    static long wander(EntityColumns entities, const int32_t *exits, uint32_t seed, uint32_t tick, int staminaCost);
+    // Where wander moves one enemy to from room on this tick.
+    static int32_t wanderTo(const int32_t *exits, int32_t room, uint32_t seed, Entity entity, uint32_t tick);
+
+    EntityColumns columns();
+
+private:
+    Entity create(int32_t room, uint8_t flags);
+};
+
+// EventManager.h (Implemented as a Singleton)
+/** This class manages the event loop and all the event calls */
+struct EventManager // Structs in C++ are the same as classes, but default to "public" instead of "private".
+{
+    // static inside a class or struct works exactly like in java
+    // Only one instance per class.
+    static EventManager &getInstance(); // Gets an instance of the class (an object)
+
+    // Several sessions can share a process, each with its own EventManager (see Session).
+    // This changes which one getInstance() returns on the calling thread; nullptr goes back
+    // to the thread's own default instance.
+    static void setInstance(EventManager *instance);
+
+    // Making sure I can't have copies of this instance.
+    EventManager(EventManager const& copy);            // Not Implemented (Copy constructor)
+    EventManager& operator=(EventManager const& copy); // Not Implemented (Assignment operator)
+
+    // Registers an event.
+    void listen(const string &event_name, EventListener *listener);
+
+    // True if anything is listening for this event (i.e. it's a known command).
+    bool has_listeners(const string &event_name);
+
+    // Emits an event
+    // "void *" is a generic pointer to anything.
+    // !!! Highly unsafe, please don't do this at home without the presence of your parents !!!
+    void trigger(const string &event_name, void *args = nullptr);
+
+    // Returns true if still running
+    bool is_running();
+
+    // Stops the event loop
+    void stop();
+
+    // Reads the input and calls an input event
+    void check_events();
+
+    // Splits a line of input into words and calls an input event with them
+    void dispatch(const string &line);
+
+    // constantly checks for new inputs until the program ends.
+    void event_loop();
+
+    // Where everything the game prints goes (cout by default).
+    ostream &output();
+    void setOutput(ostream *output);
+
+    // Silences all game output, eg. while replaying a journal.
+    void mute();
+
+private:
+    // True if running
+    bool running;
+
+    ostream *out;
+
+    // Lists/vectors of listeners indexed by the symbol of the event's name, so finding an
+    // event's listeners is one lookup in the symbol table and one array index.
+    vector<vector<EventListener*>> registeredEvents;
+
+    const vector<EventListener*> *listenersOf(const string &event_name);
+
+    // Kept between dispatches so splitting a line reuses their memory. They're swapped out
+    // while in use, so a dispatch from inside a listener just starts with empty ones.
+    string         spareLine;
+    vector<string> spareWords;
+
+    // Only EventManager (and Session, which needs one per game) can call the constructor,
+    // so the only way to get an instance is by calling getInstance.
+    EventManager();
+    friend class Session;
+
+    static thread_local EventManager *current;
+};
+
+// Shorthand for EventManager::getInstance().output(), used instead of cout by the game.
+ostream &console();
+
+//exitlistener.h
+class Game;
+
+// A listener for the exit command
+class ExitListener : public EventListener
+{
+public:
+    ExitListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//item.h
+class Item : public Tracked<TAG_ITEMS> {
+protected:
+	string description;
+	Symbol symbol;
+	float weightGrams;
+	int multiplier;
+
+	// Writes the weight the way it's displayed ("15.56", "27") into buffer, without allocating.
+	string_view formatWeight(char (&buffer)[32]);
+
+	//7. Virtual functions and polymorphism
+	//10. Dynamic and static dispatch (derived class is weapon.h)
+	virtual void formatLongDescription(string &out);
+
+private:
+	// The long description only changes with the weight, so it's built once and kept.
+	string longDescription;
+	bool   longDescriptionValid;
+
+	Entity entity;  // its row in the Game's EntityStore, set when the Game places it
+
+public:
+    Item (string description, float inWeight, int multiplier = 0);
+    virtual ~Item() = default;
+	float getWeight();
+	int getMultiplier();
+	const string &getShortDescription();
+	Symbol getSymbol();  // the short description's symbol, for comparing items
+	const string &getLongDescription();
+	Entity getEntity();
+	void setEntity(Entity entity);
+
+	//3. Templates
+	template <typename T>
+	void setWeight(const T& weightGrams);
+
+	//5. Binary Operator Overloading
+	//6. Friends
+	friend bool operator== (const Item &item1, const Item &item2);
+};
+
+//jsonwriter.h
+/** Writes JSON straight into a string the caller keeps and reuses, so a steady stream of
+ *  replies doesn't allocate. Commas go in by themselves. */
+class JsonWriter
+{
+public:
+    JsonWriter(string &out);
+
+    JsonWriter &beginObject();
+    JsonWriter &endObject();
+    JsonWriter &beginArray();
+    JsonWriter &endArray();
+
+    JsonWriter &key(string_view name);
+    JsonWriter &value(string_view text);
+    JsonWriter &value(const char *text);
+    JsonWriter &value(long number);
+    JsonWriter &value(int number);
+    JsonWriter &value(bool flag);
+    // Something that's already JSON, like a request id being echoed back.
+    JsonWriter &raw(string_view json);
+
+private:
+    static const int MAX_DEPTH = 16;
+
+    string &out;
+    bool    empty[MAX_DEPTH]; // nothing written yet at this level, so no comma needed
+    int     depth;
+    bool    afterKey;
+
+    void separate();
+    void begin(char bracket);
+    void end(char bracket);
+};
+
+//player.h
+
+//2. Inheritance (including virtual methods) and cascading constructors
+class Player : public Character
+{
+public:
+    Player(string newName);
+
+    //1. Destructors
+    ~Player();
+
+    vector < Item* > itemInventory;
+
+    //8. Abstract classes and pure virtual functions (derived class)
+    virtual void setHealth(int setHealth);
+    virtual void setStamina(int stamina);
+
+    void addItem(Item*);
+    void emptyInventory();
+    void removeItem(Item*);
+    const string &getItems();
+    // Makes room in getItems' text for item descriptions this long in all, so listing an
+    // inventory that size never grows it.
+    void reserveItemsText(size_t descriptionsLength);
+    bool hasItem(Symbol item);
+
+    //4. Unary Operator Overloading
+    void operator--();
+    void operator++();
+
+private:
+    // Reused by getItems so showing the inventory doesn't allocate once it's big enough.
+    string inventoryText;
+};
+
+//stringsink.h
+// A stream buffer that appends whatever is written to it to a string, which its owner
+// empties and reuses. Gives a session's output a place to collect without allocating per line.
+struct StringSink : public streambuf
+{
+    string text;
+
+protected:
+    int        overflow(int c) override;
+    streamsize xsputn(const char *s, streamsize count) override;
+};
+
+//protocolserver.h
+class Game;
+
+/** The machine-readable mode for bots (zork --json). Every input line is a request such as
+ *      {"id": 7, "cmd": "go north"}
+ *  and gets exactly one reply line, in order:
+ *      {"id":7,"ok":true,"text":"...","state":{"room":"E","exits":["east"],"hp":100,...}}
+ *  "state" only holds the parts of the game the command changed (everything, the first time).
+ *  Requests may be pipelined; replies are collected and written out together once no more
+ *  input is waiting. */
+class ProtocolServer
+{
+public:
+    ProtocolServer(Game *game, istream &in, ostream &out);
+    ~ProtocolServer();
+
+    // Answers requests until the input ends or the game is exited.
+    void run();
+
+private:
+    // Replies are written once this much has piled up, even if more requests are waiting.
+    static const size_t FLUSH_BYTES = 64 * 1024;
+
+    Game        *game;
+    istream     &in;
+    ostream     &out;
+    StringSink   capture;  // game text lands here instead of stdout, to go in the reply's "text"
+    ostream      captured;
+    ostream     *previousOutput;
+    string       pending;  // replies not written yet
+    string       id;
+    string       command;
+
+    void handle(const string &line);
+    void flush();
+};
+
+// Reads a flat JSON object and picks out "id" (as raw JSON, to be echoed back) and "cmd"
+// (or "command"). Returns false if the line isn't such an object.
+bool parseRequest(string_view line, string &id, string &command);
+
+//soakdriver.h
+/** Settings for a soak run: random but weighted commands, fed to sessions through the
+ *  real InputListener path until time runs out or an invariant breaks. */
+struct SoakSettings
+{
+    int          sessions    = 1;
+    double       seconds     = 60;
+    unsigned int seed        = 1;
+    double       reportEvery = 10;  // seconds between progress lines
+};
+
+// Returns false if an invariant was broken (after printing what and how to reproduce it).
+bool runSoak(const SoakSettings &settings);
+
+// Plays the soak's commands through one session (with its output kept in a reused buffer),
+// first warmup of them and then measured more, counting the heap allocations each command
+// makes. Does that for seeds seed, seed + 1, ... in a fresh session each, since how far a
+// warm-up gets depends on the seed. Prints the counts per command and returns false if any
+// measured command allocated.
+bool runAllocationCheck(long warmup, long measured, unsigned int seed, int seeds);
+
+// Plays the soak's commands through one session mixed with random undo, redo and branch,
+// and checks that every time the game returns to a version its state is exactly what it
+// was when that version was made. Prints memory per version and time per timeline command.
+bool runTimelineCheck(long commands, unsigned int seed);
+
+// Memory the process has in RAM right now, and the most it has had.
+long residentKilobytes();
+long peakResidentKilobytes();
+
+//statusrenderer.h
+/** Prints the status block (room, items, enemies, exits, HP/ST) shown after each command,
+ *  but only the lines that differ from what's already on screen. On a terminal the block
+ *  is pinned to the top of the screen and changed lines are redrawn in place with ANSI codes;
+ *  otherwise changed lines are printed as plain text. */
+class StatusRenderer
+{
+public:
+    enum Line { ROOM, ITEMS, ENEMIES, EXITS, STATS, NUMBER_OF_LINES };
+
+    StatusRenderer();
+    ~StatusRenderer();
+
+    void setLine(Line line, const string &text);
+
+    // Emits the lines that changed since the last flush.
+    void flush(ostream &out);
+
+    // Forgets what's on screen so the next flush shows every line.
+    void invalidate();
+
+private:
+    string shown[NUMBER_OF_LINES];
+    bool   changed[NUMBER_OF_LINES];
+    bool   started;
+    bool   ansi;
+    int    rows;
+    ostream *terminal;
+
+    void startTerminal(ostream &out);
+};
+
+//roomaccess.h
+// A set of keys, one bit each. A room can need some keys and an item can carry some; the
+// player may enter a room once the keys they hold cover everything it needs.
+typedef uint64_t KeySet;
+
+constexpr KeySet GATE_KEY = KeySet(1) << 0; // opens room G
+
+/** Which rooms can be entered with the keys held right now. The open rooms are kept in one
+ *  array that's updated when keys are gained or lost, so picking a random open room is a
+ *  single lookup however many rooms are locked. */
+class RoomAccess
+{
+public:
+    RoomAccess();
+
+    // needed[i] is the keys room i needs. Afterwards no keys are held.
+    void   setRequirements(const vector<KeySet> &needed);
+
+    // Holds exactly these keys from now on. Only rooms that need a key can change, so only
+    // they are looked at, and only when the keys are different.
+    void   hold(KeySet keys);
+    KeySet held() const;
+
+    bool   canEnter(int room) const;
+    int    numberOfOpenRooms() const;
+    // An open room chosen uniformly by a random number.
+    int    openRoom(unsigned int random) const;
+
+private:
+    vector<KeySet> needed;
+    vector<int>    lockedRooms;  // rooms that need any key, in order
+    vector<int>    open;         // rooms needing nothing, then the locked ones the keys open
+    size_t         alwaysOpen;   // how many of open need nothing
+    KeySet         keys;
+};
+
+//world.h
+/** The built-in world written out as compile-time tables. Rooms refer to each other by
+ *  index, and the static_asserts below reject a table with an exit to a room that
+ *  doesn't exist or a room that can't be reached from the start. */
+struct RoomDefinition
+{
+    const char *name;
+    int exits[4]; // north, east, south, west; -1 for a wall
+    KeySet needs; // keys the player must hold to enter
+};
+
+struct ItemDefinition
+{
+    const char *name;
+    float weight;
+    int multiplier; // above 0 makes it a weapon
+    int room;
+    uint8_t flags;  // EntityStore::Flag; what picking it up does is up to defaultRules
+    KeySet opens;   // keys it counts as while carried
+};
+
+struct EnemyDefinition
+{
+    const char *name;
+    const char *description;
+    int room;
+};
+
+constexpr RoomDefinition defaultRooms[] = {
+    //          N   E   S   W     needs
+    { "A", {  4,  2,  7,  1 }, 0 },        // 0
+    { "B", { -1,  0, -1, -1 }, 0 },        // 1
+    { "C", { -1, -1, -1,  0 }, 0 },        // 2
+    { "D", { -1,  4, -1, -1 }, 0 },        // 3
+    { "E", { -1,  5,  0,  3 }, 0 },        // 4
+    { "F", { -1, -1, -1,  4 }, 0 },        // 5
+    { "G", { -1,  7, -1, -1 }, GATE_KEY }, // 6
+    { "H", {  0,  8,  9,  6 }, 0 },        // 7
+    { "I", { -1, -1, -1,  7 }, 0 },        // 8
+    { "J", {  7, -1, -1, -1 }, 0 },        // 9
+};
+
+constexpr ItemDefinition defaultItems[] = {
+    { "key",         27,    0, 2, EntityStore::KEY, GATE_KEY },
+    { "cursed_item", 15.56, 0, 6, 0, 0 },
+    { "potion",      10.25, 0, 3, 0, 0 },
+    { "sword",       150,   5, 5, 0, 0 },
+};
+
+constexpr EnemyDefinition defaultEnemies[] = {
+    { "stationary-man", "is a non-moving enemy", 2 },
+};
+
+// What happens when the player enters a room or takes or uses an item (see RuleSet).
+constexpr const char *defaultRules = R"(
+# Reaching the last room wins.
+on enter J
+    trigger victory
+end
+
+on take cursed_item
+    say "Oh no! You've picked up a cursed item.\n"
+    health = health - 20
+    say "You've lost some health points due to the cursed item."
+    trigger curse
+end
+
+# The potion is used as soon as it's picked up.
+on take potion
+    use potion
+end
+
+on use potion
+    if health <= 80
+        heal
+        say "You have used a replenishing potion!"
+    else
+        say "You must have 80 or less health points to use the health potion."
+    end
+end
+)";
+
+constexpr int NUMBER_OF_DEFAULT_ROOMS   = sizeof(defaultRooms) / sizeof(defaultRooms[0]);
+constexpr int NUMBER_OF_DEFAULT_ITEMS   = sizeof(defaultItems) / sizeof(defaultItems[0]);
+constexpr int NUMBER_OF_DEFAULT_ENEMIES = sizeof(defaultEnemies) / sizeof(defaultEnemies[0]);
+
+constexpr int START_ROOM  = 0;
+constexpr int MOJO_ROOM   = 3;
+
+template <int N>
+constexpr bool exitsValid(const RoomDefinition (&rooms)[N])
+{
+    for (int i = 0; i < N; i++) {
+        for (int direction = 0; direction < 4; direction++) {
+            if (rooms[i].exits[direction] < -1 || rooms[i].exits[direction] >= N) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <int N>
+constexpr bool allReachable(const RoomDefinition (&rooms)[N], int start)
+{
+    // Breadth-first search, run by the compiler.
+    bool seen[N] = {};
+    int queue[N] = {};
+    int head = 0, tail = 0;
+    seen[start] = true;
+    queue[tail++] = start;
+    while (head < tail) {
+        int room = queue[head++];
+        for (int direction = 0; direction < 4; direction++) {
+            int next = rooms[room].exits[direction];
+            if (next >= 0 && !seen[next]) {
+                seen[next] = true;
+                queue[tail++] = next;
+            }
+        }
+    }
+    return tail == N;
+}
+
+template <int N, int M>
+constexpr bool keysObtainable(const RoomDefinition (&rooms)[N], const ItemDefinition (&items)[M])
+{
+    KeySet carried = 0;
+    for (int i = 0; i < M; i++) {
+        carried |= items[i].opens;
+    }
+    for (int i = 0; i < N; i++) {
+        if ((rooms[i].needs & ~carried) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T, int N>
+constexpr bool placedInRooms(const T (&things)[N], int numberOfRooms)
+{
+    for (int i = 0; i < N; i++) {
+        if (things[i].room < 0 || things[i].room >= numberOfRooms) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(exitsValid(defaultRooms), "an exit leads to a room that doesn't exist");
+static_assert(allReachable(defaultRooms, START_ROOM), "a room can't be reached from the start");
+static_assert(placedInRooms(defaultItems, NUMBER_OF_DEFAULT_ROOMS), "an item is placed in a room that doesn't exist");
+static_assert(placedInRooms(defaultEnemies, NUMBER_OF_DEFAULT_ROOMS), "an enemy is placed in a room that doesn't exist");
+static_assert(keysObtainable(defaultRooms, defaultItems), "a room needs a key that no item carries");
+static_assert(defaultRooms[START_ROOM].needs == 0, "the start room can't be locked");
+static_assert(MOJO_ROOM < NUMBER_OF_DEFAULT_ROOMS, "special rooms must exist");
+
+//worldgenerator.h
+/** Settings for generated worlds. Densities are the chance (0-1) that any one room gets the thing. */
+struct GeneratorSettings
+{
+    enum Shape { GRID, MAZE, SMALL_WORLD };
+
+    Shape        shape          = GRID;
+    long         rooms          = 100;
+    unsigned int seed           = 1;
+    int          threads        = 0;     // 0 means one per core
+    double       lockedDensity  = 0.05;
+    double       keyDensity     = 0.01;
+    double       itemDensity    = 0.10;
+    double       weaponDensity  = 0.02;
+    double       enemyDensity   = 0.05;
+    double       shortcutDensity = 0.5;  // small worlds only: chance a pair of rooms gets a north/south link
+};
+
+/** A generated world in compact form: four exit indices per room, like defaultRooms, plus a
+ *  byte of flags saying what's in each room. The victory room can always be reached from
+ *  the start without going through a locked room. */
+struct GeneratedWorld
+{
+    enum Flag { LOCKED = 1, KEY = 2, ITEM = 4, WEAPON = 8, ENEMY = 16 };
+
+    long            numberOfRooms = 0;
+    long            start   = 0;
+    long            victory = 0;
+    vector<int32_t> exits;   // 4 per room: north, east, south, west; -1 for a wall
+    vector<uint8_t> flags;
+
+    // True if victory can be reached from start through unlocked rooms.
+    bool victoryReachable() const;
+
+    // A hash of the whole world, for checking that a seed always gives the same world.
+    uint64_t checksum() const;
+
+    // Builds real Room objects (on the heap) with the generated exits, items and enemies.
+    void instantiate(vector<Room *> &rooms, vector<Item *> &items, vector<Enemy *> &enemies) const;
+
+    // Adds the generated items and enemies to an entity store instead.
+    void populate(EntityStore &store) const;
+};
+
+// Builds a connected world. The result depends only on the settings, never on the number of threads.
+GeneratedWorld generateWorld(const GeneratorSettings &settings);
+
+// Generates a world, checks it and prints how long each step took. With reorder the rooms
+// are renumbered for locality (see RoomGraph::cuthillMcKee) before anything else uses them.
+// With ticks above 0 the enemies are then moved around that many times as entities. With a
+// persistPath the world is also written to that file as a PersistentWorld.
+bool runGenerator(const GeneratorSettings &settings, bool instantiate, int ticks = 0, const string &persistPath = "",
+                  bool reorder = false);
+
+//persistentworld.h
+/** A pointer that stores how far away its target is instead of the target's address, so a
+ *  structure full of them means the same thing wherever the file holding it is mapped. */
+template <typename T>
+class OffsetPtr
+{
+public:
+    OffsetPtr() : distance(0) {}
+
+    OffsetPtr &operator=(T *target)
+    {
+        distance = target == nullptr ? 0 : (char *) target - (char *) this;
+        return *this;
+    }
+
+    T *get() const
+    {
+        return distance == 0 ? nullptr : (T *) ((char *) this + distance);
+    }
+
+    T &operator[](size_t index) const
+    {
+        return get()[index];
+    }
+
+    // True if count Ts from the target lie inside the size bytes from file (which holds
+    // this pointer), suitably aligned.
+    bool fits(const void *file, int64_t size, int64_t count) const
+    {
+        int64_t at = (const char *) this - (const char *) file;
+        if (distance == 0 || distance < -at || distance > size - at) {
+            return false;
+        }
+        at += distance;
+        return at % alignof(T) == 0 && count >= 0 && count <= (size - at) / (int64_t) sizeof(T);
+    }
+
+private:
+    int64_t distance;
+};
+
+/** The start of a persistent world file. Everything after it is reached through its
+ *  OffsetPtrs: four exits per room (room indices, -1 for a wall), a byte of flags per room
+ *  and the entity components. */
+struct PersistentWorldHeader
+{
+    static const uint32_t VERSION = 1;
+
+    char     magic[8];            // "ZORKWLD"
+    uint32_t version;
+    uint32_t seed;
+    int64_t  fileSize;
+    int64_t  numberOfRooms;
+    int64_t  start;
+    int64_t  victory;
+    int64_t  numberOfEntities;
+    int64_t  tick;                // how far the world has run; resuming carries on from here
+
+    OffsetPtr<int32_t> exits;
+    OffsetPtr<uint8_t> roomFlags;
+    OffsetPtr<int32_t> position;
+    OffsetPtr<int32_t> health;
+    OffsetPtr<int32_t> stamina;
+    OffsetPtr<float>   weight;
+    OffsetPtr<int32_t> multiplier;
+    OffsetPtr<uint8_t> entityFlags;
+};
+
+/** A generated world living in a memory-mapped file instead of on the heap. Opening one
+ *  just maps it; there's nothing to load or rebuild, however big it is. Changes go to the
+ *  mapped pages and reach the disk at checkpoint() (or whenever the kernel writes them back). */
+class PersistentWorld
+{
+public:
+    PersistentWorld();
+    ~PersistentWorld();
+
+    // Writes a new file holding the world, its items and its enemies, and keeps it mapped.
+    bool create(const string &path, const GeneratedWorld &world, uint32_t seed);
+    // Maps an existing file. Returns false (after saying why) if it isn't a world file.
+    bool open(const string &path);
+
+    // Flushes the dirty pages to the file and waits for them to be written.
+    bool checkpoint();
+
+    // Runs one tick: every living enemy wanders (see EntityStore::wander).
+    long tick(int staminaCost);
+
+    PersistentWorldHeader *getHeader();
+    EntityColumns          entities();
+
+private:
+    int                    fd;
+    PersistentWorldHeader *header;
+    size_t                 mappedSize;
+
+    bool map(size_t size, bool writable);
+};
+
+// zork --resume: opens a world file and runs it for a number of ticks, checkpointing every so often.
+bool runPersistentWorld(const string &path, long ticks, long checkpointEvery);
+
+//worldarena.h
+/** A fixed block of memory inside the Game that the built-in world's rooms, items,
+ *  enemies and listeners are placed in, so starting a game doesn't touch the heap for them.
+ *  Everything is built once; a restart puts the same items and enemies back in place. */
+class WorldArena
+{
+public:
+    static const size_t CAPACITY = 8192;
+
+    WorldArena();
+    void  *allocate(size_t size);
+
+private:
+    alignas(max_align_t) unsigned char memory[CAPACITY];
+    size_t used;
+};
+
+//timeline.h
+// Bytes of pool blocks (see BlockPool) handed out on this thread and not yet given back:
+// what pooled objects really hold, however big the pools' chunks have grown.
+inline size_t &poolBytesInUse()
+{
+    static thread_local size_t bytes = 0;
+    return bytes;
+}
+
+/** One thread's free list of equal blocks for every PoolAllocator of one Family. It grows
+ *  a chunk at a time when it runs out, and takes blocks back instead of freeing them, so
+ *  memory follows the most the Family has held at once. The first allocation sets the block
+ *  size: a Family only ever holds one type, the control block allocate_shared makes for it.
+ *  The chunks are never returned, so they're charged to POOLS rather than to whatever asked
+ *  for the first block. */
+template <typename Family>
+class BlockPool
+{
+public:
+    static BlockPool &get()
+    {
+        static thread_local BlockPool pool;
+        return pool;
+    }
+
+    void *take(size_t size)
+    {
+        if (blockSize == 0) {
+            size_t align = alignof(max_align_t);
+            blockSize = (max(size, sizeof(FreeBlock)) + align - 1) / align * align;
+        }
+        if (size > blockSize) {
+            cerr << "BlockPool: a " << size << "-byte object in a pool of " << blockSize << "-byte blocks" << endl;
+            abort();
+        }
+        if (free == nullptr) {
+            grow(BLOCKS_PER_CHUNK);
+        }
+        FreeBlock *block = free;
+        free = block->next;
+        inUse++;
+        poolBytesInUse() += blockSize;
+        return block;
+    }
+
+    void give(void *pointer)
+    {
+        FreeBlock *block = static_cast<FreeBlock *>(pointer);
+        block->next = free;
+        free = block;
+        inUse--;
+        poolBytesInUse() -= blockSize;
+    }
+
+    // Grows the pool, if it has to, until spare more blocks are free than are in use now.
+    // Nothing happens before the first allocation, as the block size isn't known yet.
+    void reserveSpare(size_t spare)
+    {
+        if (blockSize > 0 && capacity < inUse + spare) {
+            grow(inUse + spare - capacity);
+        }
+    }
+
+private:
+    static const size_t BLOCKS_PER_CHUNK = 64;
+
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    FreeBlock *free      = nullptr;
+    size_t     blockSize = 0;
+    size_t     capacity  = 0;  // blocks made, free or not
+    size_t     inUse     = 0;
+
+    void grow(size_t blocks)
+    {
+        MemoryScope scope(TAG_POOLS);
+        char *chunk = static_cast<char *>(::operator new(blocks * blockSize));
+        for (size_t i = 0; i < blocks; i++) {
+            FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + i * blockSize);
+            block->next = free;
+            free = block;
+        }
+        capacity += blocks;
+    }
+};
+
+/** Allocates single objects from the BlockPool of Family (T's own unless given), and
+ *  anything bigger from the heap. Rebinding keeps the Family, so allocate_shared's control
+ *  block for T comes from the pool the family names. */
+template <typename T, typename Family = T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, Family> &) {}
+
+    T *allocate(size_t n)
+    {
+        if (n != 1) {
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T *>(BlockPool<Family>::get().take(sizeof(T)));
+    }
+
+    void deallocate(T *pointer, size_t n)
+    {
+        if (n != 1) {
+            ::operator delete(pointer);
+            return;
+        }
+        BlockPool<Family>::get().give(pointer);
+    }
+
+    // Makes room in the pool for spare more objects than are alive now.
+    static void reserveSpare(size_t spare)
+    {
+        BlockPool<Family>::get().reserveSpare(spare);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U, Family> &) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U, Family> &) const
+    {
+        return false;
+    }
+};
+
+/** An array that's never changed in place: set() returns a new array that shares every
+ *  node with the old one except the path down to the changed element. Keeping many
+ *  versions costs memory only for what differs between them; lookups and updates are
+ *  O(log n). Nodes come from Allocator. */
+template <typename T, typename Allocator = allocator<T>>
+class PersistentArray
+{
+public:
+    PersistentArray() : length(0), depth(0) {}
+
+    explicit PersistentArray(const vector<T> &values) : length(values.size()), depth(0)
+    {
+        while (span(depth + 1) < length) {
+            depth++;
+        }
+        root = build(values, 0, depth);
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    // How many nodes one array of this many elements is made of.
+    static size_t nodesFor(size_t length)
+    {
+        size_t nodes = 1;
+        for (int level = 0; span(level + 1) < length; level++) {
+            nodes += (length + span(level + 1) - 1) / span(level + 1);
+        }
+        return nodes;
+    }
+
+    const T &operator[](size_t index) const
+    {
+        const Node *node = root.get();
+        for (int level = depth; level > 0; level--) {
+            node = node->children[(index / span(level)) % FANOUT].get();
+        }
+        return node->values[index % FANOUT];
+    }
+
+    PersistentArray set(size_t index, T value) const
+    {
+        PersistentArray changed = *this;
+        changed.root = setIn(root, index, move(value), depth);
+        return changed;
+    }
+
+    // Calls visit(index, value) for each element where this array differs from other (a
+    // version of the same array), skipping every subtree the two share. Comparing nearby
+    // versions therefore costs only their differences.
+    template <typename Visit>
+    void forEachDifference(const PersistentArray &other, Visit visit) const
+    {
+        difference(root, other.root, depth, 0, visit);
+    }
+
+private:
+    static const int FANOUT = 4;
+
+    // Branches use children, leaves use values.
+    struct Node
+    {
+        shared_ptr<const Node> children[FANOUT];
+        T                      values[FANOUT];
+    };
+
+    shared_ptr<const Node> root;
+    size_t                 length;
+    int                    depth;  // levels of branches above the leaves
+
+    // How many elements one node at this level covers.
+    static size_t span(int level)
+    {
+        size_t elements = 1;
+        for (int i = 0; i < level; i++) {
+            elements *= FANOUT;
+        }
+        return elements;
+    }
+
+    shared_ptr<const Node> build(const vector<T> &values, size_t first, int level)
+    {
+        auto node = allocate_shared<Node>(Allocator());
+        for (int i = 0; i < FANOUT; i++) {
+            size_t start = first + i * span(level);
+            if (start >= values.size()) {
+                break;
+            }
+            if (level == 0) {
+                node->values[i] = values[start];
+            } else {
+                node->children[i] = build(values, start, level - 1);
+            }
+        }
+        return node;
+    }
+
+    static shared_ptr<const Node> setIn(const shared_ptr<const Node> &node, size_t index, T value, int level)
+    {
+        auto copy = allocate_shared<Node>(Allocator(), *node);
+        size_t slot = (index / span(level)) % FANOUT;
+        if (level == 0) {
+            copy->values[slot] = move(value);
+        } else {
+            copy->children[slot] = setIn(node->children[slot], index, move(value), level - 1);
+        }
+        return copy;
+    }
+
+    template <typename Visit>
+    void difference(const shared_ptr<const Node> &mine, const shared_ptr<const Node> &theirs,
+                    int level, size_t first, Visit &visit) const
+    {
+        if (mine == theirs || mine == nullptr) {
+            return;
+        }
+        for (int i = 0; i < FANOUT; i++) {
+            size_t start = first + i * span(level);
+            if (start >= length) {
+                break;
+            }
+            if (level == 0) {
+                if (!(mine->values[i] == theirs->values[i])) {
+                    visit(start, mine->values[i]);
+                }
+            } else {
+                difference(mine->children[i], theirs->children[i], level - 1, start, visit);
+            }
+        }
+    }
+};
+
+// What's in one room at one point in the game.
+struct EnemyState
+{
+    Enemy *enemy;
+    int    health;
+    int    stamina;
+};
+
+// Fixed-size, so every one fits the same pool block: a room can hold at most every item,
+// and every enemy plus mojo.
+struct RoomState
+{
+    Item      *items[NUMBER_OF_DEFAULT_ITEMS];
+    int        numberOfItems;
+    EnemyState enemies[NUMBER_OF_DEFAULT_ENEMIES + 1];
+    int        numberOfEnemies;
+};
+
+// Everything about the game that isn't in a room.
+struct GameStatus
+{
+    int          playerRoom, playerHealth, playerStamina;
+    int          mojoRoom, mojoHealth, mojoStamina;
+    bool         over;
+    unsigned int rngCounter;
+
+    bool operator==(const GameStatus &other) const;
+};
+
+// The pool the rooms arrays' nodes come from, apart from the room states'.
+struct RoomStateNodes;
+
+typedef PersistentArray<shared_ptr<const RoomState>, PoolAllocator<RoomState, RoomStateNodes>> RoomStates;
+
+/** The whole game at one point in its history. Versions share the rooms that didn't change
+ *  between them through a PersistentArray; the inventory is small enough to copy. Versions,
+ *  room states and the array's nodes all come from PoolAllocators. */
+struct GameVersion
+{
+    long       number;
+    long       parent;  // the version it was made from; -1 for the first
+    RoomStates rooms;
+    Item      *inventory[NUMBER_OF_DEFAULT_ITEMS];
+    int        inventorySize;
+    GameStatus status;
+};
+
+/** Every version a game has been through, as a tree. A command that changes anything adds
+ *  a child of the current version; undo moves to its parent, redo goes back down the way
+ *  undo came, and branch jumps to any version, so the next command starts a new branch.
+ *  All of them are O(1). Only the newest few versions are kept. */
+class Timeline
+{
+public:
+    static const size_t DEFAULT_LIMIT = 100;
+
+    Timeline();
+
+    // How many versions are kept; 0 keeps none.
+    void   setLimit(size_t limit);
+    size_t getLimit();
+
+    // Forgets everything and starts again from this version (none for nullptr).
+    void start(shared_ptr<GameVersion> first);
+
+    // Numbers the version, makes it a child of the current one and moves to it.
+    void add(shared_ptr<GameVersion> version);
+
+    // nullptr if there is no such version (or it's no longer kept).
+    const GameVersion *current();
+    const GameVersion *find(long number);
+
+    // Each moves and returns the version moved to, or returns nullptr and stays put.
+    const GameVersion *undo();
+    const GameVersion *redo();
+    const GameVersion *branch(long number);
+
+    long oldest();
+    long newest();
+    // Where redo would go, newest last.
+    const vector<long> &getRedoSteps();
+
+    // Replaces everything with versions saved from another timeline: consecutively numbered,
+    // oldest first, with their parents set. Only the newest limit of them are kept. Returns
+    // false and changes nothing if current isn't one of those.
+    bool restore(const vector<shared_ptr<GameVersion>> &saved, long current, const vector<long> &redo);
+
+private:
+    // A ring of limit slots: version n is in slot n % limit, for the count versions
+    // numbered from firstNumber up. Nothing moves or allocates as old versions drop out.
+    vector<shared_ptr<const GameVersion>> versions;
+    size_t                                count;
+    long                                  firstNumber;
+    long                                  currentNumber;
+    vector<long>                          redoSteps;  // where each undo came from, newest last
+    size_t                                limit;
+};
+
+//rules.h
+
+/** The world's rules (what entering a room, or taking, using or attacking something does),
+ *  written in a small language and compiled to bytecode when the game starts:
+ *
+ *      on take potion                  # on enter|take|use|attack <room, item or enemy>
+ *          use potion                  # runs the potion's "use" rules
+ *      end
+ *      on use potion
+ *          if health <= 80             # < <= > >= == !=
+ *              health = health + 5     # health, stamina and numbers, with + and -
+ *              heal                    # 20 more health (Player's ++)
+ *              say "You feel better."
+ *          else
+ *              trigger defeat          # fires victory, defeat or curse with the player
+ *          end
+ *      end
+ *
+ *  # starts a comment. Names can contain '-', so leave spaces around a minus. Rules only
+ *  jump forwards, so every one finishes. Each trigger has a table indexed by the subject's Symbol holding
+ *  where its code starts, so finding a rule is one array lookup and subjects without rules
+ *  cost nothing but that. */
+class RuleSet
+{
+public:
+    enum Trigger { ENTER, TAKE, USE, ATTACK, NUMBER_OF_TRIGGERS };
+
+    RuleSet();
+
+    // Replaces the rules with the ones in source. On a mistake it returns false with the
+    // line and what's wrong in error, and keeps the rules it had.
+    bool compile(const string &source, string &error);
+
+    // Runs the rules for subject (a room, item or enemy) on that trigger against the player.
+    // Returns false if there are none. What they say goes to out, or to console() without
+    // one; triggers go to the current EventManager.
+    bool run(Trigger trigger, Symbol subject, Player &player) const;
+    bool run(Trigger trigger, Symbol subject, Player &player, ostream &out) const;
+
+    // The bytecode, one instruction per line.
+    void disassemble(ostream &out) const;
+
+    // Instructions are 32 bits: an opcode and three register (or stat) operands, or an
+    // opcode, one operand and a signed 16-bit immediate.
+    enum Opcode : uint8_t {
+        END,
+        LOAD_STAT,    // r[a] = stat b
+        LOAD_NUMBER,  // r[a] = immediate
+        STORE_STAT,   // stat a = r[b]
+        ADD,          // r[a] = r[b] + r[c]
+        SUBTRACT,     // r[a] = r[b] - r[c]
+        LESS,         // r[a] = r[b] < r[c]
+        LESS_EQUAL,   // r[a] = r[b] <= r[c]
+        EQUAL,        // r[a] = r[b] == r[c]
+        NOT_EQUAL,    // r[a] = r[b] != r[c]
+        JUMP,         // pc += immediate
+        JUMP_UNLESS,  // if r[a] is 0, pc += immediate
+        SAY,          // prints messages[immediate]
+        TRIGGER,      // triggers the event events[immediate]
+        USE_ITEM,     // runs the use rules of subjects[immediate]
+        HEAL,         // ++player
+        NUMBER_OF_OPCODES
+    };
+    enum Stat { HEALTH, STAMINA, NUMBER_OF_STATS };
+    static const int NUMBER_OF_REGISTERS = 4;
+
+private:
+    static const int MAX_USE_DEPTH = 8; // "use" inside a use rule nests no deeper than this
+
+    vector<uint32_t> code;                          // code[0] is END, where every table entry without rules points
+    vector<uint32_t> entries[NUMBER_OF_TRIGGERS];   // indexed by Symbol
+    vector<string>   messages;
+    vector<string>   events;
+    vector<Symbol>   subjects;
+
+    bool run(Trigger trigger, Symbol subject, Player &player, ostream *out, int depth) const;
+};
+
+// zork --rules-check: compiles a rules file (or the built-in rules), prints the bytecode and
+// times running rules for a subject that has some and for one that has none.
+bool runRulesCheck(const string &path, long events);
+
+//game.h
+class SnapshotPublisher;
+
+class Game
+{
+public:
+    // Without rendering nothing is drawn, not even the start screen, until setRendering(true);
+    // main starts that way when a journal may have a game to recover first.
+    Game(bool rendering = true);
+    ~Game();
+    void reset(bool show_update = true);
+
+    void map();
+    void info();
+    void go(const string &direction);
+    void teleport();
+    void take(const string &itemName);
+    void use(const string &itemName);
+    void inventory();
+    void attack(const string &name);
+    void enemyMove();
+
+    void update_screen();
+
+    // Parts of the status block; whatever a command changes is marked so update_screen
+    // only recomputes and reprints those.
+    enum Section {
+        ROOM_NAME    = 1 << StatusRenderer::ROOM,
+        ROOM_ITEMS   = 1 << StatusRenderer::ITEMS,
+        ROOM_ENEMIES = 1 << StatusRenderer::ENEMIES,
+        ROOM_EXITS   = 1 << StatusRenderer::EXITS,
+        PLAYER_STATS = 1 << StatusRenderer::STATS,
+        EVERYTHING   = (1 << StatusRenderer::NUMBER_OF_LINES) - 1
+    };
+    void markDirty(unsigned int sections);
+
+    Player &getPlayer();
+    void setOver(bool over);
+    bool is_over();
+    void setCurrentRoom(Room *next);
+    // Index of the player's room in the built-in world, or -1.
+    int getPlayerRoom();
+
+    // Every random roll comes from (seed, counter), so a session can be replayed exactly.
+    unsigned int getSeed();
+    void setSeed(unsigned int seed);
+    unsigned int nextRandom();
+
+    // Turns update_screen on or off (off while replaying a journal).
+    void setRendering(bool rendering);
+
+    // Checks that the game state makes sense (no negative stats, every item in exactly one
+    // place). Returns false and describes the first problem found.
+    bool checkInvariants(string &problem);
+
+    // Spectators get a snapshot of the world after every command (see SnapshotPublisher).
+    void setSpectators(SnapshotPublisher *spectators);
+    void publishSnapshot();
+
+    // Writes the parts of the status marked dirty as JSON fields and clears them, like
+    // update_screen does for the screen.
+    void writeState(JsonWriter &json);
+
+    // The whole game state as text, and back again. Used for journal checkpoints.
+    string saveState();
+    bool   loadState(const string &state);
+    // The undo history as text, and back again, so undo goes where it would have after a
+    // checkpoint is recovered. Checkpoints hold both; loadHistory goes after loadState and
+    // keeps the fresh history that started if the text has none.
+    string saveHistory();
+    bool   loadHistory(const string &state);
+
+    // Called after every command: adds a version to the timeline if anything changed.
+    void recordVersion();
+    // The undo, redo and branch commands (see Timeline). Each says what happened.
+    void undo();
+    void redo();
+    void branch(long version);
+    // The version the game is at now, or -1 with history off.
+    long currentVersion();
+    // How many versions are kept for undo; 0 turns history off. Starts history again from now.
+    void setHistoryLimit(size_t limit);
+    // Forgets the history and starts it again from the game as it is now, as version 0.
+    void startTimeline();
+
+    // Runs the world's rules for something that just happened to subject: a room entered,
+    // an item taken or used, an enemy attacked. Returns false if there are none.
+    bool runRules(RuleSet::Trigger trigger, Symbol subject);
+    // Replaces the built-in rules (defaultRules). Returns false and why if they don't compile.
+    bool loadRules(const string &source, string &error);
+
+private:
+    Player      player;
+    vector<Room *> rooms;
+    bool           gameOver;
+    bool           rendering;
+    Enemy          mojo;
+    Item           *key;
+    Item           *sword;
+    unsigned int   seed;
+    unsigned int   rngCounter;
+    unsigned int   dirty;
+    StatusRenderer status;
+    SnapshotPublisher *spectators;
+    vector<unsigned int> publishedRoomVersions;  // each room's version in the last snapshot
+    vector<Item *>       publishedInventory;     // the inventory in the last snapshot
+    long           tick;
+
+    // The world's objects live in the arena; these remember them so they can be destroyed.
+    WorldArena     arena;
+    Item          *worldItems[NUMBER_OF_DEFAULT_ITEMS];
+    Enemy         *worldEnemies[NUMBER_OF_DEFAULT_ENEMIES];
+
+    // What the rules need to know about items (where they are, weight, flags), as components.
+    // worldItems[i] is entity i. Where an item is gets stored twice, in Room::itemsInRoom (or
+    // the inventory) and in entities.position, and every change must update both;
+    // checkInvariants checks they agree.
+    EntityStore    entities;
+
+    // Which rooms the keys the player carries let them into.
+    RoomAccess     access;
+
+    // What happens on entering rooms and taking, using and attacking things.
+    RuleSet        rules;
+
+    Timeline             timeline;
+    vector<unsigned int> recordedRoomVersions;  // each room's version when the timeline last saw it
+    bool                 historyFull;           // the timeline has reached its limit since it started
+    // How many versions that change every room the pools keep room for once the history is
+    // full (see recordVersion). A full history never held more than about twenty such versions'
+    // worth of extra blocks across thousands of seeds, so this leaves some margin.
+    static const size_t  SPARE_VERSIONS = 32;
+
+    GameStatus  currentStatus();
+    shared_ptr<const RoomState> captureRoom(int room);
+    void        captureInventory(GameVersion &version);
+    void        restoreVersion(const GameVersion &from, const GameVersion &to);
+
+    void        destroyItemsAndEnemies();
+    // The entity of one of worldItems; aborts if it isn't one, in every build.
+    Entity      entityOf(Item *item);
+    void        syncItemPositions();
+    
+    bool        enemyCheck();
+    int         roomIndex(Room *room);
+    void        enemiesLine(string &line);
+    void        exitsLine(string &line);
+
+    // Where update_screen builds each status line; reused so redrawing doesn't allocate.
+    string      statusLine;
+};
+
+//golistener.h
+class Game;
+
+// A listener for the Go command
+class GoListener : public EventListener
+{
+public:
+    GoListener(Game *game);
+    void run(void *args) override;
+private:
+    Game  *game;
+    string direction;
+};
+
+//infolistener.h
+class Game;
+
+class InfoListener : public EventListener
+{
+public:
+    InfoListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//inputlistener.h
+// No need to include if we're just using pointers.
+class Game;
+
+// A listener that gets called when a new input is received.
+struct InputListener : EventListener // Structs default to public even in inheritance.
+{
+    InputListener(Game *game);
+    void run(void *args) override;
+
+    // Measures every command (and the screen update after it) from now on.
+    void setProfiler(CommandProfiler *profiler);
+
+private:
+    // We store a game pointer for easy access.
+    Game *game;
+    CommandProfiler *profiler;
+    vector<string> args;
+};
+
+//inventorylistener.h
+class Game;
+
+// A listener for the Inventory command
+class InventoryListener : public EventListener
+{
+public:
+    InventoryListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//journal.h
+class Game;
+
+/** Append-only log of every accepted command, so a session survives the process dying.
+ *  Commands are batched and written with one write + fdatasync per batch (group commit).
+ *  Every so often the whole game state and undo history are written to <path>.ckpt and
+ *  the journal starts over, so recovery never has to replay more than one checkpoint
+ *  interval. */
+class Journal
+{
+public:
+    Journal(Game *game, string path, int batchSize = 128, int checkpointInterval = 5000);
+    ~Journal();
+
+    // Rebuilds the game from the checkpoint and journal on disk (if there are any),
+    // then opens the journal for appending. Returns false if the file can't be opened.
+    bool open();
+
+    // Queues one command; it's written once the batch is full or no more input is waiting.
+    void record(const vector<string> &words);
+
+    // Writes and syncs the pending batch.
+    void commit();
+
+    // Saves the full game state and truncates the journal.
+    void checkpoint();
+
+    long getSequence();
+
+    // Written on the seed line. It goes up whenever the same commands would replay
+    // differently: version 2 teleports with a single random draw. A journal without it
+    // is version 1.
+    static const int FORMAT = 2;
+
+private:
+    Game  *game;
+    string path;
+    int    fd;
+    string pending;
+    int    pendingCount;
+    int    batchSize;
+    int    checkpointInterval;
+    int    sinceCheckpoint;
+    long   sequence;
+
+    long   replay();       // commands replayed, or -1 (after saying why) if it couldn't recover
+    void   writeHeader();
+    int    formatOnDisk();
+};
+
+//journallistener.h
+// A listener that records every accepted command in the journal
+class JournalListener : public EventListener
+{
+public:
+    JournalListener(Journal *journal);
+    void run(void *args) override;
+private:
+    Journal *journal;
+};
+
+//maplistener.h
+class Game;
+// A listener for the map command
+class MapListener : public EventListener
+{
+public:
+    MapListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//memorylistener.h
+// A listener for the memory command: prints how much memory each subsystem is using.
+class MemoryListener : public EventListener
+{
+public:
+    void run(void *args) override;
+};
+
+//restartlistener.h
+class Game;
+
+// A listener for the good ending
+class RestartListener : public EventListener
+{
+public:
+    RestartListener(Game *game);
+    void run(void *args) override;
+private:
+   Game *game;
+};
+
+//replayanalytics.h
+/** Totals over many replayed sessions. Every worker thread fills in its own and they're
+ *  added up once at the end, so workers share nothing while they run and the final sum
+ *  costs the same however big the corpus is. */
+struct ReplayStatistics
+{
+    enum Event { COMMANDS, ENTER_ROOM, CURSE, VICTORY, DEFEAT, RESTART, NUMBER_OF_EVENTS };
+    static const char *eventNames[NUMBER_OF_EVENTS];
+    static const int   MAX_TURNS = 4096; // longer games all count as MAX_TURNS
+
+    long sessions      = 0;
+    long games         = 0;                      // a session plays one more game per restart
+    long cursedDefeats = 0;                      // defeats in games where the curse struck
+    long events[NUMBER_OF_EVENTS]              = {};
+    long roomVisits[NUMBER_OF_DEFAULT_ROOMS]   = {};
+    long roomDeaths[NUMBER_OF_DEFAULT_ROOMS]   = {};
+    long itemTaken[NUMBER_OF_DEFAULT_ITEMS]    = {}; // games in which it was picked up
+    long itemInDefeat[NUMBER_OF_DEFAULT_ITEMS] = {}; // games lost while carrying it
+    vector<long> turnsToVictory = vector<long>(MAX_TURNS + 1); // how many victories took that many turns
+
+    void add(const ReplayStatistics &other);
+    long medianTurnsToVictory() const;
+};
+
+// Replays journals and command scripts on all cores with rendering off and writes the
+// statistics as CSV tables and one columnar binary file, all starting with outputPrefix.
+// A file holds one or more sessions, each starting at a "seed <n>" line; journal lines'
+// sequence numbers are skipped. Returns false if a file can't be read or written.
+bool runAnalytics(const vector<string> &paths, const string &outputPrefix, int threads);
+
+// Writes a script of random sessions to analyse (zork --make-corpus).
+bool writeCorpus(const string &path, long sessions, uint32_t seed);
+
+// Plays every session in a script (or journal) through one game with the screen updates
+// on, rounds times, and prints the fastest round's time per command. It's the workload
+// the Makefile trains PGO builds with and compares the build configurations on.
+bool runBenchmark(const string &path, int rounds);
+
+//room.h
+class Room : public Tracked<TAG_ROOMS>
+{
+private:
+    string name;
+    Symbol symbol;
+    Room *exits[4]; // north, east, south, west
+    int index;      // its place in the world's room list, -1 until it's in one
+
+    Room(string name);
+    // For rooms only ever told apart by index (generated worlds), which needn't fill the
+    // symbol table with millions of names; pass SymbolTable::NO_SYMBOL.
+    Room(string name, Symbol symbol);
+    vector<Item*> itemsInRoom;
+    vector<Enemy*> enemiesInRoom;
+
+    int numberOfItems();
+    const vector<Item*> &getItems();
+    void addItem(Item *inItem);
+    void removeItem(Item*);
+    string displayItems();
+    void displayItems(string &line);  // the same, into a string the caller reuses
+    const string &getName();
+    Symbol getSymbol();
+    void setExits(Room *north, Room *east, Room *south, Room *west);
+    Room *getExit(const string &direction);
+    static int directionIndex(const string &direction);
+    bool hasItem(Item*);
+    bool hasEnemy(Enemy*);
+
+    const vector<Enemy*> &getEnemies();
+    void addEnemy(Enemy *enemy);
+    string displayEnemies();
+    void removeEnemy(Enemy*);
+
+    // Goes up whenever the room's items or enemies change, so a snapshot of it can be
+    // reused until then.
+    unsigned int version;
+    void touch();
+
+    // Guards itemsInRoom, enemiesInRoom and playersInRoom when the room is shared
+    // between threads (see SharedWorld). Exits never change once built, so they need no lock.
+    mutex lock;
+    vector<Player*> playersInRoom;
+
+    public:
+    
+    //6. Friends
+    friend class Game;
+    friend class EnterRoomListener;
+    friend class SharedWorld;
+    friend void buildDefaultRooms(vector<Room *> &rooms, WorldArena *arena);
+    friend struct GeneratedWorld;
+};
+
+// Creates the rooms of the built-in world from defaultRooms and links their exits.
+// With an arena the rooms are placed in it, otherwise they come from the heap.
+void buildDefaultRooms(vector<Room *> &rooms, WorldArena *arena = nullptr);
+
+//roomgraph.h
+/** What RoomGraph::validate found. Each count comes with the first room it was seen in
+ *  (-1 if there were none), to start looking from. */
+struct GraphProblems
+{
+    long danglingExits    = 0;  // exits to a room that doesn't exist
+    long asymmetricLinks  = 0;  // A's exit leads to B, but B's opposite exit doesn't lead back
+    long unreachableRooms = 0;  // can't be reached from the start at all, locked or not
+    long firstDangling    = -1;
+    long firstAsymmetric  = -1;
+    long firstUnreachable = -1;
+
+    bool ok() const;
+};
+
+/** A copy of a generated world's exits in compressed sparse row form, built to validate and
+ *  renumber the world; the world itself (and everything that runs on it) keeps four exits
+ *  per room. Room i's exits are targets[offsets[i]] up to targets[offsets[i + 1]], in north,
+ *  east, south, west order, and bit d of exitMasks[i] says whether there's an exit in
+ *  direction d. */
+struct RoomGraph
+{
+    vector<uint32_t> offsets;     // one per room, plus the end of the last room's exits
+    vector<int32_t>  targets;
+    vector<uint8_t>  exitMasks;
+    vector<uint8_t>  flags;       // GeneratedWorld::Flag
+    long             start   = 0;
+    long             victory = 0;
+
+    static RoomGraph fromWorld(const GeneratedWorld &world);
+    // Writes the graph back as four exits per room, replacing world's rooms.
+    void toWorld(GeneratedWorld &world) const;
+
+    long    numberOfRooms() const;
+    int32_t exit(long room, int direction) const;  // -1 for a wall
+    size_t  bytes() const;
+
+    GraphProblems validate() const;
+
+    // Reverse Cuthill-McKee: a breadth-first order, from low-degree rooms and visiting
+    // neighbours by degree, reversed. Linked rooms end up close together. order[new] = old.
+    vector<int32_t> cuthillMcKee() const;
+    // Renumbers rooms in reverse Cuthill-McKee order if that brings linked rooms closer
+    // together than they already are. Returns true if it did.
+    bool            reorder();
+    RoomGraph       renumbered(const vector<int32_t> &order) const;
+
+    // How far apart linked rooms are numbered, on average; lower means better locality.
+    double meanLinkDistance() const;
+};
+
+//session.h
+/** One self-contained game: its own EventManager (listeners, output, running flag) and Game,
+ *  driven by lines of text instead of cin. Many sessions can live in one process. */
+class Session
+{
+public:
+    // Game output goes to output, or nowhere if it's nullptr.
+    Session(ostream *output = nullptr);
+    ~Session();
+
+    // Runs one line of input through the normal InputListener path.
+    // Returns false once the session has ended (eg. "exit").
+    bool execute(const string &line);
+
+    Game         &getGame();
+    EventManager &getEvents();
+
+private:
+    EventManager   events;
+    Game          *game;
+    InputListener *input;
+};
+
+// Makes a session's EventManager the current one for as long as it's in scope.
+struct SessionScope
+{
+    SessionScope(EventManager &events);
+    ~SessionScope();
+};
+
+//sessionserver.h
+/** Limits for SessionServer. */
+struct ServerSettings
+{
+    string path;                            // where the UNIX socket is created
+    int    maxSessions    = 4096;           // connections past this are told so and closed
+    double idleSeconds    = 600;            // a session with no input for this long is closed
+    size_t maxLineBytes   = 4096;           // a longer line closes the connection
+    size_t maxOutputBytes = 1024 * 1024;    // a client that reads slower than this falls behind is dropped
+};
+
+/** Hosts many independent games in one process, one Session per connection to a UNIX
+ *  domain socket, all served by a single thread with epoll. Sockets are non-blocking;
+ *  input is buffered until a whole line has arrived and output until the socket takes it. */
+class SessionServer
+{
+public:
+    SessionServer(const ServerSettings &settings);
+    ~SessionServer();
+
+    // Creates the socket and starts listening. Prints why and returns false if it can't.
+    bool start();
+
+    // Serves connections until stop() is called.
+    void run();
+
+    // Waits up to timeoutMs for something to happen and deals with it.
+    void poll(int timeoutMs);
+
+    void stop();
+    int  numberOfSessions();
+
+private:
+    struct Connection
+    {
+        int         fd;
+        StringSink  output;      // everything not yet written to the socket
+        ostream     stream;      // the session's console, writing into output
+        Session    *session;
+        string      input;       // bytes read but not yet a complete line
+        bool        writing;     // waiting for the socket to take more output
+        chrono::steady_clock::time_point lastInput;
+
+        Connection(int fd);
+    };
+
+    ServerSettings                settings;
+    int                           listener;
+    int                           epoll;
+    bool                          running;
+    std::map<int, Connection *>   connections;
+    chrono::steady_clock::time_point lastSweep;
+
+    void accept();
+    void read(Connection *connection);
+    bool write(Connection *connection);
+    void close(Connection *connection);
+    void closeIdle();
+};
+
+// zork --serve <path>: runs a server until interrupted.
+bool runServer(const ServerSettings &settings);
+
+// A local client stand-in: starts a server on a temporary socket, connects clients to it
+// and checks the replies, the session limit and the idle timeout.
+bool runServerTest(int clients);
+
+//coroutinesession.h
+// Only when compiled as C++20 (g++ -std=c++20); otherwise --coroutines says it's missing.
+#if __cpp_impl_coroutine
+
+/** Where a session coroutine and its scheduler meet: the line the session is waiting for,
+ *  and everything it has printed since the scheduler last took it. */
+struct SessionMailbox
+{
+    string             line;
+    bool               hasLine  = false;
+    bool               finished = false;
+    coroutine_handle<> waiting;
+    StringSink         output;
+    ostream            stream;
+
+    SessionMailbox();
+
+    // "co_await mailbox.nextLine()" suspends the session until a line has been delivered.
+    struct NextLine
+    {
+        SessionMailbox &mailbox;
+        bool   await_ready();
+        void   await_suspend(coroutine_handle<> session);
+        string await_resume();
+    };
+    NextLine nextLine();
+};
+
+/** The coroutine type of a session. It owns the coroutine's frame, which holds the
+ *  Session itself and the loop's locals: a few hundred bytes, instead of a thread's stack. */
+struct SessionTask
+{
+    struct promise_type
+    {
+        SessionTask    get_return_object();
+        suspend_never  initial_suspend() noexcept;  // runs up to its first co_await straight away
+        suspend_always final_suspend() noexcept;    // the SessionTask destroys the frame
+        void           return_void();
+        void           unhandled_exception();
+
+        // Frames are allocated through here, so their size can be reported.
+        static void *operator new(size_t size);
+        static void  operator delete(void *frame, size_t size);
+        static atomic<size_t> lastFrameSize;
+    };
+
+    coroutine_handle<promise_type> handle;
+
+    SessionTask(coroutine_handle<promise_type> handle);
+    SessionTask(SessionTask &&other);
+    ~SessionTask();
+};
+
+// A whole session as straight-line code: wait for a line, play it, repeat until "exit".
+SessionTask playSession(SessionMailbox &mailbox);
+
+/** Runs any number of session coroutines on the calling thread. deliver() hands a session
+ *  its next line and queues it; runReady() resumes every queued session in turn. */
+class CoroutineScheduler
+{
+public:
+    ~CoroutineScheduler();
+
+    int     spawn();                       // returns the new session's number
+    void    deliver(int session, const string &line);
+    void    runReady();
+
+    string &output(int session);           // what the session printed; clear it once read
+    bool    finished(int session);
+    int     numberOfSessions();
+
+private:
+    vector<SessionMailbox *> mailboxes;
+    vector<SessionTask>      tasks;
+    vector<int>              ready;
+};
+
+#endif
+
+// Runs the same commands through coroutine sessions and through a thread per session and
+// compares memory per session and the cost of switching to a session.
+bool runCoroutineBenchmark(int sessions, int threads, long commands);
+
+//shardedworld.h
+/** A bounded lock-free queue for exactly one producer thread and one consumer thread: a ring
+ *  of CAPACITY slots (a power of two) between a head only the consumer moves and a tail only
+ *  the producer moves. */
+template <typename T, size_t CAPACITY>
+class SpscQueue
+{
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // False if the queue is full.
+    bool push(const T &value)
+    {
+        size_t at = tail.load(memory_order_relaxed);
+        if (at - head.load(memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        slots[at & (CAPACITY - 1)] = value;
+        tail.store(at + 1, memory_order_release);
+        return true;
+    }
+
+    // False if the queue is empty.
+    bool pop(T &value)
+    {
+        size_t at = head.load(memory_order_relaxed);
+        if (at == tail.load(memory_order_acquire)) {
+            return false;
+        }
+        value = slots[at & (CAPACITY - 1)];
+        head.store(at + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "the capacity must be a power of two");
+
+    // On separate cache lines, so the two threads don't keep stealing each other's line.
+    alignas(64) atomic<size_t> head;
+    alignas(64) atomic<size_t> tail;
+    alignas(64) T slots[CAPACITY];
+};
+
+/** A generated world split into regions of consecutive rooms (rows, for grids and mazes),
+ *  each simulated by its own thread. Every tick enemies wander as in EntityStore::wander and
+ *  players take a turn (see playerTo); anything that moves into another region is sent there
+ *  through the queue between the two regions. Arrivals are merged in order of the region they
+ *  came from, so a run gives the same result with any number of regions. */
+class ShardedWorld
+{
+public:
+    static constexpr int MAX_REGIONS = 64;
+
+    ShardedWorld(const GeneratedWorld &world, int regions, uint32_t seed);
+    ~ShardedWorld();
+
+    // Takes the living enemies from the store; each keeps its entity number.
+    void addEnemies(const EntityStore &store);
+    void addPlayer(Entity entity, int32_t room);
+
+    // Runs ticks (numbered from tick onwards) with one thread per region.
+    void run(uint32_t tick, int ticks, int staminaCost);
+
+    // Every entity's room and stamina, indexed by entity (untouched for entities it doesn't have).
+    void collect(vector<int32_t> &position, vector<int32_t> &stamina) const;
+
+    // How many moves so far went from one region to another.
+    long crossings() const;
+
+    // A player's turn: "go" in a direction picked like an enemy's, staying put at a wall or a
+    // locked room as Game::go does, and one turn in 64 a teleport to a random room instead.
+    static int32_t playerTo(const GeneratedWorld &world, int32_t room, uint32_t seed, Entity entity, uint32_t tick);
+
+private:
+    // An entity on its way to another region.
+    struct Traveller
+    {
+        Entity   entity;
+        int32_t  room;
+        int32_t  stamina;
+        uint8_t  flags;
+    };
+    typedef SpscQueue<Traveller, 256> Queue;
+
+    // The entities in one region, as columns like EntityStore's.
+    struct Region
+    {
+        vector<Entity>  entity;
+        vector<int32_t> position;
+        vector<int32_t> stamina;
+        vector<uint8_t> flags;
+        vector<vector<Traveller>> arrivals;  // per region they came from
+        long            crossings = 0;
+
+        void add(const Traveller &traveller);
+    };
+
+    const GeneratedWorld &world;
+    uint32_t              seed;
+    int                   numberOfRegions;
+    long                  roomsPerRegion;
+    vector<Region>        regions;
+    vector<Queue *>       queues;  // from * numberOfRegions + to
+
+    int  regionOf(int32_t room) const;
+    void simulate(int region, uint32_t tick, int staminaCost);
+    void receive(int region);
+    void merge(int region);
+};
+
+// zork --shard: runs the same world with 1, 2, 4 ... maxRegions regions, checks every run
+// ends the same way (and the enemies as EntityStore::wander moves them) and prints throughput.
+bool runShardedSimulation(const GeneratorSettings &settings, int maxRegions, int ticks, long players);
+
+//sharedworld.h
+/** One room graph shared by many players at once, each issuing commands from its own thread.
+ *  Every room has its own lock, so players spread across rooms don't wait on each other,
+ *  and two players racing to take the same item always resolve to exactly one winner.
+ *  Moves cost stamina as in the game (moveStaminaCost), and entering a room, taking an item
+ *  and attacking an enemy run the same rules the game does; what they say goes in the reply,
+ *  and what they trigger reaches no one, as client threads' EventManagers have no listeners. */
+class SharedWorld
+{
+public:
+    // The rules must outlive the world; running them only reads them, from any thread.
+    SharedWorld(const RuleSet *rules);
+    ~SharedWorld();
+
+    // Adds a new player in the starting room and returns their id.
+    int  join(string name);
+
+    // Runs one command line for a player. Anything the player would see is appended to reply.
+    // A player too weak to act spends the command coming back to life at the start instead,
+    // leaving what they carried where they fell; then it returns false.
+    bool execute(int playerId, string line, string &reply);
+
+    int  numberOfPlayers();
+
+    // True if every item is in exactly one room or inventory (used after stress runs).
+    bool itemsConsistent();
+
+private:
+    vector<Room *>   rooms;
+    vector<Player *> players;
+    vector<Item *>   items;
+    deque<uint32_t>  rolls;        // how many random rolls each player has used
+    mutex            playersLock;  // guards players and rolls
+    const RuleSet   *rules;
+
+    void go(Player *player, string direction, string &reply);
+    void take(Player *player, string itemName, string &reply);
+    void drop(Player *player, string itemName, string &reply);
+    void attack(Player *player, uint32_t roll, string name, string &reply);
+    void respawn(Player *player, string &reply);
+    void look(Player *player, string &reply);
+
+    // Runs the rules for what the player just did, adding what they say to reply.
+    void runRules(RuleSet::Trigger trigger, Symbol subject, Player *player, string &reply);
+
+    // The keys carried in a player's inventory.
+    KeySet keysOf(Player *player);
+};
+
+// Runs a shared world with one local client thread per player issuing random commands, for
+// 1, 2, 4 ... up to numberOfPlayers players, and reports the throughput of each. The rules
+// come from rulesPath, or are the built-in ones if it's empty. Returns false if they don't
+// compile or any world ended up inconsistent.
+bool runSharedWorld(int numberOfPlayers, int commandsPerPlayer, const string &rulesPath);
+
+//snapshot.h
+/** A room as spectators see it at one moment. Never changed once published; a room that
+ *  hasn't changed since the last snapshot is shared with it rather than copied. */
+struct RoomSnapshot
+{
+    struct EnemyState
+    {
+        string name;
+        int    health;
+        int    stamina;
+    };
+
+    string             name;
+    unsigned int       version;  // the room's version when this was taken
+    vector<string>     items;
+    vector<EnemyState> enemies;
+};
+
+/** The whole world as spectators see it after one tick (command). It shares everything that
+ *  didn't change with the snapshot before it: the rooms through a PersistentArray, so only
+ *  the path to each changed room is new, and the inventory until it changes. */
+struct WorldSnapshot
+{
+    long           tick;
+    bool           over;
+    int            playerRoom;
+    int            playerHealth;
+    int            playerStamina;
+    shared_ptr<const vector<string>> inventory;
+    int            mojoRoom;     // -1 once mojo is dead
+    int            mojoHealth;
+    int            mojoStamina;
+    PersistentArray<shared_ptr<const RoomSnapshot>> rooms;
+};
+
+/** Hands the latest WorldSnapshot from the simulation thread to any number of readers.
+ *  Reading is wait-free (a couple of atomic loads and stores) and publishing never waits
+ *  for readers: a replaced snapshot is only freed once no reader can still be looking at it,
+ *  which each publish checks for. */
+class SnapshotPublisher
+{
+public:
+    static const int MAX_READERS = 64;
+
+    SnapshotPublisher();
+    ~SnapshotPublisher();
+
+    // Readers: claim a slot once, then acquire/release around each look at the world.
+    // The snapshot returned by acquire stays valid until release. Returns -1 when full.
+    int  addReader();
+    void removeReader(int reader);
+    const WorldSnapshot *acquire(int reader);
+    void release(int reader);
+
+    // The simulation thread: the latest snapshot (to build the next one from) and publishing.
+    const WorldSnapshot *latest();
+    void publish(WorldSnapshot *snapshot);
+
+    long waitingToBeFreed();
+
+private:
+    // Each reader's slot has a cache line to itself, so readers don't slow each other down.
+    struct alignas(64) ReaderSlot
+    {
+        atomic<unsigned long> epoch;  // the epoch it started looking in, 0 while it isn't looking
+        atomic<bool>          taken;
+    };
+
+    atomic<const WorldSnapshot *> current;
+    alignas(64) atomic<unsigned long> epoch;
+    ReaderSlot                    readers[MAX_READERS];
+    // Replaced snapshots, with the epoch in which they stopped being current.
+    vector<pair<unsigned long, const WorldSnapshot *>> retired;
+
+    void reclaim();
+};
+
+// Plays random commands in one game, publishing a snapshot after each, while reader
+// threads watch; checks every snapshot they see is consistent and reports the costs.
+bool runSpectators(int readers, long commands);
+
+//takelistener.h
+class Game;
+// A listener for the Take command
+class TakeListener : public EventListener
+{
+public:
+    TakeListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+    string itemName;
+};
+
+//teleportlistener.h
+class Game;
+// A listener for the Teleport command
+class TeleportListener : public EventListener
+{
+public:
+    TeleportListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//timelinelistener.h
+class Game;
+// A listener for the undo, redo and branch commands
+class TimelineListener : public EventListener
+{
+public:
+    TimelineListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+};
+
+//uselistener.h
+class Game;
+
+// A listener for the Use command
+class UseListener : public EventListener
+{
+public:
+    UseListener(Game *game);
+    void run(void *args) override;
+private:
+    Game *game;
+    string itemName;
+};
+
+//victorylistener.h
+class Game;
+// A listener for the good ending
+class VictoryListener : public EventListener
+{
+public:
+    VictoryListener(Game *game);
+    void run(void *args) override;
+private:
+   Game *game;
+};
+
+//weapon.h
+//2. Inheritance (including virtual methods) and cascading constructors
+class Weapon : public Item {
+
+public:
+
+    Weapon (string description, float inWeight, int multiplier);
+
+protected:
+//7. Virtual functions and polymorphism
+//10. Dynamic and static dispatch
+    void formatLongDescription(string &out) override;
+
+};
+
+//attacklistener.cpp
+AttackListener::AttackListener(Game *game)
+{
+    this->game = game;
+    enemyName = "";
+}
+
+void AttackListener::run(void *args_ptr)
+{
+    if (game->is_over()) {
+        return;
+    }
+
+    vector<string> *args = (vector<string> *) args_ptr;
+
+    if (args->size() > 1) {
+        game->attack(args->at(1));
+    } else {
+        console() << "Need to specify an enemy to attack!" << endl;
+    }
+}
+
+//character.cpp
+
+//9. Initializer list
+Character::Character(string name) : name(name), symbol(SymbolTable::intern(name))
+{ 
+    health      = 100;
+    stamina     = 100;
+    currentRoom = nullptr;
+    console() << "Character created (base class)" << endl;
+}
+
+//1. Destructors 
+Character::~Character() {
+  console() << "Character destructor: Goodbye cruel world!" << endl;
+}
+
+const string &Character::getName()
+{
+    return name;
+}
+
+Symbol Character::getSymbol()
+{
+    return symbol;
+}
+
+int Character::getHealth()
+{
+    return health;
+}
+
+int Character::getStamina()
+{
+    return stamina;
+}
+
+Room *Character::getCurrentRoom()
+{
+    return currentRoom;
+}
+
+void Character::setName(string name)
+{
+    this->name   = name;
+    this->symbol = SymbolTable::intern(name);
+}
+
+void Character::setCurrentRoom(Room *next)
+{
+    currentRoom = next;
+}
+
+//characterdeathlistener.cpp
+
+CharacterDeathListener::CharacterDeathListener(Game *game)
+{
+    this->game = game;
+}
+
+void CharacterDeathListener::run(void *args)
+{
+    if (game->is_over()) {
+        return;
+    }
+
+    Player *character = (Player *) args;
+
+    if (character->getSymbol() == game->getPlayer().getSymbol()) {
+        EventManager::getInstance().trigger("defeat");
+    }
+}
+
+//combat.cpp
+void CombatBatch::add(int attackerHealth, int defenderHealth, int multiplier, int damage)
+{
+    this->attackerHealth.push_back(attackerHealth);
+    this->defenderHealth.push_back(defenderHealth);
+    this->multiplier.push_back(multiplier);
+    this->damage.push_back(damage);
+    hit.push_back(0);
+}
+
+size_t CombatBatch::size() const
+{
+    return attackerHealth.size();
+}
+
+void CombatBatch::resolveScalar(uint32_t seed, uint32_t firstCounter)
+{
+    for (size_t i = 0; i < size(); i++) {
+        uint32_t roll = randomAt(seed, firstCounter + 1 + (uint32_t) i);
+        if (attackHits(roll, multiplier[i])) {
+            defenderHealth[i] = max(0, defenderHealth[i] - damage[i]);
+            hit[i] = 1;
+        } else {
+            attackerHealth[i] = max(0, attackerHealth[i] - MISS_DAMAGE);
+            hit[i] = 0;
+        }
+    }
+}
+
+namespace {
+
+// GCC/Clang vector extensions: plain arithmetic on these compiles to SSE/AVX/NEON.
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef int32_t  i32x8 __attribute__((vector_size(32)));
+
+} // namespace
+
+void CombatBatch::resolve(uint32_t seed, uint32_t firstCounter)
+{
+    const size_t LANES = 8;
+    const i32x8 zero = {};
+    const u32x8 laneIndex = {0, 1, 2, 3, 4, 5, 6, 7};
+
+    size_t i = 0;
+    for (; i + LANES <= size(); i += LANES) {
+        // randomAt and attackHits, eight at a time.
+        u32x8 x = seed + 0x9e3779b9u * (firstCounter + 1 + (uint32_t) i + laneIndex);
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        // memcpy in and out of the arrays, which needn't be 32-byte aligned.
+        i32x8 bonus, hurt, defender, attacker;
+        memcpy(&bonus,    &multiplier[i],     sizeof(bonus));
+        memcpy(&hurt,     &damage[i],         sizeof(hurt));
+        memcpy(&defender, &defenderHealth[i], sizeof(defender));
+        memcpy(&attacker, &attackerHealth[i], sizeof(attacker));
+
+        i32x8 landed = (i32x8) (x % 20u) + bonus >= 10;  // all ones where the attack lands
+        defender -= landed & hurt;
+        attacker -= ~landed & MISS_DAMAGE;
+        defender = defender < zero ? zero : defender;
+        attacker = attacker < zero ? zero : attacker;
+
+        memcpy(&defenderHealth[i], &defender, sizeof(defender));
+        memcpy(&attackerHealth[i], &attacker, sizeof(attacker));
+        for (size_t lane = 0; lane < LANES; lane++) {
+            hit[i + lane] = landed[lane] & 1;
+        }
+    }
+
+    // The last few pairs that don't fill a vector.
+    for (; i < size(); i++) {
+        uint32_t roll = randomAt(seed, firstCounter + 1 + (uint32_t) i);
+        bool landed = attackHits(roll, multiplier[i]);
+        defenderHealth[i] = max(0, defenderHealth[i] - (landed ? damage[i] : 0));
+        attackerHealth[i] = max(0, attackerHealth[i] - (landed ? 0 : MISS_DAMAGE));
+        hit[i] = landed;
+    }
+}
+
+bool runCombatBenchmark(long pairs, uint32_t seed)
+{
+    // A mix like the real game: half the attackers have the sword, enemies take 15 or 20.
+    CombatBatch batch;
+    for (long i = 0; i < pairs; i++) {
+        uint32_t r = randomAt(~seed, i);
+        batch.add(100, 100, (r & 1) ? 5 : 0, (r & 2) ? 15 : 20);
+    }
+    CombatBatch scalar = batch;
+
+    auto start = chrono::steady_clock::now();
+    scalar.resolveScalar(seed, 0);
+    double scalarTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    batch.resolve(seed, 0);
+    double batchTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool same = batch.attackerHealth == scalar.attackerHealth && batch.defenderHealth == scalar.defenderHealth
+             && batch.hit == scalar.hit;
+    long hits = std::count(batch.hit.begin(), batch.hit.end(), 1);
+
+    cout << pairs << " attacks, seed " << seed << ", " << hits << " landed" << endl;
+    cout << "Scalar: " << scalarTime << "s (" << pairs / max(scalarTime, 1e-9) / 1e6 << "M rolls/s)" << endl;
+    cout << "Batch:  " << batchTime << "s (" << pairs / max(batchTime, 1e-9) / 1e6 << "M rolls/s)" << endl;
+    cout << "Results " << (same ? "match" : "DIFFER") << endl;
+    return same;
+}
+
+//commandprofiler.cpp
+namespace {
+
+const char *counterNames[CommandProfiler::NUMBER_OF_COUNTERS] = {"cycles", "instr", "cache-miss", "br-miss"};
+
+int openCounter(uint64_t config, int group)
+{
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size           = sizeof(attributes);
+    attributes.type           = PERF_TYPE_HARDWARE;
+    attributes.config         = config;
+    attributes.read_format    = PERF_FORMAT_GROUP;
+    attributes.disabled       = group < 0;
+    attributes.exclude_kernel = 1; // allowed without privileges at perf_event_paranoid 2
+    attributes.exclude_hv     = 1;
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+} // namespace
+
+CommandProfiler::CommandProfiler()
+{
+    const uint64_t configs[NUMBER_OF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                  PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    leader = -1;
+    opened = 0;
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+        fds[i] = openCounter(configs[i], leader);
+        groupIndex[i] = fds[i] >= 0 ? opened++ : -1;
+        if (leader < 0) {
+            leader = fds[i];
+        }
+        started[i] = 0;
+    }
+
+    if (leader < 0) {
+        cerr << "Hardware counters unavailable (" << strerror(errno) << "), profiling with the clock only" << endl;
+        return;
+    }
+    // The counters run the whole time; begin/end only read them.
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+CommandProfiler::~CommandProfiler()
+{
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+}
+
+bool CommandProfiler::hasCounters()
+{
+    return leader >= 0;
+}
+
+bool CommandProfiler::readCounters(uint64_t *values)
+{
+    // A group read is one syscall for all of them: the number of counters, then each value.
+    uint64_t buffer[1 + NUMBER_OF_COUNTERS];
+    if (leader < 0 || read(leader, buffer, sizeof(buffer)) < (ssize_t) ((1 + opened) * sizeof(uint64_t))) {
+        return false;
+    }
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+        values[i] = groupIndex[i] >= 0 ? buffer[1 + groupIndex[i]] : 0;
+    }
+    return true;
+}
+
+void CommandProfiler::begin()
+{
+    readCounters(started);
+    startedAt = chrono::steady_clock::now();
+}
+
+void CommandProfiler::end(const string &name)
+{
+    auto finishedAt = chrono::steady_clock::now();
+    uint64_t finished[NUMBER_OF_COUNTERS];
+    bool counted = readCounters(finished);
+
+    Totals &command = totals[name];
+    command.count++;
+    command.nanoseconds += chrono::duration<double, nano>(finishedAt - startedAt).count();
+    if (counted) {
+        for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+            command.counters[i] += finished[i] - started[i];
+        }
+    }
+}
+
+void CommandProfiler::report(ostream &out)
+{
+    vector<pair<string, Totals>> rows(totals.begin(), totals.end());
+    sort(rows.begin(), rows.end(), [](const pair<string, Totals> &a, const pair<string, Totals> &b) {
+        return a.second.nanoseconds / a.second.count > b.second.nanoseconds / b.second.count;
+    });
+
+    char line[160];
+    out << "Per command, averages" << (hasCounters() ? " (user-space counters):" : " (clock only):") << endl;
+    out << "  command          count         ns";
+    for (int i = 0; i < NUMBER_OF_COUNTERS && hasCounters(); i++) {
+        if (fds[i] >= 0) {
+            snprintf(line, sizeof(line), " %11s", counterNames[i]);
+            out << line;
+        }
+    }
+    out << (hasCounters() ? "    IPC" : "") << endl;
+
+    for (auto &row : rows) {
+        const Totals &command = row.second;
+        snprintf(line, sizeof(line), "  %-14s %7ld %10.0f", row.first.c_str(), command.count,
+                 command.nanoseconds / command.count);
+        out << line;
+        for (int i = 0; i < NUMBER_OF_COUNTERS && hasCounters(); i++) {
+            if (fds[i] >= 0) {
+                snprintf(line, sizeof(line), " %11.0f", (double) command.counters[i] / command.count);
+                out << line;
+            }
+        }
+        if (hasCounters()) {
+            double cycles = command.counters[CYCLES];
+            snprintf(line, sizeof(line), " %6.2f", cycles > 0 ? command.counters[INSTRUCTIONS] / cycles : 0.0);
+            out << line;
+        }
+        out << endl;
+    }
+}
+
+//defeatlistener.cpp
+DefeatListener::DefeatListener(Game *game)
+{
+    this->game = game;
+}
+
+void DefeatListener::run(void *)
+{
+    console() << endl;
+    console() << "Defeat!" << endl;
+    game->setOver(true);
+}
+
+//enemy.cpp
+
+//2. Inheritance (including virtual methods) and cascading constructors
+//9. Initializer list
+Enemy::Enemy(string name, string description) : Character(name), description(description)
+{
+    console() << "Enemy created (child class)" << endl;
+}
+
+//1. Destructors
+Enemy::~Enemy() {
+    console() << "Enemy destructor: Bye bye" << endl;
+}
+
+string Enemy::getDescription()
+{
+    return description;
+}
+
+//8. Abstract classes and pure virtual functions
+void Enemy::setDescription(string description)
+{
+    this->description = description;
+}
+
+//8. Abstract classes and pure virtual functions
+void Enemy::setHealth(int health)
+{
+    if (health <= 0) {
+        health = 0;
+    }
+
+    this->health = health;
+}
+
+void Enemy::setStamina(int stamina)
+{
+    if (stamina <= 0) {
+        stamina = 0;
+    }
+
+    this->stamina = stamina;
+}
+
+//5. Binary Operator Overloading
+bool operator==(const Enemy &e1, const Enemy &e2) {
+    return e1.symbol == e2.symbol;
+}
+
+//enterroomlistener.cpp
+
+EnterRoomListener::EnterRoomListener(Game *game)
+{
+    this->game = game;
+}
+
+void EnterRoomListener::run(void *args)
+{
+    if (game->is_over()) {
+        return;
+    }
+
+    Room *room = (Room *) args;
+    game->runRules(RuleSet::ENTER, room->getSymbol());
+}
+
+//entitystore.cpp
+Entity EntityStore::create(int32_t room, uint8_t flags)
+{
+    position.push_back(room);
+    health.push_back(0);
+    stamina.push_back(0);
+    weight.push_back(0);
+    multiplier.push_back(0);
+    this->flags.push_back(flags);
+    return position.size() - 1;
+}
+
+Entity EntityStore::createItem(int32_t room, float weight, int multiplier, uint8_t flags)
+{
+    if (multiplier > 0) {
+        flags |= WEAPON;
+    }
+    Entity entity = create(room, flags | ITEM);
+    this->weight[entity]     = weight;
+    this->multiplier[entity] = multiplier;
+    return entity;
+}
+
+Entity EntityStore::createEnemy(int32_t room, int health, int stamina)
+{
+    Entity entity = create(room, ENEMY);
+    this->health[entity]  = health;
+    this->stamina[entity] = stamina;
+    return entity;
+}
+
+void EntityStore::reserve(size_t entities)
+{
+    position.reserve(entities);
+    health.reserve(entities);
+    stamina.reserve(entities);
+    weight.reserve(entities);
+    multiplier.reserve(entities);
+    flags.reserve(entities);
+}
+
+void EntityStore::clear()
+{
+    // clear() keeps the capacity, so a restart doesn't allocate again.
+    position.clear();
+    health.clear();
+    stamina.clear();
+    weight.clear();
+    multiplier.clear();
+    flags.clear();
+}
+
+size_t EntityStore::size() const
+{
+    return position.size();
+}
+
+bool EntityStore::has(Entity entity, uint8_t flag) const
+{
+    return (flags[entity] & flag) == flag;
+}
+
+double EntityStore::carriedWeight() const
+{
+    double total = 0;
+    for (size_t i = 0; i < position.size(); i++) {
+        if (position[i] == CARRIED) {
+            total += weight[i];
+        }
+    }
+    return total;
+}
+
+bool EntityStore::carrying(uint8_t flag) const
+{
+    for (size_t i = 0; i < position.size(); i++) {
+        if (position[i] == CARRIED && (flags[i] & flag) == flag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int EntityStore::carriedMultiplier() const
+{
+    int best = 0;
+    for (size_t i = 0; i < position.size(); i++) {
+        if (position[i] == CARRIED && (flags[i] & WEAPON)) {
+            best = max(best, multiplier[i]);
+        }
+    }
+    return best;
+}
+
+EntityColumns EntityStore::columns()
+{
+    return {position.data(), health.data(), stamina.data(), weight.data(), multiplier.data(), flags.data(), size()};
+}
+
+long EntityStore::wander(const vector<int32_t> &exits, uint32_t seed, uint32_t tick, int staminaCost)
+{
+    return wander(columns(), exits.data(), seed, tick, staminaCost);
+}
+
+long EntityStore::wander(EntityColumns entities, const int32_t *exits, uint32_t seed, uint32_t tick, int staminaCost)
+{
+    int32_t *position = entities.position;
+    int32_t *stamina  = entities.stamina;
+    uint8_t *flags    = entities.flags;
+
+    long alive = 0;
+    for (size_t i = 0; i < entities.count; i++) {
+        if ((flags[i] & (ENEMY | DEAD)) != ENEMY) {
+            continue;
+        }
+
+        position[i] = wanderTo(exits, position[i], seed, i, tick);
+
+        stamina[i] -= staminaCost;
+        if (stamina[i] <= 0) {
+            stamina[i] = 0;
+            flags[i] |= DEAD;
+        } else {
+            alive++;
+        }
+    }
+    return alive;
+}
+
+int32_t EntityStore::wanderTo(const int32_t *exits, int32_t room, uint32_t seed, Entity entity, uint32_t tick)
+{
+    // Keyed by tick and entity so the order of the loop doesn't matter.
+    uint32_t x = randomAt(seed + 0x85ebca6bu * entity, tick);
+
+    // Try directions from the picked one round to the first that isn't a wall.
+    const int32_t *roomExits = &exits[(size_t) room * 4];
+    for (int turn = 0; turn < 4; turn++) {
+        int32_t next = roomExits[(x + turn) & 3];
+        if (next >= 0) {
+            return next;
+        }
+    }
+    return room;
+}
+
+//eventmanager.cpp
+/** Converts strings from UPPERCASE or MiXedCasE to lowercase. */
+// This is a regular old C-style function not a method.
+string tolower(const string &s)
+{
+    string ns;
+    for (auto c : s) {
+        ns += tolower(c);
+    }
+    return ns;
+}
+
+EventManager::EventManager()
+{
+    running = true;
+    out     = &cout;
+}
+
+ostream &console()
+{
+    return EventManager::getInstance().output();
+}
+
+ostream &EventManager::output()
+{
+    return *out;
+}
+
+void EventManager::setOutput(ostream *output)
+{
+    out = output;
+}
+
+void EventManager::mute()
+{
+    // A stream without a buffer is permanently bad, so every << on it returns straight away.
+    static thread_local ostream nowhere(nullptr);
+    out = &nowhere;
+}
+
+const vector<EventListener*> *EventManager::listenersOf(const string &event_name)
+{
+    // find() instead of intern() so a made-up command never adds a symbol.
+    Symbol symbol = SymbolTable::find(event_name);
+    return symbol < registeredEvents.size() ? &registeredEvents[symbol] : nullptr;
+}
+
+bool EventManager::has_listeners(const string &event_name)
+{
+    auto found = listenersOf(tolower(event_name));
+    return found != nullptr && !found->empty();
+}
+
+thread_local EventManager *EventManager::current = nullptr;
+
+EventManager &EventManager::getInstance()
+{
+    if (current != nullptr) {
+        return *current;
+    }
+    // static inside functions creates an instance of this variable for all the calls of this function, and initializes only once.
+    // thread_local gives every thread its own, so threads never share listeners by accident.
+    static thread_local EventManager instance;
+    return instance;
+}
+
+void EventManager::setInstance(EventManager *instance)
+{
+    current = instance;
+}
+
+void EventManager::listen(const string &event_name, EventListener *listener)
+{
+    Symbol symbol = SymbolTable::intern(tolower(event_name));
+    if (symbol >= registeredEvents.size()) {
+        registeredEvents.resize(symbol + 1);
+    }
+    registeredEvents[symbol].push_back(listener);
+}
+
+void EventManager::trigger(const string &event_name, void *args)
+{
+    // Only reads registeredEvents, which keeps trigger safe to call from several threads at once.
+    auto found = listenersOf(tolower(event_name));
+    if (found == nullptr) {
+        return;
+    }
+    for (auto listener : *found) {
+        listener->run(args);
+    }
+}
+
+bool EventManager::is_running()
+{
+    return running;
+}
+
+void EventManager::stop()
+{
+    running = false;
+}
+
+void EventManager::check_events()
+{
+    string buffer;
+    buffer.swap(spareLine);
+
+    console() << "> ";               // print prompt
+    if (!getline(cin, buffer, '\n')) {	// read a line from cin to "buffer"
+        stop();                 // end of input, nothing more will come
+        return;
+    }
+    dispatch(buffer);
+    spareLine.swap(buffer);
+}
+
+void EventManager::dispatch(const string &buffer)
+{
+    MemoryScope scope(TAG_STRINGS);
+    vector<string> words;
+    words.swap(spareWords);
+    words.clear();  // keeps its capacity
+
+    string::size_type pos = 0, last_pos = 0;
+
+    // Break "buffer" up by spaces, lowercasing as we go
+    bool finished = false;
+    while (!finished) {
+        pos = buffer.find_first_of(' ', last_pos);	// find and remember first space.
+        if (pos == string::npos ) {			// if we found the last word,
+            pos = buffer.size();
+            finished = true;				// and finish searching.
+        }
+        words.emplace_back();                       // add it to vector "words"
+        for (string::size_type i = last_pos; i < pos; i++) {
+            words.back() += tolower(buffer[i]);
+        }
+        last_pos = pos + 1;                         // and move on to next word.
+    }
+
+    trigger("input", &words);
+    spareWords.swap(words);
+}
+
+void EventManager::event_loop()
+{
+    EventManager &eventManager = EventManager::getInstance();
+
+    while (eventManager.is_running()) {
+        eventManager.check_events();
+    }
+}
+
+//exitlistener.cpp
+
+ExitListener::ExitListener(Game *game)
+{
+    this->game = game;
+}
+
+void ExitListener::run(void *)
+{
+    EventManager::getInstance().stop();
+}
+
+//memorytracker.cpp
+namespace {
+
+// Each allocation carries a small header in front of it saying how big it is and
+// which tag paid for it, so it can be taken off the right tag when freed.
+struct AllocationHeader
+{
+    size_t    size;
+    MemoryTag tag;
+};
+const size_t HEADER_SIZE = 16; // keeps the memory handed out 16-byte aligned, like malloc's
+static_assert(sizeof(AllocationHeader) <= HEADER_SIZE, "allocation header too big");
+
+struct TagCounters
+{
+    atomic<long> liveBytes;
+    atomic<long> peakBytes;
+    atomic<long> allocations;
+};
+
+TagCounters counters[NUMBER_OF_TAGS];
+const char *tagNames[NUMBER_OF_TAGS] = {"other", "rooms", "items", "enemies", "listeners", "strings", "history", "pools"};
+const auto processStart = chrono::steady_clock::now();
+
+} // namespace
+
+thread_local MemoryTag MemoryTracker::tag = TAG_OTHER;
+
+MemoryTag MemoryTracker::currentTag()
+{
+    return tag;
+}
+
+void *MemoryTracker::allocate(size_t size)
+{
+    // A size this close to the top would wrap around once the header is added.
+    if (size > SIZE_MAX - HEADER_SIZE) {
+        throw bad_alloc();
+    }
+    char *block = (char *) malloc(size + HEADER_SIZE);
+    if (block == nullptr) {
+        throw bad_alloc();
+    }
+    AllocationHeader *header = (AllocationHeader *) block;
+    header->size = size;
+    header->tag  = tag;
+
+    TagCounters &counter = counters[tag];
+    counter.allocations.fetch_add(1, memory_order_relaxed);
+    long live = counter.liveBytes.fetch_add(size, memory_order_relaxed) + size;
+    long peak = counter.peakBytes.load(memory_order_relaxed);
+    while (live > peak && !counter.peakBytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {
+    }
+    return block + HEADER_SIZE;
+}
+
+void MemoryTracker::release(void *pointer)
+{
+    if (pointer == nullptr) {
+        return;
+    }
+    char *block = (char *) pointer - HEADER_SIZE;
+    AllocationHeader *header = (AllocationHeader *) block;
+    counters[header->tag].liveBytes.fetch_sub(header->size, memory_order_relaxed);
+    free(block);
+}
+
+long MemoryTracker::totalAllocations()
+{
+    long total = 0;
+    for (auto &counter : counters) {
+        total += counter.allocations;
+    }
+    return total;
+}
+
+long MemoryTracker::totalLiveBytes()
+{
+    long total = 0;
+    for (auto &counter : counters) {
+        total += counter.liveBytes;
+    }
+    return total;
+}
+
+long MemoryTracker::liveBytes(MemoryTag tag)
+{
+    return counters[tag].liveBytes;
+}
+
+void MemoryTracker::report(ostream &out)
+{
+    double seconds = max(1e-9, chrono::duration<double>(chrono::steady_clock::now() - processStart).count());
+
+    out << "Memory by subsystem:" << endl;
+    out << "  tag         live bytes   peak bytes   allocations   allocs/s" << endl;
+    for (int i = 0; i < NUMBER_OF_TAGS; i++) {
+        char line[128];
+        snprintf(line, sizeof(line), "  %-10s %11ld  %11ld  %12ld  %9.0f", tagNames[i],
+                 counters[i].liveBytes.load(), counters[i].peakBytes.load(),
+                 counters[i].allocations.load(), counters[i].allocations / seconds);
+        out << line << endl;
+    }
+}
+
+void MemoryTracker::reportAtExit()
+{
+    atexit([] {
+        cerr << "At exit (anything still live was never freed, except pools, which keep their blocks for reuse)" << endl;
+        report(cerr);
+    });
+}
+
+MemoryScope::MemoryScope(MemoryTag tag)
+{
+    previous = MemoryTracker::tag;
+    MemoryTracker::tag = tag;
+}
+
+MemoryScope::~MemoryScope()
+{
+    MemoryTracker::tag = previous;
+}
+
+void *operator new(size_t size)
+{
+    return MemoryTracker::allocate(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    MemoryTracker::release(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    MemoryTracker::release(pointer);
+}
+
+//player.cpp
+
+//2. Inheritance (including virtual methods) and cascading constructors
+//9. Initializer list
+Player::Player(string newName): Character(newName) {
+    console() << "Player created (child class)" << endl;
+}
+
+
+//1. Destructors
+Player::~Player() {
+    console() << "Player destructor: The end is nigh" << endl;
+}
+
+//8. Abstract classes and pure virtual functions
+void Player::setHealth(int health)
+{
+    if (health <= 0) {
+        health = 0;
+        EventManager::getInstance().trigger("characterDeath", this);
+    }
+
+    this->health = health;
+}
+
+//8. Abstract classes and pure virtual functions
+void Player::setStamina(int stamina)
+{
+    if (stamina <= 0) {
+        stamina = 0;
+        EventManager::getInstance().trigger("characterDeath", this);
+    }
+
+    this->stamina = stamina;
+}
+
+const string &Player::getItems() { 
+    MemoryScope scope(TAG_STRINGS);
+    inventoryText.clear(); // keeps its capacity
+    inventoryText += "\nInventory:\n";
+    for (vector<Item*>::iterator it = itemInventory.begin(); it != itemInventory.end(); it++) {
+        inventoryText += '\t';
+        inventoryText += (*it)->getLongDescription();
+        inventoryText += '\n';
+    }
+    return inventoryText;
+}
+
+void Player::reserveItemsText(size_t descriptionsLength) {
+    MemoryScope scope(TAG_STRINGS);
+    inventoryText.reserve(strlen("\nInventory:\n") + descriptionsLength);
+}
+
+void Player::addItem(Item *newItem) {
+    if (! (std::find(itemInventory.begin(), itemInventory.end(), newItem) != itemInventory.end() )) {
+        itemInventory.push_back(newItem);
+        console() << "You have picked up a new item! It has been added to your inventory.\n"; 
+    }
+}
+
+bool Player::hasItem(Symbol item) {
+    for (unsigned int i = 0; i < itemInventory.size(); i++) {
+        if (itemInventory.at(i)->getSymbol() == item) {
+                return true;
+        }
+    }
+    return false;
+}
+
+void Player::emptyInventory() { this->itemInventory.clear(); }
+
+void Player::removeItem(Item *newItem) {
+        // Only step forward when nothing was erased, otherwise the next item would be skipped.
+        for (unsigned int i = 0; i < itemInventory.size(); ) {
+            //5. Binary Operator Overloading (Item class)
+            if(itemInventory.at(i) == newItem) {
+                itemInventory.erase(itemInventory.begin() + i);
+            } else {
+                i++;
+            }
+        }
+}
+
+//4. Unary Operator Overloading
+void Player::operator--() {
+    health = health - 20;
+}
+
+//4. Unary Operator Overloading
+void Player::operator++() {
+    health = health + 20;
+}
+
+//stringsink.cpp
+int StringSink::overflow(int c)
+{
+    if (c != EOF) {
+        text += (char) c;
+    }
+    return c;
+}
+
+streamsize StringSink::xsputn(const char *s, streamsize count)
+{
+    text.append(s, count);
+    return count;
+}
+
+//protocolserver.cpp
+ProtocolServer::ProtocolServer(Game *game, istream &in, ostream &out) :
+    in(in),
+    out(out),
+    captured(&capture)
+{
+    this->game = game;
+    previousOutput = &EventManager::getInstance().output();
+    EventManager::getInstance().setOutput(&captured);
+
+    // The screen isn't drawn; the first reply carries the whole state instead.
+    game->setRendering(false);
+    game->markDirty(Game::EVERYTHING);
+}
+
+ProtocolServer::~ProtocolServer()
+{
+    EventManager::getInstance().setOutput(previousOutput);
+}
+
+void ProtocolServer::run()
+{
+    EventManager &events = EventManager::getInstance();
+    string line;
+
+    while (events.is_running() && getline(in, line)) {
+        handle(line);
+        // Keep collecting replies while pipelined requests are already buffered.
+        if (in.rdbuf()->in_avail() <= 0 || pending.size() >= FLUSH_BYTES) {
+            flush();
+        }
+    }
+    flush();
+}
+
+void ProtocolServer::handle(const string &line)
+{
+    if (line.find_first_not_of(" \t\r") == string::npos) {
+        return;
+    }
+
+    JsonWriter json(pending);
+    json.beginObject();
+
+    if (!parseRequest(line, id, command)) {
+        json.key("id").raw("null").key("ok").value(false).key("error").value("bad request");
+    } else {
+        json.key("id").raw(id.empty() ? "null" : id);
+
+        string name = command.substr(0, command.find(' '));
+        if (!EventManager::getInstance().has_listeners(name)) {
+            json.key("ok").value(false).key("error").value("unknown command");
+        } else {
+            capture.text.clear();
+            EventManager::getInstance().dispatch(command);
+            json.key("ok").value(true).key("text").value(capture.text);
+        }
+    }
+
+    json.key("state").beginObject();
+    game->writeState(json);
+    json.endObject();
+
+    json.endObject();
+    pending += '\n';
+}
+
+void ProtocolServer::flush()
+{
+    if (!pending.empty()) {
+        out.write(pending.data(), pending.size());
+        pending.clear();
+    }
+    out.flush();
+}
+
+namespace {
+
+void skipSpaces(string_view line, size_t &at)
+{
+    while (at < line.size() && isspace((unsigned char) line[at])) {
+        at++;
+    }
+}
+
+// Reads a JSON string starting at the opening quote, unescaping it into text.
+bool readString(string_view line, size_t &at, string &text)
+{
+    text.clear();
+    if (at >= line.size() || line[at] != '"') {
+        return false;
+    }
+    for (at++; at < line.size(); at++) {
+        char c = line[at];
+        if (c == '"') {
+            at++;
+            return true;
+        }
+        if (c != '\\') {
+            text += c;
+            continue;
+        }
+        if (++at >= line.size()) {
+            return false;
+        }
+        switch (line[at]) {
+        case 'n': text += '\n'; break;
+        case 't': text += '\t'; break;
+        case 'r': text += '\r'; break;
+        case 'b': text += '\b'; break;
+        case 'f': text += '\f'; break;
+        case 'u': {
+            // Commands are plain ASCII; anything past that can't name a command anyway.
+            if (at + 4 >= line.size()) {
+                return false;
+            }
+            unsigned code = 0;
+            from_chars(line.data() + at + 1, line.data() + at + 5, code, 16);
+            text += code < 0x80 ? (char) code : '?';
+            at += 4;
+            break;
+        }
+        default: text += line[at]; break; // \" \\ \/
+        }
+    }
+    return false;
+}
+
+// Skips a number, true, false or null and returns where it started.
+size_t skipScalar(string_view line, size_t &at)
+{
+    size_t start = at;
+    while (at < line.size() && line[at] != ',' && line[at] != '}' && !isspace((unsigned char) line[at])) {
+        at++;
+    }
+    return start;
+}
+
+} // namespace
+
+bool parseRequest(string_view line, string &id, string &command)
+{
+    id.clear();
+    command.clear();
+
+    size_t at = 0;
+    skipSpaces(line, at);
+    if (at >= line.size() || line[at++] != '{') {
+        return false;
+    }
+
+    string name, text;
+    bool haveCommand = false;
+    while (true) {
+        skipSpaces(line, at);
+        if (!readString(line, at, name)) {
+            return false;
+        }
+        skipSpaces(line, at);
+        if (at >= line.size() || line[at++] != ':') {
+            return false;
+        }
+        skipSpaces(line, at);
+
+        if (at < line.size() && line[at] == '"') {
+            size_t start = at;
+            if (!readString(line, at, text)) {
+                return false;
+            }
+            if (name == "id") {
+                id.assign(line.substr(start, at - start));
+            } else if (name == "cmd" || name == "command") {
+                command = text;
+                haveCommand = true;
+            }
+        } else {
+            size_t start = skipScalar(line, at);
+            if (start == at || line[start] == '{' || line[start] == '[') {
+                return false; // nested objects and arrays aren't part of a request
+            }
+            if (name == "id") {
+                id.assign(line.substr(start, at - start));
+            }
+        }
+
+        skipSpaces(line, at);
+        if (at >= line.size()) {
+            return false;
+        }
+        if (line[at] == '}') {
+            return haveCommand;
+        }
+        if (line[at++] != ',') {
+            return false;
+        }
+    }
+}
+
+//game.cpp
+namespace {
+
+// Writes a number onto the end of a status line without a to_string temporary.
+void appendNumber(string &line, int number)
+{
+    char digits[12];
+    line.append(digits, to_chars(digits, digits + sizeof(digits), number).ptr);
+}
+
+} // namespace
+
+Game::Game(bool rendering) :
+    player("Hero"),
+    mojo("mojo", "is a moving enemy")
+{
+    this->rendering = rendering;
+    dirty      = EVERYTHING;
+    spectators = nullptr;
+    tick       = 0;
+    setSeed(time(nullptr));
+    
+    // Commands
+    EventManager::getInstance().listen("go",        new (arena) GoListener(this));
+    EventManager::getInstance().listen("map",       new (arena) MapListener(this));
+    EventManager::getInstance().listen("info",      new (arena) InfoListener(this));
+    EventManager::getInstance().listen("restart",   new (arena) RestartListener(this));
+    EventManager::getInstance().listen("teleport",  new (arena) TeleportListener(this));
+    EventManager::getInstance().listen("exit",      new (arena) ExitListener(this));
+    EventManager::getInstance().listen("take",      new (arena) TakeListener(this));
+    TimelineListener *timelineListener = new (arena) TimelineListener(this);
+    EventManager::getInstance().listen("undo",      timelineListener);
+    EventManager::getInstance().listen("redo",      timelineListener);
+    EventManager::getInstance().listen("branch",    timelineListener);
+    EventManager::getInstance().listen("use",       new (arena) UseListener(this));
+    EventManager::getInstance().listen("inventory", new (arena) InventoryListener(this));
+    EventManager::getInstance().listen("attack",    new (arena) AttackListener(this));
+    EventManager::getInstance().listen("memory",    new (arena) MemoryListener());
+
+    // State changes
+    EventManager::getInstance().listen("characterDeath", new (arena) CharacterDeathListener(this));
+    EventManager::getInstance().listen("enterRoom",      new (arena) EnterRoomListener(this));
+    EventManager::getInstance().listen("victory",        new (arena) VictoryListener(this));
+    EventManager::getInstance().listen("defeat",         new (arena) DefeatListener(this));
+
+    rooms.reserve(NUMBER_OF_DEFAULT_ROOMS);
+    buildDefaultRooms(rooms, &arena);
+    vector<KeySet> needs;
+    for (auto &definition : defaultRooms) {
+        needs.push_back(definition.needs);
+    }
+    access.setRequirements(needs);
+
+    string error;
+    if (!loadRules(defaultRules, error)) {
+        cerr << "The built-in rules, " << error << endl;
+    }
+    // Room enough for every item, so picking one up never has to grow the inventory.
+    player.itemInventory.reserve(NUMBER_OF_DEFAULT_ITEMS);
+
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ITEMS; i++) {
+        worldItems[i] = nullptr;
+    }
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ENEMIES; i++) {
+        worldEnemies[i] = nullptr;
+    }
+
+    reset();
+    startTimeline();
+
+    // Every item at once is the longest the inventory list gets.
+    size_t descriptionsLength = 0;
+    for (auto item : worldItems) {
+        descriptionsLength += item->getLongDescription().size() + 2;  // with its tab and newline
+    }
+    player.reserveItemsText(descriptionsLength);
+}
+
+Game::~Game()
+{
+    destroyItemsAndEnemies();
+    for (auto room : rooms) {
+        room->~Room(); // the memory itself belongs to the arena
+    }
+}
+
+void Game::destroyItemsAndEnemies()
+{
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ITEMS; i++) {
+        if (worldItems[i] != nullptr) {
+            worldItems[i]->~Item();
+            worldItems[i] = nullptr;
+        }
+    }
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ENEMIES; i++) {
+        if (worldEnemies[i] != nullptr) {
+            worldEnemies[i]->~Enemy();
+            worldEnemies[i] = nullptr;
+        }
+    }
+}
+
+void Game::reset(bool show_update)
+{
+    gameOver = false;
+    markDirty(EVERYTHING);
+    status.invalidate();  // the welcome text is printed in between, so show the whole block again
+
+    for (unsigned int i = 0; i < rooms.size(); i++) {
+          rooms.at(i)->itemsInRoom.clear();  
+          rooms.at(i)->enemiesInRoom.clear();
+          rooms.at(i)->touch();
+    }
+    player.emptyInventory();
+    access.hold(0);
+
+    // The items and enemies are built from the tables for the first game only; later
+    // games put the same ones back, so a restart doesn't construct (or allocate) anything.
+    entities.clear();
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ITEMS; i++) {
+        const ItemDefinition &definition = defaultItems[i];
+        if (worldItems[i] == nullptr && definition.multiplier > 0) {
+            worldItems[i] = new (arena) Weapon(definition.name, definition.weight, definition.multiplier);
+            sword = worldItems[i];
+        } else if (worldItems[i] == nullptr) {
+            worldItems[i] = new (arena) Item(definition.name, definition.weight);
+        }
+        worldItems[i]->getLongDescription();  // cached now rather than on the first pickup
+        if (definition.flags & EntityStore::KEY) {
+            key = worldItems[i];
+        }
+        worldItems[i]->setEntity(entities.createItem(definition.room, definition.weight, definition.multiplier,
+                                                     definition.flags));
+        rooms[definition.room]->addItem(worldItems[i]);
+    }
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ENEMIES; i++) {
+        const EnemyDefinition &definition = defaultEnemies[i];
+        if (worldEnemies[i] == nullptr) {
+            worldEnemies[i] = new (arena) Enemy(definition.name, definition.description);
+        }
+        worldEnemies[i]->setHealth(100);
+        worldEnemies[i]->setStamina(100);
+        rooms[definition.room]->addEnemy(worldEnemies[i]);
+    }
+    
+    mojo.setCurrentRoom(rooms[MOJO_ROOM]);
+    mojo.setHealth(100);
+    mojo.setStamina(100);
+
+    player.setCurrentRoom(rooms[START_ROOM]);
+    player.setHealth(100);
+    player.setStamina(100);
+    
+    console() << "Welcome to Zork!" << endl;
+    console() << "To pick up items, type take x where x is the name of the item exactly as it is written in the room description, eg. take cursed_item\n";
+    console() << "To attack enemies, type attack x where x is the enemy name exactly as it is\nwritten in the room description" << endl;
+    if (show_update) {
+        update_screen();
+    }
+}
+
+void Game::setOver(bool over)
+{
+    this->gameOver = over;
+    markDirty(EVERYTHING);
+}
+
+void Game::markDirty(unsigned int sections)
+{
+    dirty |= sections;
+}
+
+unsigned int Game::getSeed()
+{
+    return seed;
+}
+
+void Game::setSeed(unsigned int seed)
+{
+    this->seed = seed;
+    rngCounter = 0;
+}
+
+unsigned int Game::nextRandom()
+{
+    // A hash of (seed, counter) rather than a hidden rand() state: the counter is all
+    // that needs saving in a checkpoint.
+    return randomAt(seed, ++rngCounter);
+}
+
+void Game::setRendering(bool rendering)
+{
+    this->rendering = rendering;
+    if (rendering) {
+        // Whatever was shown before rendering stopped is stale now.
+        status.invalidate();
+        markDirty(EVERYTHING);
+    }
+}
+
+Entity Game::entityOf(Item *item)
+{
+    // Callers index components and defaultItems with it, so a wrong one can't be returned.
+    Entity entity = item->getEntity();
+    if (entity >= (Entity) NUMBER_OF_DEFAULT_ITEMS || worldItems[entity] != item) {
+        cerr << "entityOf: " << item->getShortDescription() << " is not one of the world's items" << endl;
+        abort();
+    }
+    return entity;
+}
+
+void Game::syncItemPositions()
+{
+    for (unsigned int i = 0; i < rooms.size(); i++) {
+        for (auto item : rooms[i]->itemsInRoom) {
+            entities.position[entityOf(item)] = i;
+        }
+    }
+    KeySet keys = 0;
+    for (auto item : player.itemInventory) {
+        entities.position[entityOf(item)] = EntityStore::CARRIED;
+        keys |= defaultItems[entityOf(item)].opens;
+    }
+    access.hold(keys);
+}
+
+int Game::getPlayerRoom()
+{
+    return roomIndex(player.getCurrentRoom());
+}
+
+int Game::roomIndex(Room *room)
+{
+    return room == nullptr ? -1 : room->index;
+}
+
+bool Game::runRules(RuleSet::Trigger trigger, Symbol subject)
+{
+    if (!rules.run(trigger, subject, player)) {
+        return false;
+    }
+    markDirty(PLAYER_STATS);
+    return true;
+}
+
+bool Game::loadRules(const string &source, string &error)
+{
+    return rules.compile(source, error);
+}
+
+bool Game::checkInvariants(string &problem)
+{
+    if (player.getHealth() < 0 || player.getStamina() < 0) {
+        problem = "player has HP " + to_string(player.getHealth()) + " ST " + to_string(player.getStamina());
+        return false;
+    }
+    if (mojo.getHealth() < 0 || mojo.getStamina() < 0) {
+        problem = "mojo has HP " + to_string(mojo.getHealth()) + " ST " + to_string(mojo.getStamina());
+        return false;
+    }
+    if (roomIndex(player.getCurrentRoom()) < 0 || roomIndex(mojo.getCurrentRoom()) < 0) {
+        problem = "a character is outside the world";
+        return false;
+    }
+
+    // Every item must be in exactly one room or the inventory.
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ITEMS; i++) {
+        Item *item = worldItems[i];
+        int places = std::count(player.itemInventory.begin(), player.itemInventory.end(), item);
+        for (auto room : rooms) {
+            places += std::count(room->itemsInRoom.begin(), room->itemsInRoom.end(), item);
+        }
+        if (places != 1) {
+            problem = item->getShortDescription() + " is in " + to_string(places) + " places";
+            return false;
+        }
+        bool carried = std::count(player.itemInventory.begin(), player.itemInventory.end(), item) > 0;
+        if (carried != (entities.position[i] == EntityStore::CARRIED)) {
+            problem = item->getShortDescription() + " is carried in one place but not the other";
+            return false;
+        }
+    }
+    // ...and the rooms' lists must agree with the entity positions.
+    for (unsigned int room = 0; room < rooms.size(); room++) {
+        for (auto item : rooms[room]->itemsInRoom) {
+            if (entities.position[entityOf(item)] != (int32_t) room) {
+                problem = item->getShortDescription() + " is in room " + rooms[room]->getName()
+                          + " but its entity says otherwise";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+string Game::saveState()
+{
+    string state = "rng " + to_string(seed) + " " + to_string(rngCounter) + "\n";
+    state += "over " + to_string(gameOver) + "\n";
+    state += "player " + to_string(roomIndex(player.getCurrentRoom())) + " "
+           + to_string(player.getHealth()) + " " + to_string(player.getStamina());
+    for (auto item : player.itemInventory) {
+        state += " " + item->getShortDescription();
+    }
+    state += "\n";
+    state += "mojo " + to_string(roomIndex(mojo.getCurrentRoom())) + " "
+           + to_string(mojo.getHealth()) + " " + to_string(mojo.getStamina()) + "\n";
+
+    for (unsigned int i = 0; i < rooms.size(); i++) {
+        state += "room " + to_string(i);
+        for (auto item : rooms[i]->itemsInRoom) {
+            state += " " + item->getShortDescription();
+        }
+        state += "\n";
+        for (auto enemy : rooms[i]->enemiesInRoom) {
+            state += "enemy " + to_string(i) + " " + enemy->getName() + " "
+                   + to_string(enemy->getHealth()) + " " + to_string(enemy->getStamina()) + "\n";
+        }
+    }
+    return state;
+}
+
+bool Game::loadState(const string &state)
+{
+    // Start from a fresh world so every item and enemy exists, then move them into place.
+    // Item and enemy names are unique in the built-in world, so names identify them. Each
+    // is taken out of its map once placed, so one listed twice is refused like an unknown one.
+    reset(false);
+
+    std::map<string, Item *>  allItems;
+    std::map<string, Enemy *> allEnemies;
+    for (auto room : rooms) {
+        for (auto item : room->itemsInRoom) {
+            allItems[item->getShortDescription()] = item;
+        }
+        for (auto enemy : room->enemiesInRoom) {
+            allEnemies[enemy->getName()] = enemy;
+        }
+        room->itemsInRoom.clear();
+        room->enemiesInRoom.clear();
+        room->touch();
+    }
+
+    istringstream lines(state);
+    string line;
+    while (getline(lines, line)) {
+        istringstream words(line);
+        string kind, name;
+        int index, health, stamina;
+        words >> kind;
+
+        if (kind == "rng") {
+            if (!(words >> seed >> rngCounter)) {
+                return false;
+            }
+        } else if (kind == "over") {
+            if (!(words >> gameOver)) {
+                return false;
+            }
+        } else if (kind == "player" || kind == "mojo") {
+            words >> index >> health >> stamina;
+            if (!words || index < 0 || index >= (int) rooms.size()) {
+                return false;
+            }
+            Character &character = (kind == "player") ? (Character &) player : (Character &) mojo;
+            character.setCurrentRoom(rooms[index]);
+            character.health  = health;
+            character.stamina = stamina;
+            // Only the player line lists items (the inventory).
+            while (kind == "player" && words >> name) {
+                if (allItems.count(name) == 0) {
+                    return false;
+                }
+                player.itemInventory.push_back(allItems[name]);
+                allItems.erase(name);
+            }
+        } else if (kind == "room") {
+            words >> index;
+            if (!words || index < 0 || index >= (int) rooms.size()) {
+                return false;
+            }
+            while (words >> name) {
+                if (allItems.count(name) == 0) {
+                    return false;
+                }
+                rooms[index]->itemsInRoom.push_back(allItems[name]);
+                allItems.erase(name);
+            }
+        } else if (kind == "enemy") {
+            words >> index >> name >> health >> stamina;
+            if (!words || index < 0 || index >= (int) rooms.size() || allEnemies.count(name) == 0) {
+                return false;
+            }
+            Enemy *enemy = allEnemies[name];
+            enemy->health  = health;
+            enemy->stamina = stamina;
+            rooms[index]->enemiesInRoom.push_back(enemy);
+            allEnemies.erase(name);
+        }
+    }
+    syncItemPositions();
+    startTimeline();  // until loadHistory puts back the one saved with the state
+    return true;
+}
+
+string Game::saveHistory()
+{
+    const GameVersion *current = timeline.current();
+    if (current == nullptr) {
+        return "";
+    }
+    string history = "timeline " + to_string(current->number);
+    for (long step : timeline.getRedoSteps()) {
+        history += " " + to_string(step);
+    }
+    history += "\n";
+
+    auto saveRoom = [&](size_t index, const shared_ptr<const RoomState> &room) {
+        history += "version-room " + to_string(index);
+        for (int i = 0; i < room->numberOfItems; i++) {
+            history += " " + room->items[i]->getShortDescription();
+        }
+        history += "\n";
+        for (int i = 0; i < room->numberOfEnemies; i++) {
+            const EnemyState &enemy = room->enemies[i];
+            history += "version-enemy " + enemy.enemy->getName() + " " + to_string(enemy.health) + " "
+                     + to_string(enemy.stamina) + "\n";
+        }
+    };
+    for (long number = timeline.oldest(); number <= timeline.newest(); number++) {
+        const GameVersion *version = timeline.find(number);
+        const GameStatus  &status  = version->status;
+        history += "version " + to_string(number) + " " + to_string(version->parent) + " "
+                 + to_string(status.playerRoom) + " " + to_string(status.playerHealth) + " "
+                 + to_string(status.playerStamina) + " " + to_string(status.mojoRoom) + " "
+                 + to_string(status.mojoHealth) + " " + to_string(status.mojoStamina) + " "
+                 + to_string(status.over) + " " + to_string(status.rngCounter);
+        for (int i = 0; i < version->inventorySize; i++) {
+            history += " " + version->inventory[i]->getShortDescription();
+        }
+        history += "\n";
+
+        // Only the rooms that differ from the parent, or all of them if it's no longer kept.
+        const GameVersion *parent = timeline.find(version->parent);
+        if (parent != nullptr) {
+            version->rooms.forEachDifference(parent->rooms, saveRoom);
+        } else {
+            for (size_t i = 0; i < version->rooms.size(); i++) {
+                saveRoom(i, version->rooms[i]);
+            }
+        }
+    }
+    return history;
+}
+
+bool Game::loadHistory(const string &state)
+{
+    std::map<string, Item *>  allItems;
+    std::map<string, Enemy *> allEnemies;
+    for (auto item : worldItems) {
+        allItems[item->getShortDescription()] = item;
+    }
+    for (auto enemy : worldEnemies) {
+        allEnemies[enemy->getName()] = enemy;
+    }
+    allEnemies[mojo.getName()] = &mojo;
+
+    vector<shared_ptr<GameVersion>> versions;
+    shared_ptr<RoomState> room;  // the one version-enemy lines add to
+    long current = -1;
+    vector<long> redo;
+    bool saved = false;
+
+    istringstream lines(state);
+    string line;
+    while (getline(lines, line)) {
+        istringstream words(line);
+        string kind, name;
+        words >> kind;
+
+        if (kind == "timeline") {
+            saved = true;
+            words >> current;
+            long step;
+            while (words >> step) {
+                redo.push_back(step);
+            }
+        } else if (kind == "version") {
+            auto version = allocate_shared<GameVersion>(PoolAllocator<GameVersion>());
+            GameStatus &status = version->status;
+            words >> version->number >> version->parent >> status.playerRoom >> status.playerHealth
+                  >> status.playerStamina >> status.mojoRoom >> status.mojoHealth >> status.mojoStamina
+                  >> status.over >> status.rngCounter;
+            if (!words || version->parent >= version->number
+                || (!versions.empty() && version->number != versions.back()->number + 1)
+                || status.playerRoom < 0 || status.playerRoom >= (int) rooms.size()
+                || status.mojoRoom < 0 || status.mojoRoom >= (int) rooms.size()) {
+                return false;
+            }
+            version->inventorySize = 0;
+            while (words >> name) {
+                if (allItems.count(name) == 0 || version->inventorySize == NUMBER_OF_DEFAULT_ITEMS) {
+                    return false;
+                }
+                version->inventory[version->inventorySize++] = allItems[name];
+            }
+            // The rooms start as the parent's; the version-room lines after say which differ.
+            if (!versions.empty() && version->parent >= versions.front()->number) {
+                version->rooms = versions[version->parent - versions.front()->number]->rooms;
+            } else {
+                version->rooms = RoomStates(vector<shared_ptr<const RoomState>>(rooms.size()));
+            }
+            versions.push_back(version);
+            room = nullptr;
+        } else if (kind == "version-room") {
+            int index;
+            words >> index;
+            if (versions.empty() || index < 0 || index >= (int) rooms.size()) {
+                return false;
+            }
+            room = allocate_shared<RoomState>(PoolAllocator<RoomState>());
+            room->numberOfItems   = 0;
+            room->numberOfEnemies = 0;
+            while (words >> name) {
+                if (allItems.count(name) == 0 || room->numberOfItems == NUMBER_OF_DEFAULT_ITEMS) {
+                    return false;
+                }
+                room->items[room->numberOfItems++] = allItems[name];
+            }
+            versions.back()->rooms = versions.back()->rooms.set(index, room);
+        } else if (kind == "version-enemy") {
+            int health, stamina;
+            words >> name >> health >> stamina;
+            if (room == nullptr || allEnemies.count(name) == 0 || room->numberOfEnemies == (int) size(room->enemies)) {
+                return false;
+            }
+            room->enemies[room->numberOfEnemies++] = {allEnemies[name], health, stamina};
+        }
+    }
+
+    // Without a saved history (or with history off) the one loadState started stays.
+    if (!saved || timeline.getLimit() == 0) {
+        return true;
+    }
+    for (auto &version : versions) {
+        for (size_t i = 0; i < rooms.size(); i++) {
+            if (version->rooms[i] == nullptr) {
+                return false;
+            }
+        }
+    }
+    return timeline.restore(versions, current, redo);
+}
+
+GameStatus Game::currentStatus()
+{
+    return {roomIndex(player.getCurrentRoom()), player.health, player.stamina,
+            roomIndex(mojo.getCurrentRoom()), mojo.health, mojo.stamina, gameOver, rngCounter};
+}
+
+shared_ptr<const RoomState> Game::captureRoom(int index)
+{
+    Room *room = rooms[index];
+    auto state = allocate_shared<RoomState>(PoolAllocator<RoomState>());
+    assert(room->itemsInRoom.size() <= size(state->items) && room->enemiesInRoom.size() <= size(state->enemies));
+    state->numberOfItems = copy(room->itemsInRoom.begin(), room->itemsInRoom.end(), state->items) - state->items;
+    state->numberOfEnemies = 0;
+    for (auto enemy : room->enemiesInRoom) {
+        state->enemies[state->numberOfEnemies++] = {enemy, enemy->health, enemy->stamina};
+    }
+    recordedRoomVersions[index] = room->version;
+    return state;
+}
+
+void Game::captureInventory(GameVersion &version)
+{
+    version.inventorySize = copy(player.itemInventory.begin(), player.itemInventory.end(), version.inventory)
+                          - version.inventory;
+}
+
+void Game::startTimeline()
+{
+    if (timeline.getLimit() == 0) {
+        timeline.start(nullptr);
+        return;
+    }
+    MemoryScope scope(TAG_HISTORY);
+    historyFull = false;
+    recordedRoomVersions.resize(rooms.size());
+    vector<shared_ptr<const RoomState>> states;
+    for (unsigned int i = 0; i < rooms.size(); i++) {
+        states.push_back(captureRoom(i));
+    }
+    auto first = allocate_shared<GameVersion>(PoolAllocator<GameVersion>());
+    first->rooms  = RoomStates(states);
+    first->status = currentStatus();
+    captureInventory(*first);
+    timeline.start(first);
+}
+
+void Game::recordVersion()
+{
+    const GameVersion *last = timeline.current();
+    if (last == nullptr) {
+        return;
+    }
+
+    // Rooms say when they change (Room::version), so unchanged ones are skipped without
+    // looking inside; most commands change nothing at all and make no version.
+    bool roomsChanged = false;
+    for (unsigned int i = 0; i < rooms.size(); i++) {
+        roomsChanged = roomsChanged || rooms[i]->version != recordedRoomVersions[i];
+    }
+    GameStatus status = currentStatus();
+    bool inventoryChanged = !equal(player.itemInventory.begin(), player.itemInventory.end(),
+                                   last->inventory, last->inventory + last->inventorySize);
+    if (!roomsChanged && !inventoryChanged && status == last->status) {
+        return;
+    }
+
+    MemoryScope scope(TAG_HISTORY);
+    auto version = allocate_shared<GameVersion>(PoolAllocator<GameVersion>(), *last);
+    for (unsigned int i = 0; i < rooms.size(); i++) {
+        if (rooms[i]->version != recordedRoomVersions[i]) {
+            version->rooms = version->rooms.set(i, captureRoom(i));
+        }
+    }
+    if (inventoryChanged) {
+        captureInventory(*version);
+    }
+    version->status = status;
+    timeline.add(version);
+
+    // Once the history is full it stops getting longer, and the versions dropped from its
+    // old end give back the blocks new ones take. What the kept versions hold still varies
+    // with how much each command changed, so the pools get a spare of SPARE_VERSIONS versions that
+    // change every room, instead of growing the next time the history holds a bit more.
+    if (!historyFull && timeline.newest() - timeline.oldest() + 1 == (long) timeline.getLimit()) {
+        historyFull = true;
+        MemoryScope history(TAG_HISTORY);
+        PoolAllocator<GameVersion>::reserveSpare(SPARE_VERSIONS);
+        PoolAllocator<RoomState>::reserveSpare(SPARE_VERSIONS * rooms.size());
+        PoolAllocator<RoomState, RoomStateNodes>::reserveSpare(SPARE_VERSIONS * RoomStates::nodesFor(rooms.size()));
+    }
+}
+
+void Game::restoreVersion(const GameVersion &from, const GameVersion &to)
+{
+    // The world is exactly what from recorded, so only rooms that differ need putting back.
+    to.rooms.forEachDifference(from.rooms, [&](size_t i, const shared_ptr<const RoomState> &state) {
+        Room *room = rooms[i];
+        room->itemsInRoom.assign(state->items, state->items + state->numberOfItems);
+        room->enemiesInRoom.clear();
+        for (int e = 0; e < state->numberOfEnemies; e++) {
+            const EnemyState &enemy = state->enemies[e];
+            enemy.enemy->health  = enemy.health;
+            enemy.enemy->stamina = enemy.stamina;
+            room->enemiesInRoom.push_back(enemy.enemy);
+        }
+        for (auto item : room->itemsInRoom) {
+            entities.position[entityOf(item)] = i;
+        }
+        room->touch();
+        recordedRoomVersions[i] = room->version;
+    });
+
+    player.itemInventory.assign(to.inventory, to.inventory + to.inventorySize);
+    KeySet keys = 0;
+    for (auto item : player.itemInventory) {
+        entities.position[entityOf(item)] = EntityStore::CARRIED;
+        keys |= defaultItems[entityOf(item)].opens;
+    }
+    access.hold(keys);
+
+    player.setCurrentRoom(rooms[to.status.playerRoom]);
+    player.health  = to.status.playerHealth;
+    player.stamina = to.status.playerStamina;
+    mojo.setCurrentRoom(rooms[to.status.mojoRoom]);
+    mojo.health    = to.status.mojoHealth;
+    mojo.stamina   = to.status.mojoStamina;
+    gameOver       = to.status.over;
+    rngCounter     = to.status.rngCounter;
+    markDirty(EVERYTHING);
+    status.invalidate();  // show the whole block again, it may be a while since it was seen
+}
+
+void Game::undo()
+{
+    const GameVersion *from = timeline.current();
+    const GameVersion *to   = from == nullptr ? nullptr : timeline.undo();
+    if (from == nullptr) {
+        console() << "Undo is turned off in this game." << endl;
+    } else if (to == nullptr) {
+        console() << "There's nothing to undo." << endl;
+    } else {
+        restoreVersion(*from, *to);
+        console() << "Undone, back to version " << to->number << "." << endl;
+    }
+}
+
+void Game::redo()
+{
+    const GameVersion *from = timeline.current();
+    const GameVersion *to   = from == nullptr ? nullptr : timeline.redo();
+    if (from == nullptr) {
+        console() << "Undo is turned off in this game." << endl;
+    } else if (to == nullptr) {
+        console() << "There's nothing to redo." << endl;
+    } else {
+        restoreVersion(*from, *to);
+        console() << "Redone, forward to version " << to->number << "." << endl;
+    }
+}
+
+void Game::branch(long version)
+{
+    const GameVersion *from = timeline.current();
+    const GameVersion *to   = from == nullptr ? nullptr : timeline.branch(version);
+    if (from == nullptr) {
+        console() << "Undo is turned off in this game." << endl;
+    } else if (to == nullptr) {
+        console() << "There's no version " << version << "; versions " << timeline.oldest()
+                  << " to " << timeline.newest() << " are kept." << endl;
+    } else {
+        restoreVersion(*from, *to);
+        console() << "Back at version " << version << "; whatever you do next starts a new branch." << endl;
+    }
+}
+
+long Game::currentVersion()
+{
+    const GameVersion *version = timeline.current();
+    return version == nullptr ? -1 : version->number;
+}
+
+void Game::setHistoryLimit(size_t limit)
+{
+    timeline.setLimit(limit);
+    startTimeline();
+}
+
+void Game::map()
+{
+    console() << "Subtitle: [player] !enemy! [player & Enemy!" << endl;
+
+    // Each room's cell is its name between two markers, kept as pieces so drawing it doesn't allocate.
+    const char *opens[NUMBER_OF_DEFAULT_ROOMS], *closes[NUMBER_OF_DEFAULT_ROOMS];
+
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ROOMS; i++)
+    {
+        opens[i] = closes[i] = " ";
+        if (player.getCurrentRoom() == rooms.at(i))
+        {
+            opens[i] = "[";
+            closes[i] = "]";
+        }
+        if (mojo.getCurrentRoom() == rooms.at(i) && enemyCheck()) {
+            opens[i] = closes[i] = "!";
+        }
+        if (rooms.at(i)->getEnemies().size() > 0) {
+            opens[i] = closes[i] = "!";
+        }
+        if(player.getCurrentRoom() == rooms.at(i) && ((mojo.getCurrentRoom() == rooms.at(i) && enemyCheck()) || rooms.at(i)->getEnemies().size() > 0)) {
+            opens[i] = "[";
+            closes[i] = "!";
+        }
+    }
+    auto cell = [&](int i) -> ostream & {
+        return console() << opens[i] << rooms.at(i)->getName() << closes[i];
+    };
+    console() << " "; cell(3) << " -  "; cell(4) << "  - "; cell(5) << endl;
+    console() << "         |   " << endl;
+    console() << " "; cell(1) << " -  "; cell(0) << "  - "; cell(2) << endl;
+    console() << "         |    " << endl;
+    console() << " "; cell(6) << " -  "; cell(7) << "  - "; cell(8) << endl;
+    console() << "         |    " << endl;
+    console() << "        "; cell(9) << endl;
+}
+
+void Game::info()
+{
+    console() << "Available commands:" << endl;
+    console() << " - go <direction>"   << endl;
+    console() << " - teleport"         << endl;
+    console() << " - take <itemName>"  << endl;
+    console() << " - inventory"        << endl;
+    console() << " - map"              << endl;
+    console() << " - info"             << endl;
+    console() << " - attack <enemyName>" << endl;
+    console() << " - use <itemName>" << endl;
+    console() << " - memory"           << endl;
+    console() << " - undo / redo"      << endl;
+    console() << " - branch <version>" << endl;
+    console() << endl;
+    console() << "The more items you have in your inventory, the more stamina you use when you move!" << endl;
+    console() << "If you have a weapon, you will be more likely to hurt the enemy when attacking" << endl;
+}
+
+bool Game::enemyCheck() {
+    if(mojo.getHealth() <= 0 || mojo.getStamina() <= 0) {
+        return false;
+    }
+    return true;
+}
+
+void Game::enemyMove() {
+    if(enemyCheck()) {
+        string direction = "";
+        Room *enemyNext = mojo.getCurrentRoom()->getExit(direction);
+
+        while(enemyNext == nullptr) {
+            int random = nextRandom() % 4;
+            string directions[4] = {"north", "east", "south", "west"};
+            enemyNext = mojo.getCurrentRoom()->getExit(directions[random]);
+        }
+        mojo.setCurrentRoom(enemyNext);
+        mojo.setStamina(mojo.getStamina() - 4);
+        markDirty(ROOM_ENEMIES);
+        if(!enemyCheck()) {
+            console() << "An enemy died due to a lack of stamina!";
+        }
+    }
+}
+
+void Game::go(const string &direction)
+{
+    Room *next = player.getCurrentRoom()->getExit(direction);
+
+    if(next != nullptr && !access.canEnter(next->index)) {
+        console() << "You need a key to enter this room." << endl;
+        console() << "Search for it in another room and then you can enter this one." << endl;
+    } else {
+        if (next != nullptr) {
+            enemyMove();
+            player.setCurrentRoom(next);
+            markDirty(EVERYTHING);
+            player.setStamina(player.getStamina() - moveStaminaCost(player.itemInventory.size(), entities.carriedWeight()));
+            EventManager::getInstance().trigger("enterRoom", next);
+        } else {
+            console() << "You hit a wall" << endl;
+        }
+    }
+}
+
+void Game::teleport()
+{
+    int selected = access.openRoom(nextRandom());
+    player.setCurrentRoom(rooms[selected]);
+    player.setStamina(player.getStamina() - 30);
+    markDirty(EVERYTHING);
+    EventManager::getInstance().trigger("enterRoom", rooms[selected]);
+
+    enemyMove();
+}
+
+void Game::use(const string &itemName) {
+    if(!runRules(RuleSet::USE, SymbolTable::find(itemName))) {
+        console() << "Nothing happens." << endl;
+    }
+}
+
+void Game::take(const string &itemName) {
+    const vector<Item*> &items = player.getCurrentRoom()->getItems();
+    if(items.size() == 0) {
+           console() << "No items in room.";
+    } else {
+            Symbol wanted = SymbolTable::find(itemName);
+            // No i++ after taking one: removing it moves the next item into its place.
+            for(unsigned int i = 0; i < items.size(); ) {
+                if(items.at(i)->getSymbol() != wanted) {
+                    i++;
+                } else {
+                    Item *newItem = (Item *) items.at(i);
+                    Entity entity = entityOf(newItem);
+                    player.addItem(newItem);
+                    player.getCurrentRoom()->removeItem(newItem);
+                    entities.position[entity] = EntityStore::CARRIED;
+                    access.hold(access.held() | defaultItems[entity].opens);
+                    markDirty(ROOM_ITEMS | PLAYER_STATS);
+                    runRules(RuleSet::TAKE, wanted);
+                }
+            }
+    }    
+    console() << player.getItems() << endl;
+}
+
+void Game::attack(const string &name) {
+    const vector<Enemy*> &enemies = player.getCurrentRoom()->getEnemies();
+    Symbol target = SymbolTable::find(name);
+       if(enemies.size() > 0 || (mojo.getCurrentRoom() == player.getCurrentRoom() && enemyCheck())) {
+            markDirty(ROOM_ENEMIES | PLAYER_STATS);
+            // The same rule CombatBatch applies; carriedMultiplier() is 0 without a weapon.
+            if(!attackHits(nextRandom(), entities.carriedMultiplier())) {
+                //4. Unary Operator Overloading (example)
+                --player;
+                if(player.getHealth() <= 0) player.setHealth(0);
+                    console() << "\nYou were injured by the enemy!\n";
+                } else {
+                    if(target == mojo.getSymbol() && mojo.getCurrentRoom() == player.getCurrentRoom() && enemyCheck()) {
+                        mojo.setHealth(mojo.getHealth() - 15);
+                        if(enemyCheck()) {
+                            console() << "\nYou injured the enemy!\n";
+                        } else {
+                            console() << "\nYou killed the enemy!\n"; 
+                        }
+                    } else {
+                        for(unsigned int i = 0; i < enemies.size(); i++) {
+                            if(enemies.at(i)->getSymbol() == target) {
+                                enemies.at(i)->setHealth(enemies.at(i)->getHealth() - 20);
+                                player.getCurrentRoom()->touch();
+                                if(enemies.at(i)->getHealth() <= 0) {
+                                    // enemies is the room's own list, so the next one moves into i.
+                                    player.getCurrentRoom()->removeEnemy(enemies.at(i--));
+                                    console() << "\nYou killed the enemy!\n";
+                                } else {
+                                    console() << "\nYou injured the enemy!\n";
+                                }
+                            }
+                        }
+                    } 
+                }
+                runRules(RuleSet::ATTACK, target);
+        
+        } else {
+            console() << "\nNo enemies to attack\n";
+    }
+}
+
+void Game::inventory()
+{
+    console() << player.getItems() << endl;
+}
+
+bool Game::is_over()
+{
+    return gameOver;
+}
+
+Player &Game::getPlayer()
+{
+    return player;
+}
+
+void Game::update_screen()
+{
+    if (!rendering) {
+        return;
+    }
+    MemoryScope scope(TAG_STRINGS);
+
+    if (gameOver) {
+        console() << "Type \"restart\" or \"exit\"." << endl;
+        return;
+    }
+
+    // Only the parts marked dirty are recomputed; the renderer then drops any
+    // line that comes out the same as what's already shown.
+    Room *currentRoom = player.getCurrentRoom();
+    if (dirty & ROOM_NAME) {
+        statusLine = "You are in ";
+        statusLine += currentRoom->getName();
+        status.setLine(StatusRenderer::ROOM, statusLine);
+    }
+    if (dirty & ROOM_ITEMS) {
+        currentRoom->displayItems(statusLine);
+        status.setLine(StatusRenderer::ITEMS, statusLine);
+    }
+    if (dirty & ROOM_ENEMIES) {
+        enemiesLine(statusLine);
+        status.setLine(StatusRenderer::ENEMIES, statusLine);
+    }
+    if (dirty & ROOM_EXITS) {
+        exitsLine(statusLine);
+        status.setLine(StatusRenderer::EXITS, statusLine);
+    }
+    if (dirty & PLAYER_STATS) {
+        statusLine = "HP: ";
+        appendNumber(statusLine, player.getHealth());
+        statusLine += " ST: ";
+        appendNumber(statusLine, player.getStamina());
+        status.setLine(StatusRenderer::STATS, statusLine);
+    }
+    dirty = 0;
+
+    status.flush(console());
+}
+
+void Game::enemiesLine(string &line)
+{
+    line = "Enemies in room = ";
+    vector<Enemy*> &enemies = player.getCurrentRoom()->enemiesInRoom;
+    bool mojoHere = player.getCurrentRoom() == mojo.getCurrentRoom() && enemyCheck();
+
+    for (unsigned int i = 0; i < enemies.size(); i++) {
+        line += enemies.at(i)->getName();
+        line += " - HP: ";
+        appendNumber(line, enemies.at(i)->getHealth());
+        line += " ST: ";
+        appendNumber(line, enemies.at(i)->getStamina());
+        line += "     ";
+    }
+    if (mojoHere) {
+        line += "Mojo - HP: ";
+        appendNumber(line, mojo.getHealth());
+        line += " ST: ";
+        appendNumber(line, mojo.getStamina());
+    } else if (enemies.size() == 0) {
+        line += "none";
+    }
+}
+
+void Game::setSpectators(SnapshotPublisher *spectators)
+{
+    this->spectators = spectators;
+    publishedRoomVersions.assign(rooms.size(), 0);
+    publishedInventory.clear();
+}
+
+void Game::publishSnapshot()
+{
+    if (spectators == nullptr) {
+        return;
+    }
+
+    // Starts as a copy of the last snapshot, which shares all of it, then replaces what changed.
+    const WorldSnapshot *previous = spectators->latest();
+    WorldSnapshot *snapshot = previous != nullptr ? new WorldSnapshot(*previous) : new WorldSnapshot();
+    snapshot->tick          = ++tick;
+    snapshot->over          = gameOver;
+    snapshot->playerRoom    = roomIndex(player.getCurrentRoom());
+    snapshot->playerHealth  = player.getHealth();
+    snapshot->playerStamina = player.getStamina();
+    snapshot->mojoRoom      = enemyCheck() ? roomIndex(mojo.getCurrentRoom()) : -1;
+    snapshot->mojoHealth    = mojo.getHealth();
+    snapshot->mojoStamina   = mojo.getStamina();
+
+    if (previous == nullptr || player.itemInventory != publishedInventory) {
+        auto inventory = make_shared<vector<string>>();
+        for (auto item : player.itemInventory) {
+            inventory->push_back(item->getShortDescription());
+        }
+        snapshot->inventory = inventory;
+        publishedInventory  = player.itemInventory;
+    }
+
+    auto roomSnapshot = [](Room *room) {
+        auto copy = make_shared<RoomSnapshot>();
+        copy->name    = room->getName();
+        copy->version = room->version;
+        for (auto item : room->itemsInRoom) {
+            copy->items.push_back(item->getShortDescription());
+        }
+        for (auto enemy : room->enemiesInRoom) {
+            copy->enemies.push_back({enemy->getName(), enemy->getHealth(), enemy->getStamina()});
+        }
+        return shared_ptr<const RoomSnapshot>(copy);
+    };
+    if (previous == nullptr) {
+        vector<shared_ptr<const RoomSnapshot>> all;
+        for (auto room : rooms) {
+            all.push_back(roomSnapshot(room));
+        }
+        snapshot->rooms = PersistentArray<shared_ptr<const RoomSnapshot>>(all);
+    } else {
+        // Finding the changed rooms is one integer compare per room; only those are copied.
+        for (unsigned int i = 0; i < rooms.size(); i++) {
+            if (rooms[i]->version != publishedRoomVersions[i]) {
+                snapshot->rooms = snapshot->rooms.set(i, roomSnapshot(rooms[i]));
+            }
+        }
+    }
+    for (unsigned int i = 0; i < rooms.size(); i++) {
+        publishedRoomVersions[i] = rooms[i]->version;
+    }
+    spectators->publish(snapshot);
+}
+
+void Game::writeState(JsonWriter &json)
+{
+    Room *currentRoom = player.getCurrentRoom();
+
+    if (dirty & ROOM_NAME) {
+        json.key("room").value(currentRoom->getName());
+    }
+    if (dirty & ROOM_ITEMS) {
+        json.key("items").beginArray();
+        for (auto item : currentRoom->itemsInRoom) {
+            json.value(item->getShortDescription());
+        }
+        json.endArray();
+    }
+    if (dirty & ROOM_ENEMIES) {
+        json.key("enemies").beginArray();
+        for (auto enemy : currentRoom->enemiesInRoom) {
+            json.beginObject().key("name").value(enemy->getName()).key("hp").value(enemy->getHealth())
+                .key("st").value(enemy->getStamina()).endObject();
+        }
+        if (currentRoom == mojo.getCurrentRoom() && enemyCheck()) {
+            json.beginObject().key("name").value("mojo").key("hp").value(mojo.getHealth())
+                .key("st").value(mojo.getStamina()).endObject();
+        }
+        json.endArray();
+    }
+    if (dirty & ROOM_EXITS) {
+        const char *directions[4] = {"north", "east", "south", "west"};
+        json.key("exits").beginArray();
+        for (int i = 0; i < 4; i++) {
+            if (currentRoom->exits[i] != nullptr) {
+                json.value(directions[i]);
+            }
+        }
+        json.endArray();
+    }
+    if (dirty & PLAYER_STATS) {
+        json.key("hp").value(player.getHealth()).key("st").value(player.getStamina());
+        json.key("inventory").beginArray();
+        for (auto item : player.itemInventory) {
+            json.value(item->getShortDescription());
+        }
+        json.endArray();
+        json.key("over").value(gameOver);
+    }
+    dirty = 0;
+}
+
+void Game::exitsLine(string &line)
+{
+    Room *currentRoom = player.getCurrentRoom();
+    line = "Exits:";
+    if (currentRoom->exits[0] != nullptr) { line += " north"; }
+    if (currentRoom->exits[1] != nullptr) { line += " east";  }
+    if (currentRoom->exits[2] != nullptr) { line += " south"; }
+    if (currentRoom->exits[3] != nullptr) { line += " west";  }
+}
+
+
+//golistener.cpp
+GoListener::GoListener(Game *game)
+{
+    this->game = game;
+    direction  = "";
+}
+
+void GoListener::run(void *args_ptr)
+{
+    if (game->is_over()) {
+        return;
+    }
+
+    vector<string> *args = (vector<string> *) args_ptr;
+
+    if (args->size() > 1) {
+        game->go(args->at(1));
+    } else {
+        console() << "Need a direction!" << endl;
+    }
+}
+
+//infolistener.cpp
+InfoListener::InfoListener(Game *game)
+{
+    this->game = game;
+}
+
+void InfoListener::run(void *)
+{
+    game->info();
+}
+
+//inputlistener.cpp
+
+InputListener::InputListener(Game *game)
+{
+    this->game     = game;
+    this->profiler = nullptr;
+}
+
+void InputListener::setProfiler(CommandProfiler *profiler)
+{
+    this->profiler = profiler;
+}
+
+void InputListener::run(void *args_ptr)
+{
+    // Let's make this thing a bit safer by "translating" the pointer back to what we expect
+    // This is exactly what makes this "void *" pointer dangerous.
+    vector<string> *args = (vector<string> *) args_ptr;
+
+    EventManager &eventManager = EventManager::getInstance();
+
+    if (args->size() > 0) {
+        // If arg[0] is "input", we are going to ignore the input.
+        // If we do not ignore the input, it's an infinite loop.
+        if (args->at(0) == "input") {
+            return;
+        }
+
+        if (profiler != nullptr) {
+            profiler->begin();
+        }
+        eventManager.trigger(args->at(0), args);
+        game->recordVersion();
+
+        if (profiler != nullptr) {
+            profiler->end(eventManager.has_listeners(args->at(0)) ? args->at(0) : "(unknown)");
+            profiler->begin();
+        }
+        if (eventManager.is_running()) {
+            game->update_screen();
+        }
+        if (profiler != nullptr) {
+            profiler->end("update_screen");
+        }
+        game->publishSnapshot();
+    } else {
+        eventManager.trigger("no_command", nullptr);
+    }
+}
+
+//inventorylistener.cpp
+InventoryListener::InventoryListener(Game *game)
+{
+    this->game = game;
+}
+
+void InventoryListener::run(void *args_ptr)
+{
+    game->inventory();
+}
+
+//item.cpp
+//9. Initializer list
+Item::Item (string inDescription, float inWeightGrams, int multiplier) : description(inDescription), symbol(SymbolTable::intern(inDescription)), multiplier(multiplier), longDescriptionValid(false), entity(EntityStore::NO_ENTITY) {
+	setWeight(inWeightGrams);
+}
+
+//3. Templates
+template <typename T>
+void Item::setWeight(const T& inWeightGrams)
+{
+    if (inWeightGrams > 9999 || inWeightGrams < 0)
+       console() << "weight invalid, must be 0<weight<9999" ;
+    else {
+	   weightGrams = inWeightGrams;
+	   longDescriptionValid = false;
+    }
+}
+template void Item::setWeight<int>(const int&);
+template void Item::setWeight<float>(const float&);
+
+float Item::getWeight() {
+    return weightGrams;
+}
+
+int Item::getMultiplier() {
+    return multiplier;
+}
+
+const string &Item::getShortDescription()
+{
+	return description;
+}
+
+Symbol Item::getSymbol()
+{
+	return symbol;
+}
+
+Entity Item::getEntity()
+{
+	return entity;
+}
+
+void Item::setEntity(Entity entity)
+{
+	this->entity = entity;
+}
+
+const string &Item::getLongDescription()
+{
+    if (!longDescriptionValid) {
+        MemoryScope scope(TAG_STRINGS);
+        longDescription.clear();
+        //7. Virtual Functions and Polymorphism (example of runtime polymorphism occurring)
+        //10. Dynamic and static dispatch
+        //(Item has virtual func formatLongDescription, weapon inherits from Item and overrides this method)
+        formatLongDescription(longDescription);
+        longDescriptionValid = true;
+    }
+    return longDescription;
+}
+
+string_view Item::formatWeight(char (&buffer)[32])
+{
+    // Same digits as to_string (6 decimals), minus the trailing zeros and dot.
+    char *end = to_chars(buffer, buffer + sizeof(buffer), weightGrams, chars_format::fixed, 6).ptr;
+    while (end > buffer && end[-1] == '0') {
+        end--;
+    }
+    if (end > buffer && end[-1] == '.') {
+        end--;
+    }
+    return string_view(buffer, end - buffer);
+}
+
+void Item::formatLongDescription(string &out)
+{
+    char weight[32];
+    out += description;
+    out += ", weight: ";
+    out += formatWeight(weight);
+    out += "g.\n";
+}
+
+//5. Binary Operator Overloading
+bool operator==(const Item &item1, const Item &item2) {
+    return item1.symbol == item2.symbol;
+}
+
+//journal.cpp
+Journal::Journal(Game *game, string path, int batchSize, int checkpointInterval) :
+    game(game), path(path), batchSize(batchSize), checkpointInterval(checkpointInterval)
+{
+    fd              = -1;
+    pendingCount    = 0;
+    sinceCheckpoint = 0;
+    sequence        = 0;
+}
+
+Journal::~Journal()
+{
+    if (fd >= 0) {
+        commit();
+        close(fd);
+    }
+}
+
+long Journal::getSequence()
+{
+    return sequence;
+}
+
+bool Journal::open()
+{
+    // Replaying an older journal with today's rules would quietly end up somewhere else.
+    int format = formatOnDisk();
+    if (format != 0 && format != FORMAT) {
+        cerr << path << " was written in journal format " << format << ", this build replays format "
+             << FORMAT << ". Move it and " << path << ".ckpt aside to start a new one." << endl;
+        return false;
+    }
+
+    long replayed = replay();
+    if (replayed < 0) {
+        return false;
+    }
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (lseek(fd, 0, SEEK_END) == 0) {
+        writeHeader();
+    }
+
+    // The first screen is drawn here, so it's the recovered game's and not a new one's.
+    if (replayed > 0) {
+        console() << "Recovered " << replayed << " commands from " << path << endl;
+    }
+    game->update_screen();
+    return true;
+}
+
+long Journal::replay()
+{
+    EventManager &eventManager = EventManager::getInstance();
+    ostream &visible = eventManager.output();
+
+    // Replay as fast as possible: nothing is printed or drawn until it's done.
+    eventManager.mute();
+    game->setRendering(false);
+
+    ifstream checkpointFile(path + ".ckpt");
+    if (checkpointFile) {
+        string first;
+        checkpointFile >> first >> sequence;
+        stringstream state;
+        state << checkpointFile.rdbuf();
+        // Loading clears the world before it finds a mistake, so there's nothing to carry on
+        // with. A truncated checkpoint loads, but loses items, which the invariants catch.
+        string problem;
+        if (!game->loadState(state.str()) || !game->loadHistory(state.str()) || !game->checkInvariants(problem)) {
+            eventManager.setOutput(&visible);
+            cerr << "Corrupt checkpoint in " << path << ".ckpt" << endl;
+            return -1;
+        }
+    }
+
+    long replayed = 0;
+    long goodBytes = 0;
+    ifstream journalFile(path);
+    string line;
+    while (getline(journalFile, line)) {
+        if (journalFile.eof()) {
+            break; // last line was torn by the crash, it was never committed
+        }
+        goodBytes += line.size() + 1;
+
+        istringstream words(line);
+        string first;
+        words >> first;
+        if (first == "seed") {
+            unsigned int seed;
+            words >> seed;
+            if (!checkpointFile) {
+                game->setSeed(seed);
+                game->reset(false);
+                game->startTimeline();  // numbered the way the recorded game numbered its versions
+            }
+            continue;
+        }
+
+        long number = atol(first.c_str());
+        if (number <= sequence) {
+            continue; // already part of the checkpoint
+        }
+
+        vector<string> command;
+        string word;
+        while (words >> word) {
+            command.push_back(word);
+        }
+        eventManager.trigger("input", &command);
+        sequence = number;
+        replayed++;
+    }
+
+    eventManager.setOutput(&visible);
+    game->setRendering(true);
+
+    // Drop a torn tail so the next append starts on a clean line. A clean journal ends
+    // with a newline, so everything in it was good and it's left alone.
+    struct stat file;
+    if (stat(path.c_str(), &file) == 0 && goodBytes < file.st_size && truncate(path.c_str(), goodBytes) != 0) {
+        cerr << "Could not cut the torn last line off " << path << ": " << strerror(errno) << endl;
+        return -1;
+    }
+    return replayed;
+}
+
+// The format named on the journal's seed line, or 0 if there's no journal yet.
+int Journal::formatOnDisk()
+{
+    ifstream journalFile(path);
+    string line, first, seed, version;
+    getline(journalFile, line);
+    istringstream words(line);
+    if (!(words >> first >> seed) || first != "seed") {
+        return 0;
+    }
+    return words >> version && version[0] == 'v' ? atoi(version.c_str() + 1) : 1;
+}
+
+void Journal::writeHeader()
+{
+    string header = "seed " + to_string(game->getSeed()) + " v" + to_string(FORMAT) + "\n";
+    if (write(fd, header.data(), header.size()) < 0) {
+        cerr << "Journal write failed" << endl;
+    }
+    fdatasync(fd);
+}
+
+void Journal::record(const vector<string> &words)
+{
+    pending += to_string(++sequence);
+    for (auto &word : words) {
+        pending += " " + word;
+    }
+    pending += "\n";
+    pendingCount++;
+
+    // Commit when the batch is full, or right away if we're about to wait for the player anyway.
+    if (pendingCount >= batchSize || cin.rdbuf()->in_avail() <= 0) {
+        commit();
+    }
+
+    if (++sinceCheckpoint >= checkpointInterval) {
+        checkpoint();
+    }
+}
+
+void Journal::commit()
+{
+    if (pendingCount == 0 || fd < 0) {
+        return;
+    }
+    if (write(fd, pending.data(), pending.size()) < 0) {
+        cerr << "Journal write failed" << endl;
+    }
+    fdatasync(fd);
+    pending.clear();
+    pendingCount = 0;
+}
+
+void Journal::checkpoint()
+{
+    commit();
+
+    // Write the new checkpoint beside the old one and rename it over, so a crash
+    // at any point leaves either the old or the new checkpoint, never half of one.
+    string temporary = path + ".ckpt.tmp";
+    string state = "seq " + to_string(sequence) + "\n" + game->saveState() + game->saveHistory();
+    int checkpointFd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (checkpointFd < 0) {
+        return;
+    }
+    bool written = write(checkpointFd, state.data(), state.size()) == (ssize_t) state.size();
+    fsync(checkpointFd);
+    close(checkpointFd);
+    if (!written || rename(temporary.c_str(), (path + ".ckpt").c_str()) != 0) {
+        return;
+    }
+
+    // Commands up to "sequence" are now in the checkpoint, so the journal can start over.
+    // If we crash before this, replay skips them by their sequence numbers.
+    if (ftruncate(fd, 0) == 0) {
+        writeHeader();
+    }
+    sinceCheckpoint = 0;
+}
+
+//journallistener.cpp
+JournalListener::JournalListener(Journal *journal)
+{
+    this->journal = journal;
+}
+
+void JournalListener::run(void *args_ptr)
+{
+    vector<string> *args = (vector<string> *) args_ptr;
+
+    // Only commands the game understood change its state. "exit" ends the session
+    // rather than changing the game, so a recovered session carries on instead of quitting.
+    if (args->size() == 0 || args->at(0) == "exit" || args->at(0) == "input" ||
+        !EventManager::getInstance().has_listeners(args->at(0))) {
+        return;
+    }
+    journal->record(*args);
+}
+
+//jsonwriter.cpp
+JsonWriter::JsonWriter(string &out) : out(out)
+{
+    depth    = 0;
+    empty[0] = true;
+    afterKey = false;
+}
+
+void JsonWriter::separate()
+{
+    if (afterKey) {
+        afterKey = false;
+    } else if (!empty[depth]) {
+        out += ',';
+    }
+    empty[depth] = false;
+}
+
+void JsonWriter::begin(char bracket)
+{
+    separate();
+    out += bracket;
+    if (depth + 1 < MAX_DEPTH) {
+        depth++;
+    }
+    empty[depth] = true;
+}
+
+void JsonWriter::end(char bracket)
+{
+    out += bracket;
+    if (depth > 0) {
+        depth--;
+    }
+}
+
+JsonWriter &JsonWriter::beginObject() { begin('{'); return *this; }
+JsonWriter &JsonWriter::endObject()   { end('}');   return *this; }
+JsonWriter &JsonWriter::beginArray()  { begin('['); return *this; }
+JsonWriter &JsonWriter::endArray()    { end(']');   return *this; }
+
+JsonWriter &JsonWriter::key(string_view name)
+{
+    value(name);
+    out += ':';
+    afterKey = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(string_view text)
+{
+    separate();
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n";  break;
+        case '\t': out += "\\t";  break;
+        case '\r': out += "\\r";  break;
+        default:
+            if ((unsigned char) c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const char *text)
+{
+    return value(string_view(text));
+}
+
+JsonWriter &JsonWriter::value(long number)
+{
+    separate();
+    char digits[24];
+    auto result = to_chars(digits, digits + sizeof(digits), number);
+    out.append(digits, result.ptr);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(int number)
+{
+    return value((long) number);
+}
+
+JsonWriter &JsonWriter::value(bool flag)
+{
+    separate();
+    out += flag ? "true" : "false";
+    return *this;
+}
+
+JsonWriter &JsonWriter::raw(string_view json)
+{
+    separate();
+    out += json;
+    return *this;
+}
+
+//maplistener.cpp
+
+MapListener::MapListener(Game *game)
+{
+    this->game = game;
+}
+
+void MapListener::run(void *)
+{
+    game->map();
+}
+
+//memorylistener.cpp
+
+void MemoryListener::run(void *)
+{
+    MemoryTracker::report(console());
+}
+
+//restartlistener.cpp
+RestartListener::RestartListener(Game *game)
+{
+    this->game = game;
+}
+
+void RestartListener::run(void *)
+{
+    game->reset(false);
+}
+
+//replayanalytics.cpp
+const char *ReplayStatistics::eventNames[NUMBER_OF_EVENTS] = {"commands", "enterRoom", "curse", "victory", "defeat", "restart"};
+
+void ReplayStatistics::add(const ReplayStatistics &other)
+{
+    sessions      += other.sessions;
+    games         += other.games;
+    cursedDefeats += other.cursedDefeats;
+    for (int i = 0; i < NUMBER_OF_EVENTS; i++) {
+        events[i] += other.events[i];
+    }
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ROOMS; i++) {
+        roomVisits[i] += other.roomVisits[i];
+        roomDeaths[i] += other.roomDeaths[i];
+    }
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ITEMS; i++) {
+        itemTaken[i]    += other.itemTaken[i];
+        itemInDefeat[i] += other.itemInDefeat[i];
+    }
+    for (int i = 0; i <= MAX_TURNS; i++) {
+        turnsToVictory[i] += other.turnsToVictory[i];
+    }
+}
+
+long ReplayStatistics::medianTurnsToVictory() const
+{
+    long seen = 0;
+    for (int turns = 0; turns <= MAX_TURNS; turns++) {
+        seen += turnsToVictory[turns];
+        if (seen * 2 >= events[VICTORY] && seen > 0) {
+            return turns;
+        }
+    }
+    return 0;
+}
+
+namespace {
+
+// What the listeners need to know about the game being replayed.
+struct ReplayTracker
+{
+    ReplayStatistics *statistics;
+    Game             *game;
+    int               turns;
+    bool              cursed;
+    unsigned int      taken;  // bit i: defaultItems[i] has been picked up this game
+
+    // A session starts a game, and so does every restart in it.
+    void newGame(int turnsSoFar)
+    {
+        turns  = turnsSoFar;
+        cursed = false;
+        taken  = 0;
+        statistics->games++;
+    }
+
+    int itemIndex(const string &name)
+    {
+        for (int i = 0; i < NUMBER_OF_DEFAULT_ITEMS; i++) {
+            if (name == defaultItems[i].name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+};
+
+// Counts one kind of event. Registered after the game's own listeners, so it runs once
+// the game has dealt with the event.
+class AnalyticsListener : public EventListener
+{
+public:
+    AnalyticsListener(ReplayTracker *tracker, ReplayStatistics::Event event) :
+        tracker(tracker), event(event)
+    {
+    }
+
+    void run(void *args) override
+    {
+        ReplayStatistics &statistics = *tracker->statistics;
+        statistics.events[event]++;
+        int room = tracker->game->getPlayerRoom();
+
+        switch (event) {
+        case ReplayStatistics::COMMANDS: {
+            tracker->turns++;
+            vector<string> &words = *(vector<string> *) args;
+            if (words.size() > 1 && words[0] == "take") {
+                int item = tracker->itemIndex(words[1]);
+                Player &player = tracker->game->getPlayer();
+                if (item >= 0 && !(tracker->taken & (1u << item)) && player.hasItem(SymbolTable::find(words[1]))) {
+                    tracker->taken |= 1u << item;
+                    statistics.itemTaken[item]++;
+                }
+            }
+            break;
+        }
+        case ReplayStatistics::ENTER_ROOM:
+            if (room >= 0) {
+                statistics.roomVisits[room]++;
+            }
+            break;
+        case ReplayStatistics::CURSE:
+            tracker->cursed = true;
+            break;
+        case ReplayStatistics::VICTORY:
+            // The winning command itself is counted after this runs.
+            statistics.turnsToVictory[min(tracker->turns + 1, (int) ReplayStatistics::MAX_TURNS)]++;
+            break;
+        case ReplayStatistics::DEFEAT:
+            if (room >= 0) {
+                statistics.roomDeaths[room]++;
+            }
+            statistics.cursedDefeats += tracker->cursed;
+            for (auto item : tracker->game->getPlayer().itemInventory) {
+                int index = tracker->itemIndex(item->getShortDescription());
+                if (index >= 0) {
+                    statistics.itemInDefeat[index]++;
+                }
+            }
+            break;
+        case ReplayStatistics::RESTART:
+            // The restart command itself is counted after this runs, and isn't a turn of the new game.
+            tracker->newGame(-1);
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    ReplayTracker          *tracker;
+    ReplayStatistics::Event event;
+};
+
+// One session's lines inside a loaded file.
+struct ReplaySession
+{
+    const string *file;
+    size_t        begin;
+    size_t        end;
+    uint32_t      seed;
+};
+
+// Splits a file into sessions at its "seed" lines. Lines before the first one form a
+// session with seed 1.
+void findSessions(const string &file, vector<ReplaySession> &sessions)
+{
+    size_t at = 0;
+    while (at < file.size()) {
+        size_t end = file.find('\n', at);
+        if (end == string::npos) {
+            end = file.size();
+        }
+        if (file.compare(at, 5, "seed ") == 0) {
+            if (!sessions.empty() && sessions.back().file == &file) {
+                sessions.back().end = at;
+            }
+            sessions.push_back({&file, end + 1, file.size(), (uint32_t) strtoul(file.c_str() + at + 5, nullptr, 10)});
+        } else if (at == 0) {
+            sessions.push_back({&file, 0, file.size(), 1});
+        }
+        at = end + 1;
+    }
+}
+
+// Puts each non-empty command of a session in line and calls run.
+template <typename Run>
+void forEachCommand(const ReplaySession &replay, string &line, Run run)
+{
+    size_t at = replay.begin;
+    while (at < replay.end) {
+        size_t end = min(replay.file->find('\n', at), replay.end);
+        // Journal lines start with a sequence number; scripts don't.
+        size_t start = at;
+        while (start < end && isdigit((unsigned char) (*replay.file)[start])) {
+            start++;
+        }
+        if (start > at && start < end && (*replay.file)[start] == ' ') {
+            start++;
+        } else {
+            start = at;
+        }
+        line.assign(*replay.file, start, end - start);
+        at = end + 1;
+        if (!line.empty()) {
+            run();
+        }
+    }
+}
+
+void replaySessions(const vector<ReplaySession> &sessions, atomic<size_t> &next, ReplayStatistics &statistics)
+{
+    // Sessions are handed out a few at a time, so a worker that drew short ones takes more.
+    const size_t CHUNK = 16;
+
+    Session session;
+    Game &game = session.getGame();
+    game.setRendering(false);
+
+    ReplayTracker tracker = {&statistics, &game, 0, false, 0};
+    AnalyticsListener commands(&tracker, ReplayStatistics::COMMANDS);
+    AnalyticsListener enterRoom(&tracker, ReplayStatistics::ENTER_ROOM);
+    AnalyticsListener curse(&tracker, ReplayStatistics::CURSE);
+    AnalyticsListener victory(&tracker, ReplayStatistics::VICTORY);
+    AnalyticsListener defeat(&tracker, ReplayStatistics::DEFEAT);
+    AnalyticsListener restart(&tracker, ReplayStatistics::RESTART);
+    EventManager &events = session.getEvents();
+    events.listen("input",     &commands);
+    events.listen("enterRoom", &enterRoom);
+    events.listen("curse",     &curse);
+    events.listen("victory",   &victory);
+    events.listen("defeat",    &defeat);
+    events.listen("restart",   &restart);
+
+    string line;
+    while (true) {
+        size_t first = next.fetch_add(CHUNK);
+        if (first >= sessions.size()) {
+            break;
+        }
+        for (size_t i = first; i < min(first + CHUNK, sessions.size()); i++) {
+            const ReplaySession &replay = sessions[i];
+            {
+                SessionScope scope(events);
+                game.setSeed(replay.seed);
+                game.reset(false);
+            }
+            tracker.newGame(0);
+            statistics.sessions++;
+
+            forEachCommand(replay, line, [&] { session.execute(line); });
+        }
+    }
+}
+
+// A tiny columnar format: tables of named columns, each column's values stored together.
+//   "ZCOL1\n", then per table: name, row count, column count, and per column: name,
+//   type (0 = int64, 1 = string) and the values (strings as row+1 offsets, then the bytes).
+// Numbers are little-endian; names are a u32 length followed by the bytes.
+class ColumnFile
+{
+public:
+    ColumnFile(const string &path) : out(path, ios::binary)
+    {
+        out.write("ZCOL1\n", 6);
+    }
+
+    bool good()
+    {
+        return out.good();
+    }
+
+    void table(const string &name, uint64_t rows, uint32_t columns)
+    {
+        writeName(name);
+        writeValue(rows);
+        writeValue(columns);
+    }
+
+    void column(const string &name, const vector<int64_t> &values)
+    {
+        writeName(name);
+        writeValue((uint8_t) 0);
+        out.write((const char *) values.data(), values.size() * sizeof(int64_t));
+    }
+
+    void column(const string &name, const vector<string> &values)
+    {
+        writeName(name);
+        writeValue((uint8_t) 1);
+        uint32_t offset = 0;
+        writeValue(offset);
+        for (auto &value : values) {
+            offset += value.size();
+            writeValue(offset);
+        }
+        for (auto &value : values) {
+            out.write(value.data(), value.size());
+        }
+    }
+
+private:
+    ofstream out;
+
+    template <typename T>
+    void writeValue(T value)
+    {
+        out.write((const char *) &value, sizeof(value));
+    }
+
+    void writeName(const string &name)
+    {
+        writeValue((uint32_t) name.size());
+        out.write(name.data(), name.size());
+    }
+};
+
+bool writeResults(const ReplayStatistics &statistics, const string &prefix)
+{
+    vector<string>  roomNames, itemNames, eventNames;
+    vector<int64_t> visits, deaths, taken, lost, counts;
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ROOMS; i++) {
+        roomNames.push_back(defaultRooms[i].name);
+        visits.push_back(statistics.roomVisits[i]);
+        deaths.push_back(statistics.roomDeaths[i]);
+    }
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ITEMS; i++) {
+        itemNames.push_back(defaultItems[i].name);
+        taken.push_back(statistics.itemTaken[i]);
+        lost.push_back(statistics.itemInDefeat[i]);
+    }
+    for (int i = 0; i < ReplayStatistics::NUMBER_OF_EVENTS; i++) {
+        eventNames.push_back(ReplayStatistics::eventNames[i]);
+        counts.push_back(statistics.events[i]);
+    }
+
+    ofstream rooms(prefix + ".rooms.csv"), items(prefix + ".items.csv"), events(prefix + ".events.csv"),
+             summary(prefix + ".summary.csv");
+    rooms << "room,visits,deaths\n";
+    for (size_t i = 0; i < roomNames.size(); i++) {
+        rooms << roomNames[i] << ',' << visits[i] << ',' << deaths[i] << '\n';
+    }
+    items << "item,games_taken,defeats_carrying\n";
+    for (size_t i = 0; i < itemNames.size(); i++) {
+        items << itemNames[i] << ',' << taken[i] << ',' << lost[i] << '\n';
+    }
+    events << "event,count\n";
+    for (size_t i = 0; i < eventNames.size(); i++) {
+        events << eventNames[i] << ',' << counts[i] << '\n';
+    }
+    summary << "sessions,games,victories,defeats,cursed_defeats,median_turns_to_victory\n";
+    summary << statistics.sessions << ',' << statistics.games << ',' << statistics.events[ReplayStatistics::VICTORY] << ','
+            << statistics.events[ReplayStatistics::DEFEAT] << ',' << statistics.cursedDefeats << ','
+            << statistics.medianTurnsToVictory() << '\n';
+
+    ColumnFile columns(prefix + ".cols");
+    columns.table("rooms", roomNames.size(), 3);
+    columns.column("room", roomNames);
+    columns.column("visits", visits);
+    columns.column("deaths", deaths);
+    columns.table("items", itemNames.size(), 3);
+    columns.column("item", itemNames);
+    columns.column("games_taken", taken);
+    columns.column("defeats_carrying", lost);
+    columns.table("events", eventNames.size(), 2);
+    columns.column("event", eventNames);
+    columns.column("count", counts);
+
+    return rooms.good() && items.good() && events.good() && summary.good() && columns.good();
+}
+
+} // namespace
+
+bool runAnalytics(const vector<string> &paths, const string &outputPrefix, int threads)
+{
+    if (threads <= 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<string> files(paths.size());
+    vector<ReplaySession> sessions;
+    for (size_t i = 0; i < paths.size(); i++) {
+        ifstream in(paths[i], ios::binary);
+        if (!in) {
+            cerr << "Could not read " << paths[i] << endl;
+            return false;
+        }
+        stringstream contents;
+        contents << in.rdbuf();
+        files[i] = contents.str();
+        findSessions(files[i], sessions);
+    }
+    double loaded = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    vector<ReplayStatistics> partial(threads);
+    vector<thread> workers;
+    atomic<size_t> next(0);
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(replaySessions, cref(sessions), ref(next), ref(partial[i]));
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    ReplayStatistics total;
+    for (auto &statistics : partial) {
+        total.add(statistics);
+    }
+    double replayed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int deadliest = max_element(total.roomDeaths, total.roomDeaths + NUMBER_OF_DEFAULT_ROOMS) - total.roomDeaths;
+    long defeats  = total.events[ReplayStatistics::DEFEAT];
+    long commands = total.events[ReplayStatistics::COMMANDS];
+
+    cout << "Loaded " << sessions.size() << " sessions from " << paths.size() << " file(s) in " << loaded << "s" << endl;
+    cout << "Replayed " << commands << " commands on " << threads << " thread(s) in " << replayed << "s ("
+         << (long) (total.sessions / max(replayed, 1e-9)) << " sessions/s, "
+         << (long) (commands / max(replayed, 1e-9)) << " commands/s)" << endl;
+    cout << "Sessions: " << total.sessions << ", games (a restart starts another): " << total.games << endl;
+    cout << "Victories: " << total.events[ReplayStatistics::VICTORY] << ", defeats: " << defeats
+         << ", median turns to victory: " << total.medianTurnsToVictory() << endl;
+    if (defeats > 0) {
+        cout << "Most deaths in room " << defaultRooms[deadliest].name << " (" << total.roomDeaths[deadliest] << "); "
+             << 100.0 * total.cursedDefeats / defeats << "% of defeats came after the curse" << endl;
+    }
+
+    if (!writeResults(total, outputPrefix)) {
+        cerr << "Could not write the results to " << outputPrefix << ".*" << endl;
+        return false;
+    }
+    cout << "Wrote " << outputPrefix << ".{rooms,items,events,summary}.csv and " << outputPrefix << ".cols" << endl;
+    return true;
+}
+
+bool runBenchmark(const string &path, int rounds)
+{
+    ifstream in(path, ios::binary);
+    if (!in) {
+        cerr << "Could not read " << path << endl;
+        return false;
+    }
+    stringstream contents;
+    contents << in.rdbuf();
+    string file = contents.str();
+    vector<ReplaySession> sessions;
+    findSessions(file, sessions);
+
+    // The output goes to a buffer that's emptied after every command, so it's the game
+    // being measured, not the terminal.
+    StringSink sink;
+    ostream output(&sink);
+    Session session(&output);
+    Game &game = session.getGame();
+
+    string line;
+    long commands = 0;
+    double best = 0;
+    for (int round = 0; round < max(1, rounds); round++) {
+        commands = 0;
+        auto start = chrono::steady_clock::now();
+        for (auto &replay : sessions) {
+            {
+                SessionScope scope(session.getEvents());
+                game.setSeed(replay.seed);
+                game.reset(false);
+            }
+            forEachCommand(replay, line, [&] {
+                session.execute(line);
+                sink.text.clear();
+                commands++;
+            });
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        best = round == 0 ? elapsed : min(best, elapsed);
+    }
+
+    cout << sessions.size() << " sessions, " << commands << " commands; best of " << max(1, rounds) << " rounds: "
+         << best << "s, " << best * 1e9 / max(1L, commands) << " ns per command" << endl;
+    return true;
+}
+
+bool writeCorpus(const string &path, long sessions, uint32_t seed)
+{
+    const char *commands[] = {"go north", "go east", "go south", "go west", "go north", "go east", "go south",
+                              "go west", "take key", "take sword", "take potion", "take cursed_item",
+                              "attack mojo", "attack stationary-man", "use potion", "teleport", "map",
+                              "inventory", "restart"};
+    const int NUMBER_OF_COMMANDS = sizeof(commands) / sizeof(commands[0]);
+
+    ofstream out(path);
+    uint32_t counter = 0;
+    for (long i = 0; i < sessions; i++) {
+        out << "seed " << randomAt(seed, counter++) << '\n';
+        int length = 10 + randomAt(seed, counter++) % 200;
+        for (int j = 0; j < length; j++) {
+            out << commands[randomAt(seed, counter++) % NUMBER_OF_COMMANDS] << '\n';
+        }
+    }
+    return out.good();
+}
+
+//room.cpp
+void buildDefaultRooms(vector<Room *> &rooms, WorldArena *arena)
+{
+    unsigned int first = rooms.size();
+    for (auto &definition : defaultRooms) {
+        rooms.push_back(arena != nullptr ? new (*arena) Room(definition.name) : new Room(definition.name));
+    }
+    for (int i = 0; i < NUMBER_OF_DEFAULT_ROOMS; i++) {
+        rooms[first + i]->index = first + i;
+        for (int direction = 0; direction < 4; direction++) {
+            int target = defaultRooms[i].exits[direction];
+            rooms[first + i]->exits[direction] = target < 0 ? nullptr : rooms[first + target];
+        }
+    }
+}
+
+Room::Room(string name) :
+    Room(name, SymbolTable::intern(name))
+{
+}
+
+Room::Room(string name, Symbol symbol) :
+    name(name), symbol(symbol)
+{
+    version = 0;
+    index   = -1;
+    setExits(nullptr, nullptr, nullptr, nullptr);
+}
+
+void Room::touch()
+{
+    version++;
+}
+
+const string &Room::getName()
+{
+    return name;
+}
+
+Symbol Room::getSymbol()
+{
+    return symbol;
+}
+
+void Room::setExits(Room *north, Room *east, Room *south, Room *west)
+{
+    exits[0] = north;
+    exits[1] = east;
+    exits[2] = south;
+    exits[3] = west;
+}
+
+int Room::directionIndex(const string &direction)
+{
+    static const char *directions[4] = {"north", "east", "south", "west"};
+    for (int i = 0; i < 4; i++) {
+        if (direction == directions[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+Room *Room::getExit(const string &direction)
+{
+    int index = directionIndex(direction);
+    return index < 0 ? nullptr : exits[index];
+}
+
+void Room::addItem(Item *inItem) {
+    MemoryScope scope(TAG_ROOMS);
+    itemsInRoom.push_back(inItem);
+    touch();
+}
+
+string Room::displayItems() {
+    string tempString;
+    displayItems(tempString);
+    return tempString;
+    }
+
+void Room::displayItems(string &line) {
+    if (itemsInRoom.size() < 1) {
+        line = "No items in room";
+        return;
+    }
+    line = "Items in room = ";
+    for (auto item : itemsInRoom) {
+        line += item->getShortDescription();
+        line += "  ";
+    }
+}
+
+int Room::numberOfItems() {
+    return itemsInRoom.size();
+}
+
+const vector<Item*> &Room::getItems() { return itemsInRoom; }
+
+void Room::removeItem(Item *newItem) {
+        touch();
+        for (unsigned int i = 0; i < itemsInRoom.size(); ) {
+            //5. Binary Operator Overloading (item class)
+            if(itemsInRoom.at(i) == newItem) {
+                itemsInRoom.erase(itemsInRoom.begin() + i);
+            } else {
+                i++;
+            }
+        }
+}
+
+bool Room::hasItem(Item *inItem) {
+    for (unsigned int i = 0; i < itemsInRoom.size(); i++) {
+        //5. Binary Operator Overloading (item class)
+        if (itemsInRoom.at(i) == inItem) {
+                return true;
+        }
+    }
+    return false;
+}
+
+bool Room::hasEnemy(Enemy *enemy) {
+    for (unsigned int i = 0; i < enemiesInRoom.size(); i++) {
+        //5. Binary Operator Overloading (enemy class)
+        if (enemiesInRoom.at(i) == enemy) {
+                return true;
+        }
+    }
+    return false;
+}
+
+void Room::addEnemy(Enemy *enemy) {
+    MemoryScope scope(TAG_ROOMS);
+    enemiesInRoom.push_back(enemy);
+    touch();
+}
+
+const vector<Enemy*> &Room::getEnemies() { return this->enemiesInRoom; }
+
+string Room::displayEnemies() {
+    string tempString = "Enemies in room = ";
+    int sizeEnemies = (enemiesInRoom.size());
+    if (enemiesInRoom.size() < 1) {
+        tempString = "No enemies in room";
+        }
+    else if (enemiesInRoom.size() > 0) {
+       int x = (0);
+        for (int n = sizeEnemies; n > 0; n--) {
+            tempString = tempString + enemiesInRoom[x]->getName() + "  " ;
+            x++;
+            }
+        }
+    return tempString;
+}
+
+void Room::removeEnemy(Enemy *enemy) {
+        touch();
+        for (unsigned int i = 0; i < enemiesInRoom.size(); ) {
+            //5. Binary Operator Overloading (enemy class)
+             if(enemiesInRoom.at(i) == enemy) {
+                enemiesInRoom.erase(enemiesInRoom.begin() + i);
+            } else {
+                i++;
+            }
+        }
+}
+
+//roomaccess.cpp
+RoomAccess::RoomAccess()
+{
+    alwaysOpen = 0;
+    keys       = 0;
+}
+
+void RoomAccess::setRequirements(const vector<KeySet> &needed)
+{
+    this->needed = needed;
+    lockedRooms.clear();
+    open.clear();
+    for (size_t i = 0; i < needed.size(); i++) {
+        if (needed[i] == 0) {
+            open.push_back(i);
+        } else {
+            lockedRooms.push_back(i);
+        }
+    }
+    alwaysOpen = open.size();
+    open.reserve(needed.size());  // so gaining keys never allocates
+    keys = 0;
+}
+
+void RoomAccess::hold(KeySet keys)
+{
+    if (keys == this->keys) {
+        return;
+    }
+    this->keys = keys;
+    // Rebuilt in room order rather than patched, so the same keys always give the same
+    // array (and teleporting from a restored checkpoint lands where the original did).
+    open.resize(alwaysOpen);
+    for (int room : lockedRooms) {
+        if (canEnter(room)) {
+            open.push_back(room);
+        }
+    }
+}
+
+KeySet RoomAccess::held() const
+{
+    return keys;
+}
+
+bool RoomAccess::canEnter(int room) const
+{
+    return (needed[room] & ~keys) == 0;
+}
+
+int RoomAccess::numberOfOpenRooms() const
+{
+    return open.size();
+}
+
+int RoomAccess::openRoom(unsigned int random) const
+{
+    return open[random % open.size()];
+}
+
+//roomgraph.cpp
+bool GraphProblems::ok() const
+{
+    return danglingExits == 0 && asymmetricLinks == 0 && unreachableRooms == 0;
+}
+
+RoomGraph RoomGraph::fromWorld(const GeneratedWorld &world)
+{
+    RoomGraph graph;
+    long n = world.numberOfRooms;
+    graph.start   = world.start;
+    graph.victory = world.victory;
+    graph.flags   = world.flags;
+    graph.offsets.reserve(n + 1);
+
+    size_t count = 0;
+    for (int32_t target : world.exits) {
+        count += target >= 0;
+    }
+    graph.targets.reserve(count);
+    graph.exitMasks.reserve(n);
+
+    for (long room = 0; room < n; room++) {
+        graph.offsets.push_back(graph.targets.size());
+        uint8_t mask = 0;
+        for (int direction = 0; direction < 4; direction++) {
+            int32_t target = world.exits[room * 4 + direction];
+            if (target >= 0) {
+                graph.targets.push_back(target);
+                mask |= 1 << direction;
+            }
+        }
+        graph.exitMasks.push_back(mask);
+    }
+    graph.offsets.push_back(graph.targets.size());
+    return graph;
+}
+
+void RoomGraph::toWorld(GeneratedWorld &world) const
+{
+    long n = numberOfRooms();
+    world.numberOfRooms = n;
+    world.start   = start;
+    world.victory = victory;
+    world.flags   = flags;
+    world.exits.assign(n * 4, -1);
+    for (long room = 0; room < n; room++) {
+        for (int direction = 0; direction < 4; direction++) {
+            world.exits[room * 4 + direction] = exit(room, direction);
+        }
+    }
+}
+
+long RoomGraph::numberOfRooms() const
+{
+    return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+int32_t RoomGraph::exit(long room, int direction) const
+{
+    unsigned int mask = exitMasks[room];
+    if (!(mask & (1u << direction))) {
+        return -1;
+    }
+    // Exits are stored in direction order, so the ones before it are the set bits below it.
+    return targets[offsets[room] + __builtin_popcount(mask & ((1u << direction) - 1))];
+}
+
+size_t RoomGraph::bytes() const
+{
+    return offsets.size() * sizeof(uint32_t) + targets.size() * sizeof(int32_t) + exitMasks.size() + flags.size();
+}
+
+GraphProblems RoomGraph::validate() const
+{
+    GraphProblems problems;
+    long n = numberOfRooms();
+
+    for (long room = 0; room < n; room++) {
+        for (int direction = 0; direction < 4; direction++) {
+            int32_t target = exit(room, direction);
+            if (target == -1) {
+                continue;
+            }
+            if (target < 0 || target >= n) {
+                if (problems.danglingExits++ == 0) {
+                    problems.firstDangling = room;
+                }
+            } else if (exit(target, (direction + 2) & 3) != room) {
+                if (problems.asymmetricLinks++ == 0) {
+                    problems.firstAsymmetric = room;
+                }
+            }
+        }
+    }
+
+    vector<bool> seen(n, false);
+    vector<int32_t> queue;
+    queue.reserve(n);
+    if (start >= 0 && start < n) {
+        seen[start] = true;
+        queue.push_back(start);
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        long room = queue[head];
+        for (uint32_t e = offsets[room]; e < offsets[room + 1]; e++) {
+            int32_t target = targets[e];
+            if (target >= 0 && target < n && !seen[target]) {
+                seen[target] = true;
+                queue.push_back(target);
+            }
+        }
+    }
+    for (long room = 0; room < n; room++) {
+        if (!seen[room] && problems.unreachableRooms++ == 0) {
+            problems.firstUnreachable = room;
+        }
+    }
+    return problems;
+}
+
+vector<int32_t> RoomGraph::cuthillMcKee() const
+{
+    long n = numberOfRooms();
+    auto degree = [&](int32_t room) { return offsets[room + 1] - offsets[room]; };
+
+    // Each search starts from the lowest-degree room not yet placed (rooms have at most
+    // four exits, so bucketing by degree is enough to find it).
+    vector<int32_t> byDegree[5];
+    for (long room = 0; room < n; room++) {
+        byDegree[min<uint32_t>(degree(room), 4)].push_back(room);
+    }
+
+    vector<int32_t> order;
+    order.reserve(n);
+    vector<bool> placed(n, false);
+    for (auto &bucket : byDegree) {
+        for (int32_t root : bucket) {
+            if (placed[root]) {
+                continue;
+            }
+            placed[root] = true;
+            size_t head = order.size();
+            order.push_back(root);
+            for (; head < order.size(); head++) {
+                int32_t room = order[head];
+                size_t first = order.size();
+                for (uint32_t e = offsets[room]; e < offsets[room + 1]; e++) {
+                    int32_t target = targets[e];
+                    if (target >= 0 && target < n && !placed[target]) {
+                        placed[target] = true;
+                        order.push_back(target);
+                    }
+                }
+                sort(order.begin() + first, order.end(), [&](int32_t a, int32_t b) {
+                    return degree(a) < degree(b);
+                });
+            }
+        }
+    }
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+RoomGraph RoomGraph::renumbered(const vector<int32_t> &order) const
+{
+    long n = numberOfRooms();
+    vector<int32_t> newIndex(n);
+    for (long i = 0; i < n; i++) {
+        newIndex[order[i]] = i;
+    }
+
+    RoomGraph graph;
+    graph.start   = newIndex[start];
+    graph.victory = newIndex[victory];
+    graph.offsets.reserve(n + 1);
+    graph.targets.reserve(targets.size());
+    graph.exitMasks.reserve(n);
+    graph.flags.reserve(n);
+    for (long i = 0; i < n; i++) {
+        int32_t room = order[i];
+        graph.offsets.push_back(graph.targets.size());
+        graph.exitMasks.push_back(exitMasks[room]);
+        graph.flags.push_back(flags[room]);
+        for (uint32_t e = offsets[room]; e < offsets[room + 1]; e++) {
+            int32_t target = targets[e];
+            graph.targets.push_back(target >= 0 && target < n ? newIndex[target] : target);
+        }
+    }
+    graph.offsets.push_back(graph.targets.size());
+    return graph;
+}
+
+bool RoomGraph::reorder()
+{
+    RoomGraph reordered = renumbered(cuthillMcKee());
+    if (reordered.meanLinkDistance() >= meanLinkDistance()) {
+        return false;
+    }
+    *this = move(reordered);
+    return true;
+}
+
+double RoomGraph::meanLinkDistance() const
+{
+    double total = 0;
+    for (long room = 0; room < numberOfRooms(); room++) {
+        for (uint32_t e = offsets[room]; e < offsets[room + 1]; e++) {
+            total += labs(targets[e] - room);
+        }
+    }
+    return targets.empty() ? 0 : total / targets.size();
+}
+
+//rules.cpp
+namespace {
+
+const char *triggerNames[RuleSet::NUMBER_OF_TRIGGERS] = {"enter", "take", "use", "attack"};
+const char *statNames[RuleSet::NUMBER_OF_STATS]       = {"health", "stamina"};
+
+// What "trigger" may fire: the events whose listeners take the player as their argument.
+// The command events (take, go ...) read theirs as the command's words.
+const char *triggerableEvents[] = {"victory", "defeat", "curse"};
+const int   NUMBER_OF_TRIGGERABLE_EVENTS = sizeof(triggerableEvents) / sizeof(triggerableEvents[0]);
+const char *opcodeNames[RuleSet::NUMBER_OF_OPCODES]   = {
+    "end", "load_stat", "load_number", "store_stat", "add", "subtract", "less", "less_equal",
+    "equal", "not_equal", "jump", "jump_unless", "say", "trigger", "use", "heal"
+};
+
+uint32_t encode(RuleSet::Opcode opcode, int a, int b = 0, int c = 0)
+{
+    return opcode | a << 8 | b << 16 | (uint32_t) c << 24;
+}
+
+uint32_t encodeImmediate(RuleSet::Opcode opcode, int a, int immediate)
+{
+    return opcode | a << 8 | (uint32_t) (uint16_t) immediate << 16;
+}
+
+RuleSet::Opcode opcodeOf(uint32_t instruction) { return (RuleSet::Opcode) (instruction & 0xff); }
+int operandA(uint32_t instruction)             { return instruction >> 8 & 0xff; }
+int operandB(uint32_t instruction)             { return instruction >> 16 & 0xff; }
+int operandC(uint32_t instruction)             { return instruction >> 24; }
+int immediateOf(uint32_t instruction)          { return (int16_t) (instruction >> 16); }
+
+int lookUp(const char *const *names, int count, const string &name)
+{
+    for (int i = 0; i < count; i++) {
+        if (name == names[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Turns rules source into bytecode, one line at a time. Each rule's code is kept apart
+// (jumps are relative, so rules for the same subject can simply be put one after another)
+// until RuleSet::compile lays them all out.
+struct RuleCompiler
+{
+    struct Rule
+    {
+        RuleSet::Trigger trigger;
+        Symbol           subject;
+        vector<uint32_t> code;
+    };
+    struct OpenIf
+    {
+        size_t condition;  // the JUMP_UNLESS to point past the "then" part
+        size_t skipElse;   // the JUMP at the end of the "then" part, or 0 before an else
+    };
+
+    vector<Rule>   rules;
+    vector<string> messages;
+    vector<string> events;
+    vector<Symbol> subjects;
+
+    bool           inRule = false;
+    vector<OpenIf> openIfs;
+    string         error;
+
+    vector<uint32_t> &code() { return rules.back().code; }
+
+    bool fail(const string &what)
+    {
+        error = what;
+        return false;
+    }
+
+    // Words, numbers, quoted strings (kept with their opening quote, so "say" and say
+    // differ) and operators, up to a #.
+    bool tokenize(const string &line, vector<string> &tokens)
+    {
+        for (size_t i = 0; i < line.size(); ) {
+            char c = line[i];
+            if (c == '#') {
+                break;
+            } else if (isspace((unsigned char) c)) {
+                i++;
+            } else if (c == '"') {
+                string text = "\"";
+                for (i++; i < line.size() && line[i] != '"'; i++) {
+                    if (line[i] == '\\' && i + 1 < line.size()) {
+                        i++;
+                        text += line[i] == 'n' ? '\n' : line[i];
+                    } else {
+                        text += line[i];
+                    }
+                }
+                if (i == line.size()) {
+                    return fail("a string has no closing quote");
+                }
+                tokens.push_back(text);
+                i++;
+            } else if (isalnum((unsigned char) c) || c == '_') {
+                size_t start = i;
+                while (i < line.size() && (isalnum((unsigned char) line[i]) || line[i] == '_' || line[i] == '-')) {
+                    i++;
+                }
+                tokens.push_back(line.substr(start, i - start));
+            } else if (strchr("<>=!", c)) {
+                size_t start = i;
+                while (i < line.size() && strchr("<>=!", line[i])) {
+                    i++;
+                }
+                tokens.push_back(line.substr(start, i - start));
+            } else if (c == '+' || c == '-') {
+                tokens.push_back(string(1, c));
+                i++;
+            } else {
+                return fail(string("unexpected '") + c + "'");
+            }
+        }
+        return true;
+    }
+
+    // Loads a stat or a number into register r.
+    bool operand(const vector<string> &tokens, size_t &at, int r)
+    {
+        if (at == tokens.size()) {
+            return fail("expected health, stamina or a number at the end of the line");
+        }
+        const string &token = tokens[at++];
+        int stat = lookUp(statNames, RuleSet::NUMBER_OF_STATS, token);
+        if (stat >= 0) {
+            code().push_back(encode(RuleSet::LOAD_STAT, r, stat));
+            return true;
+        }
+        if (!isdigit((unsigned char) token[0])) {
+            return fail("expected health, stamina or a number, not '" + token + "'");
+        }
+        char *end;
+        long number = strtol(token.c_str(), &end, 10);
+        if (*end != '\0' || number > INT16_MAX) {
+            return fail("'" + token + "' isn't a number from 0 to 32767");
+        }
+        code().push_back(encodeImmediate(RuleSet::LOAD_NUMBER, r, number));
+        return true;
+    }
+
+    // operand [+|- operand], leaving the result in r and using r + 1.
+    bool expression(const vector<string> &tokens, size_t &at, int r)
+    {
+        if (!operand(tokens, at, r)) {
+            return false;
+        }
+        if (at < tokens.size() && (tokens[at] == "+" || tokens[at] == "-")) {
+            RuleSet::Opcode opcode = tokens[at++] == "+" ? RuleSet::ADD : RuleSet::SUBTRACT;
+            if (!operand(tokens, at, r + 1)) {
+                return false;
+            }
+            code().push_back(encode(opcode, r, r, r + 1));
+        }
+        return true;
+    }
+
+    bool endOfLine(const vector<string> &tokens, size_t at)
+    {
+        return at == tokens.size() || fail("unexpected '" + tokens[at] + "'");
+    }
+
+    // Points the jump at code[from] to the end of the code so far.
+    bool patchJump(size_t from)
+    {
+        long distance = (long) code().size() - (long) (from + 1);
+        if (distance > INT16_MAX) {
+            return fail("the rule is too long to jump over");
+        }
+        code()[from] = encodeImmediate(opcodeOf(code()[from]), operandA(code()[from]), distance);
+        return true;
+    }
+
+    // A name in a say, trigger or use: its place in the pool, which must fit an immediate.
+    template <typename T>
+    bool pooled(vector<T> &pool, const T &value, int &index)
+    {
+        auto found = find(pool.begin(), pool.end(), value);
+        index = found - pool.begin();
+        if (found == pool.end()) {
+            pool.push_back(value);
+        }
+        return index <= UINT16_MAX || fail("too many different names and messages");
+    }
+
+    bool statement(const vector<string> &tokens)
+    {
+        const string &first = tokens[0];
+        size_t at = 1;
+        int index;
+
+        if (first == "on") {
+            int trigger = tokens.size() > 1 ? lookUp(triggerNames, RuleSet::NUMBER_OF_TRIGGERS, tokens[1]) : -1;
+            if (inRule) {
+                return fail("'on' inside a rule; is an 'end' missing?");
+            }
+            if (trigger < 0 || tokens.size() != 3) {
+                return fail("expected on enter|take|use|attack <name>");
+            }
+            rules.push_back({(RuleSet::Trigger) trigger, SymbolTable::intern(tokens[2]), {}});
+            inRule = true;
+            return true;
+        }
+        if (!inRule) {
+            return fail("expected a rule starting with 'on', not '" + first + "'");
+        }
+
+        if (first == "end") {
+            if (openIfs.empty()) {
+                inRule = false;
+                return endOfLine(tokens, at);
+            }
+            OpenIf open = openIfs.back();
+            openIfs.pop_back();
+            return patchJump(open.skipElse != 0 ? open.skipElse : open.condition) && endOfLine(tokens, at);
+        }
+        if (first == "else") {
+            if (openIfs.empty() || openIfs.back().skipElse != 0) {
+                return fail("'else' without an 'if'");
+            }
+            openIfs.back().skipElse = code().size();
+            code().push_back(encodeImmediate(RuleSet::JUMP, 0, 0));
+            return patchJump(openIfs.back().condition) && endOfLine(tokens, at);
+        }
+        if (first == "if") {
+            if (!expression(tokens, at, 0)) {
+                return false;
+            }
+            string comparison = at < tokens.size() ? tokens[at++] : "";
+            // a > b is b < a, and a >= b is b <= a.
+            bool swapped = comparison == ">" || comparison == ">=";
+            RuleSet::Opcode opcode = comparison == "<" || comparison == ">"   ? RuleSet::LESS :
+                                     comparison == "<=" || comparison == ">=" ? RuleSet::LESS_EQUAL :
+                                     comparison == "=="                       ? RuleSet::EQUAL :
+                                     comparison == "!="                       ? RuleSet::NOT_EQUAL : RuleSet::END;
+            if (opcode == RuleSet::END) {
+                return fail("expected < <= > >= == or != after 'if'");
+            }
+            if (!expression(tokens, at, 1) || !endOfLine(tokens, at)) {
+                return false;
+            }
+            code().push_back(swapped ? encode(opcode, 0, 1, 0) : encode(opcode, 0, 0, 1));
+            openIfs.push_back({code().size(), 0});
+            code().push_back(encodeImmediate(RuleSet::JUMP_UNLESS, 0, 0));
+            return true;
+        }
+        if (first == "say") {
+            if (tokens.size() != 2 || tokens[1][0] != '"') {
+                return fail("expected say \"<message>\"");
+            }
+            if (!pooled(messages, tokens[1].substr(1), index)) {
+                return false;
+            }
+            code().push_back(encodeImmediate(RuleSet::SAY, 0, index));
+            return true;
+        }
+        if (first == "heal") {
+            if (tokens.size() != 1) {
+                return fail("expected heal on its own");
+            }
+            code().push_back(encode(RuleSet::HEAL, 0));
+            return true;
+        }
+        if (first == "trigger" || first == "use") {
+            if (tokens.size() != 2 || tokens[1][0] == '"') {
+                return fail("expected " + first + " <name>");
+            }
+            bool trigger = first == "trigger";
+            if (trigger && lookUp(triggerableEvents, NUMBER_OF_TRIGGERABLE_EVENTS, tokens[1]) < 0) {
+                return fail("can't trigger '" + tokens[1] + "', only victory, defeat or curse");
+            }
+            if (trigger ? !pooled(events, tokens[1], index) : !pooled(subjects, SymbolTable::intern(tokens[1]), index)) {
+                return false;
+            }
+            code().push_back(encodeImmediate(trigger ? RuleSet::TRIGGER : RuleSet::USE_ITEM, 0, index));
+            return true;
+        }
+
+        int stat = lookUp(statNames, RuleSet::NUMBER_OF_STATS, first);
+        if (stat >= 0) {
+            if (at == tokens.size() || tokens[at++] != "=") {
+                return fail("expected " + first + " = <value>");
+            }
+            if (!expression(tokens, at, 0) || !endOfLine(tokens, at)) {
+                return false;
+            }
+            code().push_back(encode(RuleSet::STORE_STAT, stat, 0));
+            return true;
+        }
+        return fail("don't know what '" + first + "' means");
+    }
+
+    bool compile(const string &source)
+    {
+        istringstream lines(source);
+        string line;
+        vector<string> tokens;
+        for (int number = 1; getline(lines, line); number++) {
+            tokens.clear();
+            if (!tokenize(line, tokens) || (!tokens.empty() && !statement(tokens))) {
+                error = "line " + to_string(number) + ": " + error;
+                return false;
+            }
+        }
+        if (inRule) {
+            return fail("the last rule has no 'end'");
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+RuleSet::RuleSet()
+{
+    code.push_back(encode(END, 0));
+}
+
+bool RuleSet::compile(const string &source, string &error)
+{
+    RuleCompiler compiler;
+    if (!compiler.compile(source)) {
+        error = compiler.error;
+        return false;
+    }
+
+    code.assign(1, encode(END, 0));
+    for (auto &table : entries) {
+        table.clear();
+    }
+    // Rules for the same trigger and subject run one after the other, in the order written.
+    for (size_t i = 0; i < compiler.rules.size(); i++) {
+        const RuleCompiler::Rule &rule = compiler.rules[i];
+        vector<uint32_t> &table = entries[rule.trigger];
+        if (rule.subject < table.size() && table[rule.subject] != 0) {
+            continue;  // already laid out with the first one
+        }
+        if (rule.subject >= table.size()) {
+            table.resize(rule.subject + 1, 0);
+        }
+        table[rule.subject] = code.size();
+        for (size_t j = i; j < compiler.rules.size(); j++) {
+            if (compiler.rules[j].trigger == rule.trigger && compiler.rules[j].subject == rule.subject) {
+                code.insert(code.end(), compiler.rules[j].code.begin(), compiler.rules[j].code.end());
+            }
+        }
+        code.push_back(encode(END, 0));
+    }
+    messages = move(compiler.messages);
+    events   = move(compiler.events);
+    subjects = move(compiler.subjects);
+    return true;
+}
+
+bool RuleSet::run(Trigger trigger, Symbol subject, Player &player) const
+{
+    return run(trigger, subject, player, nullptr, 0);
+}
+
+bool RuleSet::run(Trigger trigger, Symbol subject, Player &player, ostream &out) const
+{
+    return run(trigger, subject, player, &out, 0);
+}
+
+// Without out, says go to console(), which is only looked up once something is said.
+bool RuleSet::run(Trigger trigger, Symbol subject, Player &player, ostream *out, int depth) const
+{
+    const vector<uint32_t> &table = entries[trigger];
+    size_t pc = subject < table.size() ? table[subject] : 0;
+    if (pc == 0) {
+        return false;
+    }
+
+    int32_t r[NUMBER_OF_REGISTERS];
+    while (true) {
+        uint32_t instruction = code[pc++];
+        int a = operandA(instruction);
+        switch (opcodeOf(instruction)) {
+        case END:
+            return true;
+        case LOAD_STAT:
+            r[a] = operandB(instruction) == HEALTH ? player.getHealth() : player.getStamina();
+            break;
+        case LOAD_NUMBER:
+            r[a] = immediateOf(instruction);
+            break;
+        case STORE_STAT:
+            if (a == HEALTH) {
+                player.setHealth(r[operandB(instruction)]);
+            } else {
+                player.setStamina(r[operandB(instruction)]);
+            }
+            break;
+        case ADD:
+            r[a] = r[operandB(instruction)] + r[operandC(instruction)];
+            break;
+        case SUBTRACT:
+            r[a] = r[operandB(instruction)] - r[operandC(instruction)];
+            break;
+        case LESS:
+            r[a] = r[operandB(instruction)] < r[operandC(instruction)];
+            break;
+        case LESS_EQUAL:
+            r[a] = r[operandB(instruction)] <= r[operandC(instruction)];
+            break;
+        case EQUAL:
+            r[a] = r[operandB(instruction)] == r[operandC(instruction)];
+            break;
+        case NOT_EQUAL:
+            r[a] = r[operandB(instruction)] != r[operandC(instruction)];
+            break;
+        case JUMP:
+            pc += immediateOf(instruction);
+            break;
+        case JUMP_UNLESS:
+            if (r[a] == 0) {
+                pc += immediateOf(instruction);
+            }
+            break;
+        case SAY:
+            (out != nullptr ? *out : console()) << messages[(uint16_t) immediateOf(instruction)] << endl;
+            break;
+        case TRIGGER:
+            EventManager::getInstance().trigger(events[(uint16_t) immediateOf(instruction)], &player);
+            break;
+        case USE_ITEM:
+            if (depth < MAX_USE_DEPTH) {
+                run(USE, subjects[(uint16_t) immediateOf(instruction)], player, out, depth + 1);
+            }
+            break;
+        case HEAL:
+            //4. Unary operator overloading (example)
+            ++player;
+            break;
+        case NUMBER_OF_OPCODES:
+            return true;
+        }
+    }
+}
+
+void RuleSet::disassemble(ostream &out) const
+{
+    // Each subject's code, in the order it was laid out.
+    vector<pair<uint32_t, pair<int, Symbol>>> starts;
+    for (int trigger = 0; trigger < NUMBER_OF_TRIGGERS; trigger++) {
+        for (Symbol subject = 0; subject < entries[trigger].size(); subject++) {
+            if (entries[trigger][subject] != 0) {
+                starts.push_back({entries[trigger][subject], {trigger, subject}});
+            }
+        }
+    }
+    sort(starts.begin(), starts.end());
+
+    char line[128];
+    for (auto &start : starts) {
+        out << "on " << triggerNames[start.second.first] << ' ' << SymbolTable::name(start.second.second) << endl;
+        for (size_t pc = start.first; ; pc++) {
+            uint32_t instruction = code[pc];
+            Opcode   opcode      = opcodeOf(instruction);
+            int      a = operandA(instruction), b = operandB(instruction), c = operandC(instruction);
+            uint16_t index = immediateOf(instruction);
+            snprintf(line, sizeof(line), opcode == END || opcode == HEAL ? "  %4zu  %s" : "  %4zu  %-12s", pc, opcodeNames[opcode]);
+            out << line;
+            switch (opcode) {
+            case LOAD_STAT:   out << 'r' << a << ", " << statNames[b]; break;
+            case LOAD_NUMBER: out << 'r' << a << ", " << immediateOf(instruction); break;
+            case STORE_STAT:  out << statNames[a] << ", r" << b; break;
+            case JUMP:        out << "-> " << pc + 1 + immediateOf(instruction); break;
+            case JUMP_UNLESS: out << 'r' << a << " -> " << pc + 1 + immediateOf(instruction); break;
+            case SAY:         out << '"' << messages[index].substr(0, messages[index].find('\n')) << '"'; break;
+            case TRIGGER:     out << events[index]; break;
+            case USE_ITEM:    out << SymbolTable::name(subjects[index]); break;
+            case END:
+            case HEAL:        break;
+            default:          out << 'r' << a << ", r" << b << ", r" << c; break;
+            }
+            out << endl;
+            if (opcode == END) {
+                break;
+            }
+        }
+    }
+    out << code.size() << " instructions, " << code.size() * sizeof(uint32_t) << " bytes" << endl;
+}
+
+bool runRulesCheck(const string &path, long events)
+{
+    string source = defaultRules;
+    if (!path.empty()) {
+        ifstream file(path);
+        if (!file) {
+            cerr << "Could not read " << path << endl;
+            return false;
+        }
+        source.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+
+    RuleSet rules;
+    string  error;
+    if (!rules.compile(source, error)) {
+        cerr << (path.empty() ? "The built-in rules" : path) << ", " << error << endl;
+        return false;
+    }
+    rules.disassemble(cout);
+
+    // The rule with the most work in it: find the first subject with rules, preferring use.
+    Symbol busy = SymbolTable::NO_SYMBOL;
+    RuleSet::Trigger busyTrigger = RuleSet::ENTER;
+    EventManager::getInstance().mute();
+    Player player("check");
+    for (int trigger = RuleSet::NUMBER_OF_TRIGGERS - 1; trigger >= 0 && busy == SymbolTable::NO_SYMBOL; trigger--) {
+        for (Symbol subject = 1; subject < SymbolTable::size(); subject++) {
+            player.setHealth(50);
+            player.setStamina(50);
+            if (rules.run((RuleSet::Trigger) trigger, subject, player)) {
+                busy = subject;
+                busyTrigger = (RuleSet::Trigger) trigger;
+                break;
+            }
+        }
+    }
+    Symbol idle = SymbolTable::intern("check");  // nothing can have rules for the player
+
+    long   ran = 0;
+    double seconds[2];
+    for (int pass = 0; pass < 2; pass++) {
+        Symbol           subject = pass == 0 ? idle : busy;
+        RuleSet::Trigger trigger = pass == 0 ? RuleSet::ENTER : busyTrigger;
+        auto start = chrono::steady_clock::now();
+        for (long i = 0; i < events; i++) {
+            // Keeps the player alive, so a rule that hurts can run forever.
+            player.setHealth(50);
+            player.setStamina(50);
+            ran += rules.run(trigger, subject, player);
+        }
+        seconds[pass] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    cout << events << " events without rules: " << seconds[0] / events * 1e9 << " ns each" << endl;
+    if (busy != SymbolTable::NO_SYMBOL) {
+        cout << events << " events running on " << triggerNames[busyTrigger] << ' ' << SymbolTable::name(busy)
+             << ": " << seconds[1] / events * 1e9 << " ns each" << endl;
+    }
+
+    // Rules that must not compile, and the start of the error each must give.
+    const char *mistakes[][2] = {
+        {"on take key\n    trigger take\nend\n",      "line 2: can't trigger 'take'"},
+        {"on enter A\n    say \"Hi\"\n    trigger go\nend\n", "line 3: can't trigger 'go'"},
+    };
+    bool rejected = true;
+    for (auto &mistake : mistakes) {
+        RuleSet wrong;
+        string  why;
+        if (wrong.compile(mistake[0], why) || why.compare(0, strlen(mistake[1]), mistake[1]) != 0) {
+            cout << "Should have been rejected with \"" << mistake[1] << "\" but was " << (why.empty() ? "accepted" : why) << endl;
+            rejected = false;
+        }
+    }
+    cout << (rejected ? "PASS" : "FAIL") << ": " << sizeof(mistakes) / sizeof(mistakes[0]) << " broken rules checked" << endl;
+    return rejected && ran == (busy != SymbolTable::NO_SYMBOL ? events : 0);
+}
+
+//session.cpp
+Session::Session(ostream *output)
+{
+    if (output != nullptr) {
+        events.setOutput(output);
+    } else {
+        events.mute();
+    }
+
+    // The Game registers its listeners with whichever EventManager is current.
+    SessionScope scope(events);
+    game  = new Game();
+    input = new InputListener(game);
+    events.listen("input", input);
+}
+
+Session::~Session()
+{
+    SessionScope scope(events);
+    delete game;
+    delete input;
+}
+
+bool Session::execute(const string &line)
+{
+    SessionScope scope(events);
+    events.dispatch(line);
+    return events.is_running();
+}
+
+Game &Session::getGame()
+{
+    return *game;
+}
+
+EventManager &Session::getEvents()
+{
+    return events;
+}
+
+SessionScope::SessionScope(EventManager &events)
+{
+    EventManager::setInstance(&events);
+}
+
+SessionScope::~SessionScope()
+{
+    EventManager::setInstance(nullptr);
+}
+
+//sessionserver.cpp
+SessionServer::Connection::Connection(int fd) :
+    stream(&output)
+{
+    this->fd  = fd;
+    session   = nullptr;
+    writing   = false;
+    lastInput = chrono::steady_clock::now();
+}
+
+SessionServer::SessionServer(const ServerSettings &settings) :
+    settings(settings)
+{
+    listener  = -1;
+    epoll     = -1;
+    running   = false;
+    lastSweep = chrono::steady_clock::now();
+}
+
+SessionServer::~SessionServer()
+{
+    while (!connections.empty()) {
+        close(connections.begin()->second);
+    }
+    if (listener >= 0) {
+        ::close(listener);
+        unlink(settings.path.c_str());
+    }
+    if (epoll >= 0) {
+        ::close(epoll);
+    }
+}
+
+bool SessionServer::start()
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (settings.path.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path too long: " << settings.path << endl;
+        return false;
+    }
+    memcpy(address.sun_path, settings.path.c_str(), settings.path.size() + 1);
+
+    // A socket file left behind by a server that was killed would make bind fail.
+    unlink(settings.path.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0 || bind(listener, (sockaddr *) &address, sizeof(address)) < 0
+        || listen(listener, SOMAXCONN) < 0) {
+        cerr << "Could not listen on " << settings.path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event = {};
+    event.events  = EPOLLIN;
+    event.data.fd = listener;
+    if (epoll < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event) < 0) {
+        cerr << "Could not create epoll instance: " << strerror(errno) << endl;
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void SessionServer::run()
+{
+    while (running) {
+        poll(1000);
+    }
+}
+
+void SessionServer::stop()
+{
+    running = false;
+}
+
+int SessionServer::numberOfSessions()
+{
+    return connections.size();
+}
+
+void SessionServer::poll(int timeoutMs)
+{
+    const int MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
+
+    int ready = epoll_wait(epoll, events, MAX_EVENTS, timeoutMs);
+    for (int i = 0; i < ready; i++) {
+        int fd = events[i].data.fd;
+        if (fd == listener) {
+            accept();
+            continue;
+        }
+
+        // An earlier event in this batch may have closed it already.
+        auto found = connections.find(fd);
+        if (found == connections.end()) {
+            continue;
+        }
+        Connection *connection = found->second;
+        if (events[i].events & EPOLLOUT) {
+            if (!write(connection)) {
+                continue;
+            }
+        }
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            read(connection);
+        }
+    }
+
+    // Sweeping every connection for idleness is cheap next to waiting for them, but there's
+    // no need to do it more often than a fraction of the timeout.
+    auto now = chrono::steady_clock::now();
+    double interval = min(1.0, settings.idleSeconds / 4);
+    if (chrono::duration<double>(now - lastSweep).count() >= interval) {
+        lastSweep = now;
+        closeIdle();
+    }
+}
+
+void SessionServer::accept()
+{
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return; // EAGAIN: no more waiting; anything else: nothing to do about it here
+        }
+
+        if ((int) connections.size() >= settings.maxSessions) {
+            const char full[] = "The server is full, try again later.\n";
+            send(fd, full, sizeof(full) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            ::close(fd);
+            continue;
+        }
+
+        Connection *connection = new Connection(fd);
+        connection->session = new Session(&connection->stream);
+        connection->output.text += "> ";
+        connections[fd] = connection;
+
+        epoll_event event = {};
+        event.events  = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+        write(connection);
+    }
+}
+
+void SessionServer::read(Connection *connection)
+{
+    char buffer[4096];
+    bool ended = false;
+
+    while (true) {
+        ssize_t count = ::read(connection->fd, buffer, sizeof(buffer));
+        if (count > 0) {
+            connection->input.append(buffer, count);
+            continue;
+        }
+        if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            ended = true; // the client hung up (or the socket broke)
+        }
+        if (count == 0 || errno != EINTR) {
+            break;
+        }
+    }
+
+    // Run every complete line; a partial one waits for the rest.
+    bool open = true;
+    size_t start = 0, end;
+    while (open && (end = connection->input.find('\n', start)) != string::npos) {
+        string line = connection->input.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        start = end + 1;
+        connection->lastInput = chrono::steady_clock::now();
+
+        open = connection->session->execute(line);
+        if (open) {
+            connection->output.text += "> ";
+        }
+    }
+    connection->input.erase(0, start);
+
+    if (connection->input.size() > settings.maxLineBytes) {
+        connection->output.text += "\nThat line is too long.\n";
+        open = false;
+    }
+
+    if (!write(connection)) {
+        return;
+    }
+    if (!open || ended) {
+        close(connection);
+    }
+}
+
+bool SessionServer::write(Connection *connection)
+{
+    string &pending = connection->output.text;
+    size_t sent = 0;
+    while (sent < pending.size()) {
+        ssize_t count = send(connection->fd, pending.data() + sent, pending.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (count > 0) {
+            sent += count;
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            close(connection);
+            return false;
+        }
+    }
+    pending.erase(0, sent);
+
+    if (pending.size() > settings.maxOutputBytes) {
+        close(connection);
+        return false;
+    }
+
+    // Only ask epoll about writability while there's something left to write.
+    bool waiting = !pending.empty();
+    if (waiting != connection->writing) {
+        epoll_event event = {};
+        event.events  = waiting ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.fd = connection->fd;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->writing = waiting;
+    }
+    return true;
+}
+
+void SessionServer::close(Connection *connection)
+{
+    epoll_ctl(epoll, EPOLL_CTL_DEL, connection->fd, nullptr);
+    ::close(connection->fd);
+    connections.erase(connection->fd);
+    delete connection->session;
+    delete connection;
+}
+
+void SessionServer::closeIdle()
+{
+    auto now = chrono::steady_clock::now();
+    vector<Connection *> idle;
+    for (auto &entry : connections) {
+        if (chrono::duration<double>(now - entry.second->lastInput).count() > settings.idleSeconds) {
+            idle.push_back(entry.second);
+        }
+    }
+    for (auto connection : idle) {
+        connection->output.text += "\nClosing the session after being idle too long.\n";
+        if (write(connection)) {
+            close(connection);
+        }
+    }
+}
+
+namespace {
+
+atomic<bool> interrupted(false);
+
+void interrupt(int)
+{
+    interrupted = true;
+}
+
+// Blocking client side of the test: connects to the server's socket.
+int connectClient(const string &path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads until the text ends with the prompt, the server hangs up or two seconds pass.
+// Returns false only on a timeout.
+bool readReply(int fd, string &reply)
+{
+    reply.clear();
+    char buffer[4096];
+    while (reply.size() < 2 || reply.compare(reply.size() - 2, 2, "> ") != 0) {
+        pollfd waiting = {fd, POLLIN, 0};
+        if (::poll(&waiting, 1, 2000) <= 0) {
+            return false;
+        }
+        ssize_t count = ::read(fd, buffer, sizeof(buffer));
+        if (count <= 0) {
+            return true;
+        }
+        reply.append(buffer, count);
+    }
+    return true;
+}
+
+bool check(bool passed, const string &what)
+{
+    cout << (passed ? "PASS " : "FAIL ") << what << endl;
+    return passed;
+}
+
+} // namespace
+
+bool runServer(const ServerSettings &settings)
+{
+    SessionServer server(settings);
+    if (!server.start()) {
+        return false;
+    }
+    signal(SIGINT,  interrupt);
+    signal(SIGTERM, interrupt);
+    cout << "Serving games on " << settings.path << " (up to " << settings.maxSessions << " sessions)" << endl;
+
+    // The signal interrupts epoll_wait, so this notices straight away.
+    while (!interrupted) {
+        server.poll(1000);
+    }
+    cout << "Stopped with " << server.numberOfSessions() << " session(s) open" << endl;
+    return true;
+}
+
+bool runServerTest(int clients)
+{
+    // Every client needs two descriptors here, its own and the server's.
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    ServerSettings settings;
+    settings.path        = "/tmp/zork-test-" + to_string(getpid()) + ".sock";
+    settings.maxSessions = clients;
+    settings.idleSeconds = 1;
+
+    SessionServer server(settings);
+    if (!server.start()) {
+        return false;
+    }
+    atomic<bool> serving(true);
+    thread serverThread([&] {
+        while (serving) {
+            server.poll(50);
+        }
+    });
+
+    bool passed = true;
+    string reply;
+
+    vector<int> fds;
+    int welcomed = 0;
+    for (int i = 0; i < clients; i++) {
+        int fd = connectClient(settings.path);
+        if (fd < 0) {
+            break;
+        }
+        fds.push_back(fd);
+        welcomed += readReply(fd, reply) && reply.find("Welcome to Zork!") != string::npos;
+    }
+    passed &= check(welcomed == clients, to_string(welcomed) + " of " + to_string(clients) + " clients got their own game");
+
+    // Every client sends a command before any reply is read, so they're all in flight at once.
+    auto start = chrono::steady_clock::now();
+    const int ROUNDS = 4;
+    const char *commands[ROUNDS] = {"go north\n", "go south\n", "take key\n", "info\n"};
+    int answered = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int fd : fds) {
+            ::write(fd, commands[round], strlen(commands[round]));
+        }
+        for (int fd : fds) {
+            answered += readReply(fd, reply) && reply.size() > 2;
+        }
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    passed &= check(answered == ROUNDS * (int) fds.size(), to_string(answered) + " commands answered ("
+                    + to_string((long) (answered / max(elapsed, 1e-9))) + " commands/s)");
+
+    int extra = connectClient(settings.path);
+    readReply(extra, reply);
+    passed &= check(reply.find("server is full") != string::npos, "a client past the limit is turned away");
+    ::close(extra);
+
+    if (!fds.empty()) {
+        ::write(fds[0], "exit\n", 5);
+        readReply(fds[0], reply);
+        char byte;
+        passed &= check(::read(fds[0], &byte, 1) == 0, "\"exit\" ends the session and closes the connection");
+    }
+
+    this_thread::sleep_for(chrono::milliseconds(1600));
+    int timedOut = 0;
+    for (size_t i = 1; i < fds.size(); i++) {
+        readReply(fds[i], reply);
+        timedOut += reply.find("idle too long") != string::npos;
+    }
+    passed &= check(timedOut == (int) fds.size() - 1, to_string(timedOut) + " idle sessions closed");
+
+    serving = false;
+    serverThread.join();
+    passed &= check(server.numberOfSessions() == 0, "no sessions left open");
+
+    for (int fd : fds) {
+        ::close(fd);
+    }
+    return passed;
+}
+
+//coroutinesession.cpp
+#if __cpp_impl_coroutine
+
+SessionMailbox::SessionMailbox() :
+    stream(&output)
+{
+}
+
+bool SessionMailbox::NextLine::await_ready()
+{
+    return mailbox.hasLine;
+}
+
+void SessionMailbox::NextLine::await_suspend(coroutine_handle<> session)
+{
+    mailbox.waiting = session;
+}
+
+string SessionMailbox::NextLine::await_resume()
+{
+    mailbox.hasLine = false;
+    return std::move(mailbox.line);
+}
+
+SessionMailbox::NextLine SessionMailbox::nextLine()
+{
+    return NextLine{*this};
+}
+
+atomic<size_t> SessionTask::promise_type::lastFrameSize(0);
+
+SessionTask SessionTask::promise_type::get_return_object()
+{
+    return SessionTask(coroutine_handle<promise_type>::from_promise(*this));
+}
+
+suspend_never SessionTask::promise_type::initial_suspend() noexcept
+{
+    return {};
+}
+
+suspend_always SessionTask::promise_type::final_suspend() noexcept
+{
+    return {};
+}
+
+void SessionTask::promise_type::return_void()
+{
+}
+
+void SessionTask::promise_type::unhandled_exception()
+{
+    terminate();
+}
+
+void *SessionTask::promise_type::operator new(size_t size)
+{
+    lastFrameSize = size;
+    return ::operator new(size);
+}
+
+void SessionTask::promise_type::operator delete(void *frame, size_t)
+{
+    ::operator delete(frame);
+}
+
+SessionTask::SessionTask(coroutine_handle<promise_type> handle)
+{
+    this->handle = handle;
+}
+
+SessionTask::SessionTask(SessionTask &&other)
+{
+    handle = other.handle;
+    other.handle = nullptr;
+}
+
+SessionTask::~SessionTask()
+{
+    // Destroying a suspended session runs the destructors of everything in its frame.
+    if (handle) {
+        handle.destroy();
+    }
+}
+
+SessionTask playSession(SessionMailbox &mailbox)
+{
+    Session session(&mailbox.stream);
+    while (true) {
+        string line = co_await mailbox.nextLine();
+        if (!session.execute(line)) {
+            break;
+        }
+    }
+    mailbox.finished = true;
+}
+
+CoroutineScheduler::~CoroutineScheduler()
+{
+    tasks.clear();
+    for (auto mailbox : mailboxes) {
+        delete mailbox;
+    }
+}
+
+int CoroutineScheduler::spawn()
+{
+    mailboxes.push_back(new SessionMailbox());
+    tasks.push_back(playSession(*mailboxes.back()));
+    return mailboxes.size() - 1;
+}
+
+void CoroutineScheduler::deliver(int session, const string &line)
+{
+    SessionMailbox *mailbox = mailboxes[session];
+    if (mailbox->finished) {
+        return;
+    }
+    mailbox->line    = line;
+    mailbox->hasLine = true;
+    ready.push_back(session);
+}
+
+void CoroutineScheduler::runReady()
+{
+    for (size_t i = 0; i < ready.size(); i++) {
+        SessionMailbox *mailbox = mailboxes[ready[i]];
+        if (mailbox->hasLine && mailbox->waiting) {
+            coroutine_handle<> session = mailbox->waiting;
+            mailbox->waiting = nullptr;
+            session.resume();
+        }
+    }
+    ready.clear();
+}
+
+string &CoroutineScheduler::output(int session)
+{
+    return mailboxes[session]->output.text;
+}
+
+bool CoroutineScheduler::finished(int session)
+{
+    return mailboxes[session]->finished;
+}
+
+int CoroutineScheduler::numberOfSessions()
+{
+    return mailboxes.size();
+}
+
+namespace {
+
+// The thread-per-session way to do the same thing, for comparison: each session's thread
+// blocks until it's handed a line, and the caller blocks until it has been played.
+struct ThreadSession
+{
+    mutex              lock;
+    condition_variable changed;
+    string             line;
+    bool               hasLine = false;
+    bool               started = false;
+    bool               stopping = false;
+    thread             worker;
+
+    void run()
+    {
+        Session session;
+        unique_lock<mutex> guard(lock);
+        started = true;
+        changed.notify_all();
+        while (true) {
+            changed.wait(guard, [this] { return hasLine || stopping; });
+            if (stopping) {
+                return;
+            }
+            session.execute(line);
+            hasLine = false;
+            changed.notify_all();
+        }
+    }
+
+    void play(const string &command)
+    {
+        unique_lock<mutex> guard(lock);
+        line    = command;
+        hasLine = true;
+        changed.notify_all();
+        changed.wait(guard, [this] { return !hasLine; });
+    }
+};
+
+} // namespace
+
+bool runCoroutineBenchmark(int sessions, int threads, long commands)
+{
+    // An empty line goes through the whole input path but no command, so what's left to
+    // measure is mostly getting into the session and back out.
+    const string noCommand = "";
+    const string command   = "go north";
+
+    cout << "Coroutines: " << sessions << " sessions on one thread" << endl;
+    long heapBefore = MemoryTracker::totalLiveBytes();
+    long rssBefore  = residentKilobytes();
+    auto start = chrono::steady_clock::now();
+
+    CoroutineScheduler *scheduler = new CoroutineScheduler();
+    for (int i = 0; i < sessions; i++) {
+        scheduler->spawn();
+        scheduler->output(i).clear();
+    }
+    double created = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long heapPerSession = (MemoryTracker::totalLiveBytes() - heapBefore) / max(1, sessions);
+    long rssPerSession  = (residentKilobytes() - rssBefore) * 1024 / max(1, sessions);
+
+    start = chrono::steady_clock::now();
+    for (long i = 0; i < commands; i++) {
+        scheduler->deliver(i % sessions, noCommand);
+        scheduler->runReady();
+    }
+    double switched = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool playing = true;
+    for (int i = 0; i < sessions; i++) {
+        scheduler->output(i).clear();
+        scheduler->deliver(i, command);
+    }
+    scheduler->runReady();
+    for (int i = 0; i < sessions; i++) {
+        playing &= scheduler->output(i).find("You are in E") != string::npos;
+    }
+
+    cout << "  frame " << SessionTask::promise_type::lastFrameSize << " bytes, " << heapPerSession
+         << " bytes of heap and " << rssPerSession << " bytes RSS per session (created in " << created << "s)" << endl;
+    cout << "  " << switched * 1e9 / max(1L, commands) << " ns per switch into a session and back" << endl;
+    cout << "  every session played its own game: " << (playing ? "yes" : "NO") << endl;
+    delete scheduler;
+
+    cout << "Threads: " << threads << " sessions, one thread each" << endl;
+    heapBefore = MemoryTracker::totalLiveBytes();
+    rssBefore  = residentKilobytes();
+    start = chrono::steady_clock::now();
+
+    vector<ThreadSession *> threadSessions;
+    for (int i = 0; i < threads; i++) {
+        ThreadSession *session = new ThreadSession();
+        session->worker = thread(&ThreadSession::run, session);
+        unique_lock<mutex> guard(session->lock);
+        session->changed.wait(guard, [session] { return session->started; });
+        threadSessions.push_back(session);
+    }
+    created = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    heapPerSession = (MemoryTracker::totalLiveBytes() - heapBefore) / max(1, threads);
+    rssPerSession  = (residentKilobytes() - rssBefore) * 1024 / max(1, threads);
+
+    start = chrono::steady_clock::now();
+    for (long i = 0; i < commands; i++) {
+        threadSessions[i % threads]->play(noCommand);
+    }
+    double handedOff = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "  " << heapPerSession << " bytes of heap and " << rssPerSession << " bytes RSS per session, plus "
+         << "a reserved stack each (created in " << created << "s)" << endl;
+    cout << "  " << handedOff * 1e9 / max(1L, commands) << " ns per switch into a session and back" << endl;
+
+    for (auto session : threadSessions) {
+        {
+            lock_guard<mutex> guard(session->lock);
+            session->stopping = true;
+            session->changed.notify_all();
+        }
+        session->worker.join();
+        delete session;
+    }
+    return playing;
+}
+
+#else
+
+bool runCoroutineBenchmark(int, int, long)
+{
+    cerr << "This build has no coroutine sessions; compile with -std=c++20." << endl;
+    return false;
+}
+
+#endif
+
+//shardedworld.cpp
+namespace {
+
+// Lets threads wait for each other between the phases of a tick, doing whileWaiting in the
+// meantime (regions keep taking deliveries, so nobody waiting on a full queue gets stuck).
+class SpinBarrier
+{
+public:
+    SpinBarrier(int threads) : threads(threads), waiting(0), generation(0) {}
+
+    template <typename Work>
+    void wait(Work whileWaiting)
+    {
+        unsigned int current = generation.load();
+        if (waiting.fetch_add(1) + 1 == threads) {
+            waiting = 0;
+            generation++;
+            return;
+        }
+        while (generation.load() == current) {
+            whileWaiting();
+            this_thread::yield();
+        }
+    }
+
+private:
+    int                   threads;
+    atomic<int>           waiting;
+    atomic<unsigned int>  generation;
+};
+
+} // namespace
+
+void ShardedWorld::Region::add(const Traveller &traveller)
+{
+    entity.push_back(traveller.entity);
+    position.push_back(traveller.room);
+    stamina.push_back(traveller.stamina);
+    flags.push_back(traveller.flags);
+}
+
+ShardedWorld::ShardedWorld(const GeneratedWorld &world, int regions, uint32_t seed) :
+    world(world), seed(seed)
+{
+    numberOfRegions = max(1, min(regions, MAX_REGIONS));
+    roomsPerRegion  = (world.numberOfRooms + numberOfRegions - 1) / numberOfRegions;
+    this->regions.resize(numberOfRegions);
+    for (auto &region : this->regions) {
+        region.arrivals.resize(numberOfRegions);
+    }
+    for (int i = 0; i < numberOfRegions * numberOfRegions; i++) {
+        queues.push_back(new Queue());
+    }
+}
+
+ShardedWorld::~ShardedWorld()
+{
+    for (auto queue : queues) {
+        delete queue;
+    }
+}
+
+int ShardedWorld::regionOf(int32_t room) const
+{
+    return room / roomsPerRegion;
+}
+
+void ShardedWorld::addEnemies(const EntityStore &store)
+{
+    for (size_t i = 0; i < store.size(); i++) {
+        if ((store.flags[i] & (EntityStore::ENEMY | EntityStore::DEAD)) == EntityStore::ENEMY) {
+            regions[regionOf(store.position[i])].add({(Entity) i, store.position[i], store.stamina[i], store.flags[i]});
+        }
+    }
+}
+
+void ShardedWorld::addPlayer(Entity entity, int32_t room)
+{
+    regions[regionOf(room)].add({entity, room, 0, EntityStore::PLAYER});
+}
+
+int32_t ShardedWorld::playerTo(const GeneratedWorld &world, int32_t room, uint32_t seed, Entity entity, uint32_t tick)
+{
+    uint32_t x = randomAt(seed ^ (0x27d4eb2fu * (entity + 1)), tick);
+    int32_t next;
+    if ((x & 63) == 0) {
+        next = randomAt(x, tick) % world.numberOfRooms;
+    } else {
+        next = world.exits[(size_t) room * 4 + ((x >> 6) & 3)];
+    }
+    return next < 0 || (world.flags[next] & GeneratedWorld::LOCKED) ? room : next;
+}
+
+void ShardedWorld::simulate(int from, uint32_t tick, int staminaCost)
+{
+    Region &region = regions[from];
+    const int32_t *exits = world.exits.data();
+
+    // Entities that stay are packed towards the front as the ones that leave are sent off.
+    size_t kept = 0;
+    for (size_t i = 0; i < region.entity.size(); i++) {
+        Entity  entity  = region.entity[i];
+        int32_t room    = region.position[i];
+        int32_t stamina = region.stamina[i];
+        uint8_t flags   = region.flags[i];
+
+        if (flags & EntityStore::PLAYER) {
+            room = playerTo(world, room, seed, entity, tick);
+        } else if (!(flags & EntityStore::DEAD)) {
+            room = EntityStore::wanderTo(exits, room, seed, entity, tick);
+            stamina -= staminaCost;
+            if (stamina <= 0) {
+                stamina = 0;
+                flags  |= EntityStore::DEAD;
+            }
+        }
+
+        int to = regionOf(room);
+        if (to == from) {
+            region.entity[kept]   = entity;
+            region.position[kept] = room;
+            region.stamina[kept]  = stamina;
+            region.flags[kept]    = flags;
+            kept++;
+            continue;
+        }
+        region.crossings++;
+        Queue &queue = *queues[from * numberOfRegions + to];
+        while (!queue.push({entity, room, stamina, flags})) {
+            // Full: take our own deliveries while the other region catches up, in case it's
+            // waiting for room in a queue to us.
+            receive(from);
+            this_thread::yield();
+        }
+    }
+    region.entity.resize(kept);
+    region.position.resize(kept);
+    region.stamina.resize(kept);
+    region.flags.resize(kept);
+}
+
+void ShardedWorld::receive(int to)
+{
+    Region &region = regions[to];
+    Traveller traveller;
+    for (int from = 0; from < numberOfRegions; from++) {
+        Queue &queue = *queues[from * numberOfRegions + to];
+        while (queue.pop(traveller)) {
+            region.arrivals[from].push_back(traveller);
+        }
+    }
+}
+
+void ShardedWorld::merge(int to)
+{
+    // Each queue delivers in the order its region sent, and regions are taken in order, so
+    // however the threads were scheduled the arrivals always end up in the same order.
+    Region &region = regions[to];
+    for (auto &arrivals : region.arrivals) {
+        for (auto &traveller : arrivals) {
+            region.add(traveller);
+        }
+        arrivals.clear();
+    }
+}
+
+void ShardedWorld::run(uint32_t tick, int ticks, int staminaCost)
+{
+    SpinBarrier sent(numberOfRegions), merged(numberOfRegions);
+    vector<thread> workers;
+    for (int i = 0; i < numberOfRegions; i++) {
+        workers.emplace_back([&, i] {
+            for (int t = 0; t < ticks; t++) {
+                simulate(i, tick + t, staminaCost);
+                sent.wait([&] { receive(i); });
+                // Everyone has sent everything for this tick, so this gets the rest.
+                receive(i);
+                merge(i);
+                // Nobody may send the next tick's moves before everyone has merged this one's.
+                merged.wait([] {});
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void ShardedWorld::collect(vector<int32_t> &position, vector<int32_t> &stamina) const
+{
+    for (auto &region : regions) {
+        for (size_t i = 0; i < region.entity.size(); i++) {
+            Entity entity = region.entity[i];
+            if (entity >= position.size()) {
+                position.resize(entity + 1, -1);
+                stamina.resize(entity + 1, 0);
+            }
+            position[entity] = region.position[i];
+            stamina[entity]  = region.stamina[i];
+        }
+    }
+}
+
+long ShardedWorld::crossings() const
+{
+    long total = 0;
+    for (auto &region : regions) {
+        total += region.crossings;
+    }
+    return total;
+}
+
+bool runShardedSimulation(const GeneratorSettings &settings, int maxRegions, int ticks, long players)
+{
+    // Enemies pay one stamina a move here, so most live through a run of 100 ticks.
+    const int STAMINA_COST = 1;
+
+    GeneratedWorld world = generateWorld(settings);
+    EntityStore store;
+    world.populate(store);
+    Entity firstPlayer = store.size();
+    long enemies = 0;
+    for (size_t i = 0; i < store.size(); i++) {
+        enemies += store.has(i, EntityStore::ENEMY);
+    }
+    cout << world.numberOfRooms << " rooms, " << enemies << " enemies, " << players << " players, "
+         << ticks << " ticks" << endl;
+
+    // The reference: the enemies moved by EntityStore::wander on one thread.
+    EntityStore reference = store;
+    for (int tick = 0; tick < ticks; tick++) {
+        reference.wander(world.exits, settings.seed, tick, STAMINA_COST);
+    }
+
+    bool ok = true;
+    vector<int32_t> firstPosition, firstStamina;
+    for (int regions = 1; regions <= min(maxRegions, (int) ShardedWorld::MAX_REGIONS); regions *= 2) {
+        ShardedWorld sharded(world, regions, settings.seed);
+        sharded.addEnemies(store);
+        for (long i = 0; i < players; i++) {
+            sharded.addPlayer(firstPlayer + i, randomAt(settings.seed, i) % world.numberOfRooms);
+        }
+
+        auto start = chrono::steady_clock::now();
+        sharded.run(0, ticks, STAMINA_COST);
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        vector<int32_t> position(firstPlayer + players, -1), stamina(firstPlayer + players, 0);
+        sharded.collect(position, stamina);
+        bool same = true;
+        if (regions == 1) {
+            firstPosition = position;
+            firstStamina  = stamina;
+            for (size_t i = 0; i < firstPlayer; i++) {
+                if (store.has(i, EntityStore::ENEMY)
+                    && (position[i] != reference.position[i] || stamina[i] != reference.stamina[i])) {
+                    same = false;
+                }
+            }
+        } else {
+            same = position == firstPosition && stamina == firstStamina;
+        }
+        ok = ok && same;
+
+        cout << regions << " region(s): " << elapsed << "s, "
+             << (long) ((enemies + players) * (double) ticks / max(elapsed, 1e-9)) << " moves/s, "
+             << sharded.crossings() << " moves between regions, "
+             << (same ? (regions == 1 ? "same as EntityStore::wander" : "same as 1 region") : "DIFFERENT") << endl;
+    }
+    return ok;
+}
+
+//sharedworld.cpp
+SharedWorld::SharedWorld(const RuleSet *rules) :
+    rules(rules)
+{
+    buildDefaultRooms(rooms);
+
+    for (auto &definition : defaultItems) {
+        if (definition.multiplier > 0) {
+            items.push_back(new Weapon(definition.name, definition.weight, definition.multiplier));
+        } else {
+            items.push_back(new Item(definition.name, definition.weight));
+        }
+        rooms[definition.room]->addItem(items.back());
+    }
+    for (auto &definition : defaultEnemies) {
+        rooms[definition.room]->addEnemy(new Enemy(definition.name, definition.description));
+    }
+}
+
+SharedWorld::~SharedWorld()
+{
+    for (auto player : players) {
+        delete player;
+    }
+    for (auto item : items) {
+        delete item;
+    }
+    for (auto room : rooms) {
+        for (auto enemy : room->enemiesInRoom) {
+            delete enemy;
+        }
+        delete room;
+    }
+}
+
+int SharedWorld::join(string name)
+{
+    Player *player = new Player(name);
+    player->setCurrentRoom(rooms[0]);
+
+    {
+        lock_guard<mutex> guard(rooms[0]->lock);
+        rooms[0]->playersInRoom.push_back(player);
+    }
+
+    lock_guard<mutex> guard(playersLock);
+    players.push_back(player);
+    rolls.push_back(0);
+    return players.size() - 1;
+}
+
+int SharedWorld::numberOfPlayers()
+{
+    lock_guard<mutex> guard(playersLock);
+    return players.size();
+}
+
+bool SharedWorld::execute(int playerId, string line, string &reply)
+{
+    Player   *player;
+    uint32_t *playerRolls;  // only this player's thread uses it; deque elements never move
+    {
+        lock_guard<mutex> guard(playersLock);
+        player      = players.at(playerId);
+        playerRolls = &rolls.at(playerId);
+    }
+
+    string command = line.substr(0, line.find(' '));
+    string argument = line.find(' ') == string::npos ? "" : line.substr(line.find(' ') + 1);
+
+    if (player->getHealth() <= 0 || player->getStamina() <= 0) {
+        respawn(player, reply);
+        return false;
+    }
+
+    if (command == "go") {
+        go(player, argument, reply);
+    } else if (command == "take") {
+        take(player, argument, reply);
+    } else if (command == "drop") {
+        drop(player, argument, reply);
+    } else if (command == "attack") {
+        attack(player, randomAt(playerId + 1, ++*playerRolls), argument, reply);
+    } else if (command == "look") {
+        look(player, reply);
+    } else if (command == "inventory") {
+        reply += player->getItems();
+    } else {
+        reply += "Unknown command.\n";
+    }
+    return true;
+}
+
+void SharedWorld::respawn(Player *player, string &reply)
+{
+    Room *fell = player->getCurrentRoom();
+    {
+        lock_guard<mutex> guard(fell->lock);
+        fell->itemsInRoom.insert(fell->itemsInRoom.end(), player->itemInventory.begin(), player->itemInventory.end());
+        auto &here = fell->playersInRoom;
+        here.erase(std::remove(here.begin(), here.end(), player), here.end());
+    }
+    player->itemInventory.clear();
+    {
+        lock_guard<mutex> guard(rooms[0]->lock);
+        rooms[0]->playersInRoom.push_back(player);
+    }
+    player->setCurrentRoom(rooms[0]);
+    player->setHealth(100);
+    player->setStamina(100);
+    reply += "You were too weak to go on, and wake up back in " + rooms[0]->getName() + ".\n";
+}
+
+void SharedWorld::go(Player *player, string direction, string &reply)
+{
+    Room *current = player->getCurrentRoom();
+    Room *next = current->getExit(direction);
+
+    if (next == nullptr) {
+        reply += "You hit a wall\n";
+        return;
+    }
+    if ((defaultRooms[next->index].needs & ~keysOf(player)) != 0) {
+        reply += "You need a key to enter this room.\n";
+        return;
+    }
+
+    // Only one room lock is held at a time, so moving can never deadlock.
+    {
+        lock_guard<mutex> guard(current->lock);
+        auto &here = current->playersInRoom;
+        here.erase(std::remove(here.begin(), here.end(), player), here.end());
+    }
+    {
+        lock_guard<mutex> guard(next->lock);
+        next->playersInRoom.push_back(player);
+    }
+    player->setCurrentRoom(next);
+    double carried = 0;
+    for (auto item : player->itemInventory) {
+        carried += item->getWeight();
+    }
+    player->setStamina(player->getStamina() - moveStaminaCost(player->itemInventory.size(), carried));
+
+    reply += "You are in " + next->getName() + "\n";
+    runRules(RuleSet::ENTER, next->getSymbol(), player, reply);
+}
+
+KeySet SharedWorld::keysOf(Player *player)
+{
+    // items[i] was built from defaultItems[i].
+    KeySet keys = 0;
+    for (auto item : player->itemInventory) {
+        keys |= defaultItems[std::find(items.begin(), items.end(), item) - items.begin()].opens;
+    }
+    return keys;
+}
+
+void SharedWorld::take(Player *player, string itemName, string &reply)
+{
+    Room *room = player->getCurrentRoom();
+    Item *taken = nullptr;
+    Symbol wanted = SymbolTable::find(itemName);
+
+    {
+        lock_guard<mutex> guard(room->lock);
+        for (auto it = room->itemsInRoom.begin(); it != room->itemsInRoom.end(); it++) {
+            if ((*it)->getSymbol() == wanted) {
+                taken = *it;
+                room->itemsInRoom.erase(it);
+                break;
+            }
+        }
+    }
+
+    // Whoever removed it from the room owns it; everyone else sees it gone.
+    if (taken == nullptr) {
+        reply += "There is no " + itemName + " here.\n";
+        return;
+    }
+
+    player->itemInventory.push_back(taken);
+    reply += "You have picked up " + itemName + ".\n";
+    runRules(RuleSet::TAKE, wanted, player, reply);
+}
+
+void SharedWorld::runRules(RuleSet::Trigger trigger, Symbol subject, Player *player, string &reply)
+{
+    // The player is only ever changed by their own thread, so the rules need no lock.
+    StringSink said;
+    ostream    out(&said);
+    rules->run(trigger, subject, *player, out);
+    reply += said.text;
+}
+
+void SharedWorld::drop(Player *player, string itemName, string &reply)
+{
+    auto &inventory = player->itemInventory;
+    Symbol wanted = SymbolTable::find(itemName);
+    for (auto it = inventory.begin(); it != inventory.end(); it++) {
+        if ((*it)->getSymbol() == wanted) {
+            Item *dropped = *it;
+            inventory.erase(it);
+
+            Room *room = player->getCurrentRoom();
+            lock_guard<mutex> guard(room->lock);
+            room->itemsInRoom.push_back(dropped);
+
+            reply += "You dropped " + itemName + ".\n";
+            return;
+        }
+    }
+    reply += "You don't have " + itemName + ".\n";
+}
+
+void SharedWorld::attack(Player *player, uint32_t roll, string name, string &reply)
+{
+    Room *room = player->getCurrentRoom();
+    Symbol target = SymbolTable::find(name);
+    int multiplier = 0;
+    for (auto item : player->itemInventory) {
+        multiplier = max(multiplier, item->getMultiplier());
+    }
+
+    bool found = false;
+    {
+        lock_guard<mutex> guard(room->lock);
+        for (auto it = room->enemiesInRoom.begin(); it != room->enemiesInRoom.end() && !found; it++) {
+            if ((*it)->getSymbol() != target) {
+                continue;
+            }
+            found = true;
+            // The same rule as Game::attack: a miss costs the player instead.
+            if (!attackHits(roll, multiplier)) {
+                --(*player);
+                if (player->getHealth() <= 0) player->setHealth(0);
+                reply += "You were injured by the enemy!\n";
+                break;
+            }
+            Enemy *enemy = *it;
+            enemy->setHealth(enemy->getHealth() - 20);
+            if (enemy->getHealth() <= 0) {
+                room->enemiesInRoom.erase(it);
+                delete enemy;
+                reply += "You killed the enemy!\n";
+            } else {
+                reply += "You injured the enemy!\n";
+            }
+            break;
+        }
+    }
+
+    if (!found) {
+        reply += "No enemies to attack\n";
+        return;
+    }
+    // Hit or miss, as in Game::attack.
+    runRules(RuleSet::ATTACK, target, player, reply);
+}
+
+void SharedWorld::look(Player *player, string &reply)
+{
+    Room *room = player->getCurrentRoom();
+    lock_guard<mutex> guard(room->lock);
+
+    reply += "You are in " + room->getName() + "\n";
+    reply += room->displayItems() + "\n";
+    reply += room->displayEnemies() + "\n";
+    reply += "Players in room = " + to_string(room->playersInRoom.size()) + "\n";
+}
+
+bool SharedWorld::itemsConsistent()
+{
+    vector<Item *> seen;
+    for (auto room : rooms) {
+        lock_guard<mutex> guard(room->lock);
+        seen.insert(seen.end(), room->itemsInRoom.begin(), room->itemsInRoom.end());
+    }
+    lock_guard<mutex> guard(playersLock);
+    for (auto player : players) {
+        seen.insert(seen.end(), player->itemInventory.begin(), player->itemInventory.end());
+    }
+
+    std::sort(seen.begin(), seen.end());
+    vector<Item *> expected = items;
+    std::sort(expected.begin(), expected.end());
+    return seen == expected;
+}
+
+bool runSharedWorld(int numberOfPlayers, int commandsPerPlayer, const string &rulesPath)
+{
+    string source = defaultRules;
+    if (!rulesPath.empty()) {
+        ifstream file(rulesPath);
+        if (!file) {
+            cerr << "Could not read " << rulesPath << endl;
+            return false;
+        }
+        source.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    RuleSet rules;
+    string  error;
+    if (!rules.compile(source, error)) {
+        cerr << (rulesPath.empty() ? "The built-in rules" : rulesPath) << ", " << error << endl;
+        return false;
+    }
+
+    bool allConsistent = true;
+    for (int players = 1; ; players = min(players * 2, numberOfPlayers)) {
+        SharedWorld world(&rules);
+        for (int i = 0; i < players; i++) {
+            world.join("player" + to_string(i));
+        }
+
+        // Each local client only knows its own id and picks commands at random.
+        atomic<long> acted(0);
+        auto client = [&world, &acted, commandsPerPlayer](int id) {
+            std::minstd_rand random(id + 1);
+            const string commands[] = {
+                "go north", "go east", "go south", "go west",
+                "take key", "take sword", "take potion", "take cursed_item",
+                "drop key", "drop sword", "drop potion", "drop cursed_item",
+                "attack stationary-man", "look"
+            };
+            string reply;
+            long   mine = 0;
+            for (int i = 0; i < commandsPerPlayer; i++) {
+                reply.clear();
+                mine += world.execute(id, commands[random() % 14], reply);
+            }
+            acted += mine;
+        };
+
+        auto start = chrono::steady_clock::now();
+        vector<thread> clients;
+        for (int i = 0; i < players; i++) {
+            clients.push_back(thread(client, i));
+        }
+        for (auto &c : clients) {
+            c.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        long total = (long) players * commandsPerPlayer;
+        bool consistent = world.itemsConsistent();
+        allConsistent = allConsistent && consistent;
+        cout << players << " players, " << total << " commands in " << seconds << "s ("
+             << (long) (total / seconds) << " commands/s), " << acted << " acted and "
+             << total - acted << " were spent respawning; items consistent: " << (consistent ? "yes" : "NO") << endl;
+
+        if (players >= numberOfPlayers) {
+            break;
+        }
+    }
+    return allConsistent;
+}
+
+//snapshot.cpp
+SnapshotPublisher::SnapshotPublisher() :
+    current(nullptr),
+    epoch(1)
+{
+    for (int i = 0; i < MAX_READERS; i++) {
+        readers[i].epoch = 0;
+        readers[i].taken = false;
+    }
+}
+
+SnapshotPublisher::~SnapshotPublisher()
+{
+    for (auto &entry : retired) {
+        delete entry.second;
+    }
+    delete current.load();
+}
+
+int SnapshotPublisher::addReader()
+{
+    for (int i = 0; i < MAX_READERS; i++) {
+        bool taken = false;
+        if (readers[i].taken.compare_exchange_strong(taken, true)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SnapshotPublisher::removeReader(int reader)
+{
+    readers[reader].epoch = 0;
+    readers[reader].taken = false;
+}
+
+const WorldSnapshot *SnapshotPublisher::acquire(int reader)
+{
+    // Announce the epoch first: the publisher won't free anything replaced in or after it.
+    readers[reader].epoch.store(epoch.load());
+    return current.load();
+}
+
+void SnapshotPublisher::release(int reader)
+{
+    readers[reader].epoch.store(0, memory_order_release);
+}
+
+const WorldSnapshot *SnapshotPublisher::latest()
+{
+    return current.load(memory_order_relaxed);
+}
+
+void SnapshotPublisher::publish(WorldSnapshot *snapshot)
+{
+    const WorldSnapshot *replaced = current.exchange(snapshot);
+    // Readers that announce the new epoch are sure to see the new snapshot.
+    unsigned long replacedIn = epoch.fetch_add(1) + 1;
+    if (replaced != nullptr) {
+        retired.push_back({replacedIn, replaced});
+    }
+    reclaim();
+}
+
+void SnapshotPublisher::reclaim()
+{
+    // The oldest epoch any reader is still looking in; everything replaced before it is unseen.
+    unsigned long oldest = ULONG_MAX;
+    for (int i = 0; i < MAX_READERS; i++) {
+        unsigned long looking = readers[i].epoch.load();
+        if (looking != 0) {
+            oldest = min(oldest, looking);
+        }
+    }
+
+    size_t kept = 0;
+    for (auto &entry : retired) {
+        if (entry.first <= oldest) {
+            delete entry.second;
+        } else {
+            retired[kept++] = entry;
+        }
+    }
+    retired.resize(kept);
+}
+
+long SnapshotPublisher::waitingToBeFreed()
+{
+    return retired.size();
+}
+
+namespace {
+
+// What every snapshot must satisfy: the built-in world's items are each in exactly one
+// place, and nobody's stats are negative.
+bool snapshotConsistent(const WorldSnapshot &snapshot)
+{
+    size_t items = snapshot.inventory->size();
+    for (size_t room = 0; room < snapshot.rooms.size(); room++) {
+        items += snapshot.rooms[room]->items.size();
+    }
+    return items == (size_t) NUMBER_OF_DEFAULT_ITEMS && snapshot.playerHealth >= 0
+        && snapshot.playerStamina >= 0 && snapshot.rooms.size() == (size_t) NUMBER_OF_DEFAULT_ROOMS;
+}
+
+} // namespace
+
+bool runSpectators(int readers, long commands)
+{
+    const char *script[] = {"go north", "go east", "go south", "go west", "take key", "take sword",
+                            "take potion", "take cursed_item", "attack mojo", "attack stationary-man",
+                            "teleport", "restart"};
+    const int SCRIPT_LENGTH = sizeof(script) / sizeof(script[0]);
+
+    SnapshotPublisher publisher;
+    Session session;
+    session.getGame().setSpectators(&publisher);
+    session.execute("");  // publishes the starting state
+
+    atomic<bool> playing(true);
+    atomic<long> reads(0), inconsistent(0), maxLag(0);
+    vector<thread> spectators;
+    for (int i = 0; i < readers; i++) {
+        spectators.emplace_back([&] {
+            int reader = publisher.addReader();
+            long seen = 0, lastTick = 0;
+            while (playing) {
+                const WorldSnapshot *snapshot = publisher.acquire(reader);
+                if (!snapshotConsistent(*snapshot)) {
+                    inconsistent++;
+                }
+                lastTick = max(lastTick, snapshot->tick);
+                publisher.release(reader);
+                seen++;
+                // A dashboard doesn't need every tick; let the game (and other readers) run.
+                this_thread::yield();
+            }
+            long lag = commands + 1 - lastTick;
+            long previous = maxLag.load();
+            while (lag > previous && !maxLag.compare_exchange_weak(previous, lag)) {
+            }
+            reads += seen;
+            publisher.removeReader(reader);
+        });
+    }
+
+    long reused = 0, rebuilt = 0;
+    PersistentArray<shared_ptr<const RoomSnapshot>> before;
+    mt19937 random(1);
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < commands; i++) {
+        // Restarting is rare in real play, so only one command in a thousand is a restart.
+        int pick = random() % (SCRIPT_LENGTH - 1);
+        if (random() % 1000 == 0) {
+            pick = SCRIPT_LENGTH - 1;
+        }
+
+        before = publisher.latest()->rooms;
+        session.execute(script[pick]);
+        long changed = 0;
+        publisher.latest()->rooms.forEachDifference(before, [&](size_t, const shared_ptr<const RoomSnapshot> &) {
+            changed++;
+        });
+        rebuilt += changed;
+        reused  += before.size() - changed;
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    playing = false;
+    for (auto &spectator : spectators) {
+        spectator.join();
+    }
+    before = PersistentArray<shared_ptr<const RoomSnapshot>>();
+
+    cout << commands << " ticks with " << readers << " spectator(s) in " << elapsed << "s ("
+         << elapsed * 1e9 / max(1L, commands) << " ns per tick, including the command)" << endl;
+    cout << "Rooms shared with the previous snapshot: " << reused << ", rebuilt: " << rebuilt << endl;
+    cout << "Snapshots read: " << reads << ", inconsistent: " << inconsistent
+         << ", furthest a spectator ended behind: " << maxLag << " tick(s)" << endl;
+    cout << "Snapshots waiting to be freed at the end: " << publisher.waitingToBeFreed() << endl;
+    session.getGame().setSpectators(nullptr);
+    return inconsistent == 0;
+}
+
+//soakdriver.cpp
+namespace {
+
+struct WeightedCommand
+{
+    int         weight;
+    const char *line;
+};
+
+// Roughly how a wandering, fighting, hoarding player behaves, plus some nonsense.
+const WeightedCommand soakCommands[] = {
+    {10, "go north"}, {10, "go east"}, {10, "go south"}, {10, "go west"}, {2, "go up"},
+    {4, "take key"}, {4, "take sword"}, {4, "take potion"}, {4, "take cursed_item"}, {1, "take nothing"},
+    {6, "attack mojo"}, {6, "attack stationary-man"}, {1, "attack"},
+    {4, "teleport"}, {3, "use potion"}, {3, "inventory"}, {2, "map"}, {1, "info"},
+    {2, "restart"}, {1, ""}, {1, "xyzzy"}, {2, "undo"}, {1, "redo"}, {1, "branch 3"}
+};
+
+} // namespace
+
+long residentKilobytes()
+{
+    long pages = 0, resident = 0;
+    ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// VmHWM, from procfs like residentKilobytes, so the two are counted the same way. Read
+// after the current figure, and never reported below it.
+long peakResidentKilobytes()
+{
+    long resident = residentKilobytes(), peak = 0;
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            peak = atol(line.c_str() + 6);
+            break;
+        }
+    }
+    return max(peak, resident);
+}
+
+bool runSoak(const SoakSettings &settings)
+{
+    // Each session writes into its own buffer, which is scanned after every command
+    // for things a player should never see.
+    vector<ostringstream *> outputs;
+    vector<Session *> sessions;
+    for (int i = 0; i < settings.sessions; i++) {
+        outputs.push_back(new ostringstream());
+        sessions.push_back(new Session(outputs.back()));
+        sessions.back()->getGame().setSeed(settings.seed + i);
+    }
+
+    int totalWeight = 0;
+    for (auto &command : soakCommands) {
+        totalWeight += command.weight;
+    }
+
+    std::mt19937 random(settings.seed);
+    vector<string> history; // the last few commands, to show what led to a failure
+    string problem;
+    bool ok = true;
+
+    auto start = chrono::steady_clock::now();
+    auto lastReport = start;
+    long commands = 0, commandsAtLastReport = 0;
+
+    cout << "Soaking " << settings.sessions << " session(s) for " << settings.seconds << "s, seed " << settings.seed << endl;
+
+    while (ok) {
+        for (int i = 0; i < settings.sessions && ok; i++) {
+            int pick = random() % totalWeight;
+            const WeightedCommand *command = soakCommands;
+            while (pick >= command->weight) {
+                pick -= command->weight;
+                command++;
+            }
+            // A finished game only listens to restart, so don't waste the run.
+            string line = sessions[i]->getGame().is_over() && random() % 2 ? "restart" : command->line;
+
+            history.push_back(to_string(i) + ": " + line);
+            if (history.size() > 20) {
+                history.erase(history.begin());
+            }
+
+            outputs[i]->str("");
+            sessions[i]->execute(line);
+            commands++;
+
+            string shown = outputs[i]->str();
+            if (shown.find("HP: -") != string::npos || shown.find("ST: -") != string::npos) {
+                problem = "negative HP or ST shown";
+                ok = false;
+            } else if (!sessions[i]->getGame().checkInvariants(problem)) {
+                ok = false;
+            }
+        }
+
+        auto now = chrono::steady_clock::now();
+        double elapsed = chrono::duration<double>(now - start).count();
+        double sinceReport = chrono::duration<double>(now - lastReport).count();
+        if (sinceReport >= settings.reportEvery || elapsed >= settings.seconds || !ok) {
+            cout << "[" << (long) elapsed << "s] " << commands << " commands, "
+                 << (long) ((commands - commandsAtLastReport) / max(sinceReport, 1e-9)) << " commands/s, "
+                 << "RSS " << residentKilobytes() << " KB (peak " << peakResidentKilobytes() << " KB), "
+                 << MemoryTracker::totalAllocations() << " allocations, "
+                 << MemoryTracker::totalLiveBytes() << " bytes live" << endl;
+            lastReport = now;
+            commandsAtLastReport = commands;
+        }
+        if (elapsed >= settings.seconds) {
+            break;
+        }
+    }
+
+    if (!ok) {
+        cout << "Invariant broken: " << problem << endl;
+        cout << "Last commands (session: command), rerun with seed " << settings.seed << " to reproduce:" << endl;
+        for (auto &line : history) {
+            cout << "  " << line << endl;
+        }
+    }
+
+    for (int i = 0; i < settings.sessions; i++) {
+        delete sessions[i];
+        delete outputs[i];
+    }
+    return ok;
+}
+
+bool runAllocationCheck(long warmup, long measured, unsigned int seed, int seeds)
+{
+    const int COMMANDS = sizeof(soakCommands) / sizeof(soakCommands[0]);
+    int totalWeight = 0, restart = 0;
+    // Made up front, so building a line to execute isn't counted against the command.
+    string lines[COMMANDS];
+    for (int i = 0; i < COMMANDS; i++) {
+        totalWeight += soakCommands[i].weight;
+        lines[i] = soakCommands[i].line;
+        restart = lines[i] == "restart" ? i : restart;
+    }
+
+    long runs[COMMANDS] = {}, allocations[COMMANDS] = {}, worst[COMMANDS] = {};
+    vector<unsigned int> failedSeeds;
+    for (int run = 0; run < seeds; run++) {
+        StringSink sink;
+        ostream output(&sink);
+        Session session(&output);
+        session.getGame().setSeed(seed + run);
+
+        long allocatedInRun = 0;
+        std::mt19937 random(seed + run);
+        for (long i = 0; i < warmup + measured; i++) {
+            int pick = random() % totalWeight, command = 0;
+            while (pick >= soakCommands[command].weight) {
+                pick -= soakCommands[command].weight;
+                command++;
+            }
+            if (session.getGame().is_over() && random() % 2) {
+                command = restart;
+            }
+
+            long before = MemoryTracker::totalAllocations();
+            session.execute(lines[command]);
+            long made = MemoryTracker::totalAllocations() - before;
+            sink.text.clear();
+
+            if (i >= warmup) {
+                runs[command]++;
+                allocations[command] += made;
+                worst[command] = max(worst[command], made);
+                allocatedInRun += made;
+            }
+        }
+        if (allocatedInRun > 0) {
+            failedSeeds.push_back(seed + run);
+        }
+    }
+
+    bool ok = true;
+    cout << "Heap allocations per command after " << warmup << " warm-up commands, seeds " << seed
+         << " to " << seed + seeds - 1 << ":" << endl;
+    cout << "  command                 runs   allocations   most in one" << endl;
+    for (int i = 0; i < COMMANDS; i++) {
+        char text[128];
+        snprintf(text, sizeof(text), "  %-20s %7ld %13ld %13ld%s", soakCommands[i].line[0] ? soakCommands[i].line : "(empty)",
+                 runs[i], allocations[i], worst[i], allocations[i] > 0 ? "  FAIL" : "");
+        cout << text << endl;
+        ok = ok && allocations[i] == 0;
+    }
+    if (!ok) {
+        cout << "Seeds that allocated:";
+        for (auto failed : failedSeeds) {
+            cout << ' ' << failed;
+        }
+        cout << endl;
+    }
+    cout << (ok ? "PASS" : "FAIL") << ": " << measured << " commands measured for each of " << seeds << " seed(s)" << endl;
+    return ok;
+}
+
+bool runTimelineCheck(long commands, unsigned int seed)
+{
+    int totalWeight = 0;
+    for (auto &command : soakCommands) {
+        totalWeight += command.weight;
+    }
+
+    Session session;
+    Game &game = session.getGame();
+    game.setSeed(seed);
+    game.setHistoryLimit(commands + 2);  // keep them all, so any of them can be checked
+    // Versions are carved out of pool chunks; only the blocks they hold count, not how far
+    // the chunks have grown.
+    long historyBefore = MemoryTracker::liveBytes(TAG_HISTORY) + poolBytesInUse();
+
+    // What saveState gave when each version was made.
+    std::map<long, string> states;
+    states[game.currentVersion()] = game.saveState();
+
+    const char *kinds[3] = {"undo", "redo", "branch"};
+    long   moves[3] = {}, mismatches = 0, newest = game.currentVersion();
+    double seconds[3] = {};
+    std::mt19937 random(seed);
+    for (long i = 0; i < commands; i++) {
+        int pick = random() % 100, kind = pick < 10 ? 0 : pick < 16 ? 1 : pick < 20 ? 2 : -1;
+        string line;
+        if (kind == 2) {
+            line = "branch " + to_string(random() % (newest + 1));
+        } else if (kind >= 0) {
+            line = kinds[kind];
+        } else {
+            int weight = random() % totalWeight, command = 0;
+            while (weight >= soakCommands[command].weight) {
+                weight -= soakCommands[command].weight;
+                command++;
+            }
+            line = soakCommands[command].line;
+        }
+
+        auto start = chrono::steady_clock::now();
+        session.execute(line);
+        if (kind >= 0) {
+            seconds[kind] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            moves[kind]++;
+        }
+
+        long version = game.currentVersion();
+        newest = max(newest, version);
+        string state = game.saveState();
+        auto seen = states.find(version);
+        if (seen == states.end()) {
+            states[version] = state;
+        } else if (seen->second != state) {
+            if (mismatches++ == 0) {
+                cout << "Version " << version << " came back different after \"" << line << "\" (command "
+                     << i + 1 << ", seed " << seed << "). It was:\n" << seen->second << "and is now:\n" << state;
+            }
+        }
+    }
+
+    long history = MemoryTracker::liveBytes(TAG_HISTORY) + poolBytesInUse() - historyBefore;
+    cout << commands << " commands made " << newest << " versions, " << history / max(1L, newest)
+         << " bytes each on average" << endl;
+    for (int i = 0; i < 3; i++) {
+        char text[128];
+        snprintf(text, sizeof(text), "  %-6s %8ld times, %8.0f ns each", kinds[i], moves[i],
+                 seconds[i] * 1e9 / max(1L, moves[i]));
+        cout << text << endl;
+    }
+    cout << (mismatches == 0 ? "PASS" : "FAIL") << ": " << mismatches << " version(s) restored differently" << endl;
+    return mismatches == 0;
+}
+
+//statusrenderer.cpp
+StatusRenderer::StatusRenderer()
+{
+    started  = false;
+    ansi     = false;
+    rows     = 24;
+    terminal = nullptr;
+    invalidate();
+}
+
+StatusRenderer::~StatusRenderer()
+{
+    if (ansi) {
+        // Give the whole screen back and leave the cursor on the last line.
+        *terminal << "\x1b[r\x1b[" << rows << ";1H" << std::flush;
+    }
+}
+
+void StatusRenderer::invalidate()
+{
+    for (int i = 0; i < NUMBER_OF_LINES; i++) {
+        shown[i].clear();
+        changed[i] = true;
+    }
+}
+
+void StatusRenderer::setLine(Line line, const string &text)
+{
+    if (shown[line] != text) {
+        shown[line]   = text;
+        changed[line] = true;
+    }
+}
+
+void StatusRenderer::startTerminal(ostream &out)
+{
+    started = true;
+
+    // Only draw in place on a real terminal; pipes (bots, logs) get plain lines.
+    const char *term = getenv("TERM");
+    ansi = &out == &cout && isatty(STDOUT_FILENO) && term != nullptr && string(term) != "dumb";
+    if (!ansi) {
+        return;
+    }
+
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > NUMBER_OF_LINES + 2) {
+        rows = size.ws_row;
+    }
+    terminal = &out;
+
+    // Status lines live in rows 1-5, row 6 is a divider, everything else scrolls beneath.
+    out << "\x1b[2J\x1b[" << NUMBER_OF_LINES + 1 << ";1H" << string(40, '-')
+        << "\x1b[" << NUMBER_OF_LINES + 2 << ";" << rows << "r"
+        << "\x1b[" << rows << ";1H";
+}
+
+void StatusRenderer::flush(ostream &out)
+{
+    if (!started) {
+        startTerminal(out);
+    }
+
+    bool anything = false;
+    for (int i = 0; i < NUMBER_OF_LINES; i++) {
+        if (!changed[i]) {
+            continue;
+        }
+        if (ansi) {
+            // Save the cursor, overwrite just this row, and jump back.
+            out << "\x1b" "7\x1b[" << i + 1 << ";1H\x1b[2K" << shown[i] << "\x1b" "8";
+        } else {
+            if (!anything) {
+                out << endl;
+            }
+            out << shown[i] << endl;
+        }
+        changed[i] = false;
+        anything   = true;
+    }
+    if (anything && ansi) {
+        out << std::flush;
+    }
+}
+
+//symboltable.cpp
+namespace {
+
+struct SymbolEntry
+{
+    string   name;
+    uint64_t hash;
+    Symbol   symbol;
+};
+
+// An open-addressing hash table that only ever grows. Readers never lock: entries are
+// published with a release store once they're complete, and a full table is replaced by
+// a bigger copy rather than resized in place (the old one stays valid for anyone still in it).
+struct SymbolSlots
+{
+    size_t                              mask;  // capacity - 1
+    unique_ptr<atomic<SymbolEntry *>[]> slots;
+
+    SymbolSlots(size_t capacity) : mask(capacity - 1), slots(new atomic<SymbolEntry *>[capacity])
+    {
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i] = nullptr;
+        }
+    }
+};
+
+struct Symbols
+{
+    mutex                           writing;  // one writer at a time; readers don't take it
+    atomic<SymbolSlots *>           current;
+    vector<unique_ptr<SymbolSlots>> tables;   // every table ever used, kept for late readers
+    vector<unique_ptr<SymbolEntry>> entries;  // indexed by Symbol
+
+    Symbols()
+    {
+        MemoryScope scope(TAG_STRINGS);
+        tables.emplace_back(new SymbolSlots(256));
+        current = tables.back().get();
+        entries.emplace_back(new SymbolEntry{"", 0, SymbolTable::NO_SYMBOL});
+    }
+};
+
+Symbols &symbols()
+{
+    static Symbols table;
+    return table;
+}
+
+uint64_t symbolHash(string_view name)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : name) {
+        hash = (hash ^ (unsigned char) c) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+SymbolEntry *findIn(const SymbolSlots &table, string_view name, uint64_t hash)
+{
+    for (size_t i = hash & table.mask; ; i = (i + 1) & table.mask) {
+        SymbolEntry *entry = table.slots[i].load(memory_order_acquire);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        if (entry->hash == hash && entry->name == name) {
+            return entry;
+        }
+    }
+}
+
+void insertInto(SymbolSlots &table, SymbolEntry *entry)
+{
+    size_t i = entry->hash & table.mask;
+    while (table.slots[i].load(memory_order_relaxed) != nullptr) {
+        i = (i + 1) & table.mask;
+    }
+    table.slots[i].store(entry, memory_order_release);
+}
+
+} // namespace
+
+Symbol SymbolTable::intern(string_view name)
+{
+    Symbol symbol = find(name);
+    if (symbol != NO_SYMBOL || name.empty()) {
+        return symbol;
+    }
+
+    Symbols &table = symbols();
+    MemoryScope scope(TAG_STRINGS);
+    lock_guard<mutex> guard(table.writing);
+    uint64_t hash = symbolHash(name);
+    SymbolSlots *slots = table.current.load();
+    if (SymbolEntry *entry = findIn(*slots, name, hash)) {
+        return entry->symbol;  // another thread added it first
+    }
+
+    // Kept at most half full, so probes stay short and always reach an empty slot.
+    if ((table.entries.size() + 1) * 2 > slots->mask + 1) {
+        table.tables.emplace_back(new SymbolSlots((slots->mask + 1) * 2));
+        SymbolSlots *bigger = table.tables.back().get();
+        for (size_t i = 1; i < table.entries.size(); i++) {
+            insertInto(*bigger, table.entries[i].get());
+        }
+        table.current.store(bigger, memory_order_release);
+        slots = bigger;
+    }
+
+    table.entries.emplace_back(new SymbolEntry{string(name), hash, (Symbol) table.entries.size()});
+    insertInto(*slots, table.entries.back().get());
+    return table.entries.back()->symbol;
+}
+
+Symbol SymbolTable::find(string_view name)
+{
+    SymbolEntry *entry = findIn(*symbols().current.load(memory_order_acquire), name, symbolHash(name));
+    return entry == nullptr ? NO_SYMBOL : entry->symbol;
+}
+
+const string &SymbolTable::name(Symbol symbol)
+{
+    Symbols &table = symbols();
+    lock_guard<mutex> guard(table.writing);
+    return table.entries.at(symbol)->name;
+}
+
+size_t SymbolTable::size()
+{
+    Symbols &table = symbols();
+    lock_guard<mutex> guard(table.writing);
+    return table.entries.size();
+}
+
+//takelistener.cpp
+TakeListener::TakeListener(Game *game)
+{
+    this->game = game;
+    itemName = "";
+}
+
+void TakeListener::run(void *args_ptr)
+{
+    if (game->is_over()) {
+        return;
+    }
+
+    vector<string> *args = (vector<string> *) args_ptr;
+
+    if (args->size() > 1) {
+        game->take(args->at(1));
+    } else {
+        console() << "Need to choose an item to take!" << endl;
+    }
+}
+
+//teleportlistener.cpp
+TeleportListener::TeleportListener(Game *game)
+{
+    this->game = game;
+}
+
+void TeleportListener::run(void *)
+{
+    if (game->is_over()) {
+        return;
+    }
+
+    this->game->teleport();
+}
+
+//timeline.cpp
+bool GameStatus::operator==(const GameStatus &other) const
+{
+    return playerRoom == other.playerRoom && playerHealth == other.playerHealth
+        && playerStamina == other.playerStamina && mojoRoom == other.mojoRoom
+        && mojoHealth == other.mojoHealth && mojoStamina == other.mojoStamina
+        && over == other.over && rngCounter == other.rngCounter;
+}
+
+Timeline::Timeline()
+{
+    count         = 0;
+    firstNumber   = 0;
+    currentNumber = -1;
+    limit         = DEFAULT_LIMIT;
+}
+
+void Timeline::setLimit(size_t limit)
+{
+    this->limit = limit;
+}
+
+size_t Timeline::getLimit()
+{
+    return limit;
+}
+
+void Timeline::start(shared_ptr<GameVersion> first)
+{
+    // Sized here once; undo can't go back further than limit versions, so neither can redo.
+    versions.assign(limit, nullptr);
+    redoSteps.clear();
+    redoSteps.reserve(limit);
+    count         = 0;
+    firstNumber   = 0;
+    currentNumber = -1;
+    if (first != nullptr && limit > 0) {
+        first->number = 0;
+        first->parent = -1;
+        versions[0]   = first;
+        count         = 1;
+        currentNumber = 0;
+    }
+}
+
+void Timeline::add(shared_ptr<GameVersion> version)
+{
+    version->number = firstNumber + count;
+    version->parent = currentNumber;
+    currentNumber   = version->number;
+    redoSteps.clear();
+
+    // The new version takes the oldest one's slot when they're all in use. The current
+    // version is the newest, so it's never the one dropped.
+    if (count == limit) {
+        firstNumber++;
+        count--;
+    }
+    versions[version->number % limit] = version;
+    count++;
+}
+
+const GameVersion *Timeline::current()
+{
+    return find(currentNumber);
+}
+
+const GameVersion *Timeline::find(long number)
+{
+    if (number < firstNumber || number >= firstNumber + (long) count) {
+        return nullptr;
+    }
+    return versions[number % limit].get();
+}
+
+const GameVersion *Timeline::undo()
+{
+    const GameVersion *parent = find(current()->parent);
+    if (parent != nullptr) {
+        redoSteps.push_back(currentNumber);
+        currentNumber = parent->number;
+    }
+    return parent;
+}
+
+const GameVersion *Timeline::redo()
+{
+    if (redoSteps.empty() || find(redoSteps.back()) == nullptr) {
+        return nullptr;
+    }
+    currentNumber = redoSteps.back();
+    redoSteps.pop_back();
+    return current();
+}
+
+const GameVersion *Timeline::branch(long number)
+{
+    const GameVersion *target = find(number);
+    if (target != nullptr) {
+        redoSteps.clear();
+        currentNumber = number;
+    }
+    return target;
+}
+
+long Timeline::oldest()
+{
+    return firstNumber;
+}
+
+long Timeline::newest()
+{
+    return firstNumber + count - 1;
+}
+
+const vector<long> &Timeline::getRedoSteps()
+{
+    return redoSteps;
+}
+
+bool Timeline::restore(const vector<shared_ptr<GameVersion>> &saved, long current, const vector<long> &redo)
+{
+    size_t skip = saved.size() > limit ? saved.size() - limit : 0;
+    if (saved.size() == skip || current < saved[skip]->number || current > saved.back()->number) {
+        return false;
+    }
+    start(nullptr);
+    for (size_t i = skip; i < saved.size(); i++) {
+        versions[saved[i]->number % limit] = saved[i];
+    }
+    firstNumber   = saved[skip]->number;
+    count         = saved.size() - skip;
+    currentNumber = current;
+    redoSteps.assign(redo.begin(), redo.end());
+    return true;
+}
+
+//timelinelistener.cpp
+TimelineListener::TimelineListener(Game *game)
+{
+    this->game = game;
+}
+
+void TimelineListener::run(void *args_ptr)
+{
+    vector<string> *args = (vector<string> *) args_ptr;
+
+    // Unlike the other commands these work after the game is over: undoing the last
+    // move is how you take back a defeat.
+    if (args->at(0) == "undo") {
+        game->undo();
+    } else if (args->at(0) == "redo") {
+        game->redo();
+    } else if (args->size() > 1) {
+        game->branch(atol(args->at(1).c_str()));
+    } else {
+        console() << "Need to choose a version to branch from!" << endl;
+    }
+}
+
+//uselistener.cpp 
+UseListener::UseListener(Game *game)
+{
+    this->game = game;
+    itemName = "";
+}
+
+void UseListener::run(void *args_ptr)
+{
+    if (game->is_over()) {
+        return;
+    }
+
+    vector<string> *args = (vector<string> *) args_ptr;
+
+    if (args->size() > 1) {
+        game->use(args->at(1));
+    } else {
+        console() << "Need to choose an item to use!" << endl;
+    }
+}
+
+//victorylistener.cpp
+VictoryListener::VictoryListener(Game *game)
+{
+    this->game = game;
+}
+
+void VictoryListener::run(void *)
+{
+    console() << endl;
+    console() << "Victory!" << endl;
+    game->setOver(true);
+}
+
+//weapon.cpp
+//2. Inheritance (including virtual methods) and cascading constructors
+//9. Initializer list
+Weapon::Weapon(string inDescription, float inWeightGrams, int multiplier) : Item(inDescription, inWeightGrams, multiplier) {
+	
+}
+
+//7. Virtual functions and polymorphism
+//10. Dynamic and static dispatch
+void Weapon::formatLongDescription(string &out)
+{
+    char weight[32];
+    char number[16];
+    char *numberEnd = to_chars(number, number + sizeof(number), multiplier).ptr;
+    out += description;
+    out += ", is a weapon, weight: ";
+    out += formatWeight(weight);
+    out += "g, multiplier: ";
+    out.append(number, numberEnd);
+    out += '\n';
+}
+
+//worldgenerator.cpp
+namespace {
+
+// Every random choice is a hash of (seed, room, what's being decided), so any thread
+// can make any room's choices and always get the same answer.
+uint64_t generatorHash(uint64_t seed, uint64_t index, uint64_t stream)
+{
+    uint64_t x = seed * 0x9e3779b97f4a7c15ull ^ (index + stream * 0xd1b54a32d192ed03ull);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+double generatorChance(uint64_t seed, uint64_t index, uint64_t stream)
+{
+    return (generatorHash(seed, index, stream) >> 11) * 0x1.0p-53;
+}
+
+enum Stream { MAZE_CHOICE = 1, SHORTCUT, PERMUTATION, LOCKED_ROOM_CHOICE, KEY_CHOICE, ITEM_CHOICE, WEAPON_CHOICE, ENEMY_CHOICE };
+enum Direction { NORTH, EAST, SOUTH, WEST };
+
+// Splits [0, count) into one slice per thread and runs work(begin, end) on each.
+template <typename Work>
+void parallelFor(long count, int threads, Work work)
+{
+    if (threads <= 1 || count < 4096) {
+        work(0, count);
+        return;
+    }
+    vector<thread> workers;
+    long slice = (count + threads - 1) / threads;
+    for (long begin = 0; begin < count; begin += slice) {
+        workers.push_back(thread(work, begin, min(count, begin + slice)));
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+// A random-looking bijection on [0, size): a small Feistel network over the next even
+// power of two, walking the cycle until the result lands back inside the range.
+struct Permutation
+{
+    uint64_t seed;
+    uint64_t size;
+    int      halfBits;
+
+    Permutation(uint64_t seed, uint64_t size) : seed(seed), size(size)
+    {
+        int bits = 2;
+        while ((1ull << bits) < size) {
+            bits += 2;
+        }
+        halfBits = bits / 2;
+    }
+
+    uint64_t operator()(uint64_t value) const
+    {
+        uint64_t mask = (1ull << halfBits) - 1;
+        do {
+            uint64_t left = value >> halfBits, right = value & mask;
+            for (int round = 0; round < 4; round++) {
+                uint64_t next = left ^ (generatorHash(seed, right, PERMUTATION + round * 16) & mask);
+                left  = right;
+                right = next;
+            }
+            value = (left << halfBits) | right;
+        } while (value >= size);
+        return value;
+    }
+};
+
+void link(vector<int32_t> &exits, long from, int direction, long to)
+{
+    exits[from * 4 + direction] = to;
+}
+
+} // namespace
+
+GeneratedWorld generateWorld(const GeneratorSettings &settings)
+{
+    GeneratedWorld world;
+    long n = max(2L, settings.rooms);
+    int threads = settings.threads > 0 ? settings.threads : max(1u, thread::hardware_concurrency());
+    uint64_t seed = settings.seed;
+
+    world.numberOfRooms = n;
+    world.start   = 0;
+    world.victory = n - 1;
+    world.exits.assign(n * 4, -1);
+    world.flags.assign(n, 0);
+
+    // Grids and mazes are laid out row by row; the last row may be partly filled.
+    long width = (long) ceil(sqrt((double) n));
+
+    parallelFor(n, threads, [&](long begin, long end) {
+        for (long i = begin; i < end; i++) {
+            long column = i % width;
+            bool hasNorth = i >= width;
+            bool hasWest  = column > 0;
+
+            if (settings.shape == GeneratorSettings::GRID) {
+                if (hasNorth)                               link(world.exits, i, NORTH, i - width);
+                if (hasWest)                                link(world.exits, i, WEST, i - 1);
+                if (i + width < n)                          link(world.exits, i, SOUTH, i + width);
+                if (column + 1 < width && i + 1 < n)        link(world.exits, i, EAST, i + 1);
+            } else if (settings.shape == GeneratorSettings::MAZE) {
+                // Binary-tree maze: every room but the first opens north or west, which makes
+                // a spanning tree. Each room also writes the matching exit of the neighbour it
+                // opens into; no other room ever writes that slot.
+                if (!hasNorth && !hasWest) {
+                    continue;
+                }
+                bool north = hasNorth && (!hasWest || generatorHash(seed, i, MAZE_CHOICE) & 1);
+                if (north) {
+                    link(world.exits, i, NORTH, i - width);
+                    link(world.exits, i - width, SOUTH, i);
+                } else {
+                    link(world.exits, i, WEST, i - 1);
+                    link(world.exits, i - 1, EAST, i);
+                }
+            } else {
+                // Small world: a ring through east/west keeps everything connected ...
+                link(world.exits, i, EAST, (i + 1) % n);
+                link(world.exits, i, WEST, (i + n - 1) % n);
+            }
+        }
+    });
+
+    if (settings.shape == GeneratorSettings::SMALL_WORLD) {
+        // ... and north/south shortcuts join random pairs. Pairs come from a random
+        // permutation, so every room is in exactly one pair and no two threads touch the same room.
+        Permutation permutation(seed, n);
+        parallelFor(n / 2, threads, [&](long begin, long end) {
+            for (long pair = begin; pair < end; pair++) {
+                if (generatorChance(seed, pair, SHORTCUT) >= settings.shortcutDensity) {
+                    continue;
+                }
+                long a = permutation(2 * pair), b = permutation(2 * pair + 1);
+                link(world.exits, a, NORTH, b);
+                link(world.exits, b, SOUTH, a);
+            }
+        });
+    }
+
+    parallelFor(n, threads, [&](long begin, long end) {
+        for (long i = begin; i < end; i++) {
+            uint8_t flag = 0;
+            if (i != world.start && i != world.victory && generatorChance(seed, i, LOCKED_ROOM_CHOICE) < settings.lockedDensity) {
+                flag |= GeneratedWorld::LOCKED;
+            }
+            if (generatorChance(seed, i, KEY_CHOICE) < settings.keyDensity)       flag |= GeneratedWorld::KEY;
+            if (generatorChance(seed, i, ITEM_CHOICE) < settings.itemDensity)     flag |= GeneratedWorld::ITEM;
+            if (generatorChance(seed, i, WEAPON_CHOICE) < settings.weaponDensity) flag |= GeneratedWorld::WEAPON;
+            if (generatorChance(seed, i, ENEMY_CHOICE) < settings.enemyDensity)   flag |= GeneratedWorld::ENEMY;
+            world.flags[i] = flag;
+        }
+    });
+
+    // Keep victory reachable: find a shortest path from the start (ignoring locks) and
+    // unlock every room on it.
+    vector<int32_t> parent(n, -1);
+    vector<int32_t> queue;
+    queue.reserve(n);
+    parent[world.start] = world.start;
+    queue.push_back(world.start);
+    for (size_t head = 0; head < queue.size() && parent[world.victory] < 0; head++) {
+        long room = queue[head];
+        for (int direction = 0; direction < 4; direction++) {
+            int32_t next = world.exits[room * 4 + direction];
+            if (next >= 0 && parent[next] < 0) {
+                parent[next] = room;
+                queue.push_back(next);
+            }
+        }
+    }
+    for (long room = world.victory; room != world.start; room = parent[room]) {
+        world.flags[room] &= ~GeneratedWorld::LOCKED;
+    }
+
+    return world;
+}
+
+bool GeneratedWorld::victoryReachable() const
+{
+    vector<bool> seen(numberOfRooms, false);
+    vector<int32_t> queue;
+    seen[start] = true;
+    queue.push_back(start);
+    for (size_t head = 0; head < queue.size(); head++) {
+        long room = queue[head];
+        if (room == victory) {
+            return true;
+        }
+        for (int direction = 0; direction < 4; direction++) {
+            int32_t next = exits[room * 4 + direction];
+            if (next >= 0 && !seen[next] && !(flags[next] & LOCKED)) {
+                seen[next] = true;
+                queue.push_back(next);
+            }
+        }
+    }
+    return false;
+}
+
+uint64_t GeneratedWorld::checksum() const
+{
+    // FNV-1a over the exits and flags.
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (int32_t exit : exits) {
+        hash = (hash ^ (uint32_t) exit) * 0x100000001b3ull;
+    }
+    for (uint8_t flag : flags) {
+        hash = (hash ^ flag) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void GeneratedWorld::instantiate(vector<Room *> &rooms, vector<Item *> &items, vector<Enemy *> &enemies) const
+{
+    size_t first = rooms.size();
+    rooms.reserve(first + numberOfRooms);
+    for (long i = 0; i < numberOfRooms; i++) {
+        rooms.push_back(new Room("R" + to_string(i), SymbolTable::NO_SYMBOL));
+    }
+
+    for (long i = 0; i < numberOfRooms; i++) {
+        Room *room = rooms[first + i];
+        room->index = first + i;
+        for (int direction = 0; direction < 4; direction++) {
+            int32_t target = exits[i * 4 + direction];
+            room->exits[direction] = target < 0 ? nullptr : rooms[first + target];
+        }
+
+        uint8_t flag = flags[i];
+        if (flag & KEY) {
+            items.push_back(new Item("key", 27));
+            room->addItem(items.back());
+        }
+        if (flag & ITEM) {
+            items.push_back(new Item("potion", 10.25));
+            room->addItem(items.back());
+        }
+        if (flag & WEAPON) {
+            items.push_back(new Weapon("sword", 150, 5));
+            room->addItem(items.back());
+        }
+        if (flag & ENEMY) {
+            enemies.push_back(new Enemy("stationary-man", "is a non-moving enemy"));
+            room->addEnemy(enemies.back());
+        }
+    }
+}
+
+void GeneratedWorld::populate(EntityStore &store) const
+{
+    long count = 0;
+    for (uint8_t flag : flags) {
+        count += __builtin_popcount(flag & (KEY | ITEM | WEAPON | ENEMY));
+    }
+    store.reserve(store.size() + count);
+
+    for (long i = 0; i < numberOfRooms; i++) {
+        uint8_t flag = flags[i];
+        if (flag & KEY) {
+            store.createItem(i, 27, 0, EntityStore::KEY);
+        }
+        if (flag & ITEM) {
+            store.createItem(i, 10.25, 0, EntityStore::CONSUMABLE);
+        }
+        if (flag & WEAPON) {
+            store.createItem(i, 150, 5, 0);
+        }
+        if (flag & ENEMY) {
+            store.createEnemy(i, 100, 100);
+        }
+    }
+}
+
+bool runGenerator(const GeneratorSettings &settings, bool instantiate, int ticks, const string &persistPath, bool reorder)
+{
+    const char *shapes[] = {"grid", "maze", "small-world"};
+
+    auto start = chrono::steady_clock::now();
+    GeneratedWorld world = generateWorld(settings);
+    double generated = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    long locked = 0, keys = 0, items = 0, enemies = 0;
+    for (uint8_t flag : world.flags) {
+        locked  += (flag & GeneratedWorld::LOCKED) != 0;
+        keys    += (flag & GeneratedWorld::KEY) != 0;
+        items   += (flag & (GeneratedWorld::ITEM | GeneratedWorld::WEAPON)) != 0;
+        enemies += (flag & GeneratedWorld::ENEMY) != 0;
+    }
+
+    start = chrono::steady_clock::now();
+    bool reachable = world.victoryReachable();
+    double checked = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << shapes[settings.shape] << " world, " << world.numberOfRooms << " rooms, seed " << settings.seed << endl;
+    cout << "Generated in " << generated << "s, checksum " << hex << world.checksum() << dec << endl;
+    cout << "Locked rooms: " << locked << ", keys: " << keys << ", rooms with items: " << items
+         << ", rooms with enemies: " << enemies << endl;
+    cout << "Victory reachable: " << (reachable ? "yes" : "NO") << " (checked in " << checked << "s)" << endl;
+
+    start = chrono::steady_clock::now();
+    RoomGraph graph = RoomGraph::fromWorld(world);
+    GraphProblems problems = graph.validate();
+    double validated = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Room graph: " << (double) graph.bytes() / world.numberOfRooms << " bytes per room as CSR, "
+         << (double) (world.exits.size() * sizeof(int32_t) + world.flags.size()) / world.numberOfRooms
+         << " as four exits per room" << endl;
+    cout << "Validated in " << validated << "s: " << problems.danglingExits << " dangling exits (first in room "
+         << problems.firstDangling << "), " << problems.asymmetricLinks << " asymmetric links (first in room "
+         << problems.firstAsymmetric << "), " << problems.unreachableRooms << " unreachable rooms (first "
+         << problems.firstUnreachable << ")" << endl;
+
+    if (reorder) {
+        double distance = graph.meanLinkDistance();
+        start = chrono::steady_clock::now();
+        bool reordered = graph.reorder();
+        double renumbered = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (reordered) {
+            graph.toWorld(world);
+            cout << "Reordered in " << renumbered << "s, mean distance between linked rooms "
+                 << distance << " -> " << graph.meanLinkDistance() << endl;
+        } else {
+            cout << "Kept the generated order, its linked rooms are already closer (" << distance
+                 << " apart on average; checked in " << renumbered << "s)" << endl;
+        }
+    }
+
+    if (instantiate) {
+        vector<Room *> rooms;
+        vector<Item *> allItems;
+        vector<Enemy *> allEnemies;
+
+        // Enemies announce themselves when created; nobody needs millions of those lines.
+        EventManager::getInstance().mute();
+        long before = MemoryTracker::totalLiveBytes();
+        start = chrono::steady_clock::now();
+        world.instantiate(rooms, allItems, allEnemies);
+        double built = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Built " << rooms.size() << " Room objects in " << built << "s ("
+             << (double) (MemoryTracker::totalLiveBytes() - before) / rooms.size()
+             << " bytes per room, with its items and enemies)" << endl;
+
+        for (auto item : allItems) {
+            delete item;
+        }
+        for (auto enemy : allEnemies) {
+            delete enemy;
+        }
+        for (auto room : rooms) {
+            delete room;
+        }
+    }
+
+    if (ticks > 0) {
+        EntityStore store;
+        start = chrono::steady_clock::now();
+        world.populate(store);
+        double populated = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Stored " << store.size() << " entities in " << populated << "s" << endl;
+
+        // Each move costs the same stamina mojo pays, so enemies start dying after 25 ticks.
+        long alive = 0;
+        start = chrono::steady_clock::now();
+        for (int tick = 0; tick < ticks; tick++) {
+            alive = store.wander(world.exits, settings.seed, tick, 4);
+        }
+        double moved = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << ticks << " ticks in " << moved << "s (" << moved * 1e9 / ticks / max<size_t>(1, store.size())
+             << " ns per entity per tick), " << alive << " enemies still alive" << endl;
+    }
+
+    if (!persistPath.empty()) {
+        PersistentWorld persistent;
+        start = chrono::steady_clock::now();
+        if (!persistent.create(persistPath, world, settings.seed)) {
+            return false;
+        }
+        double written = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Wrote " << persistPath << " (" << persistent.getHeader()->fileSize / (1024 * 1024)
+             << " MB) in " << written << "s" << endl;
+    }
+    return reachable && problems.ok();
+}
+
+//persistentworld.cpp
+namespace {
+
+const char WORLD_MAGIC[8] = "ZORKWLD";
+
+// Where each array goes in the file: one after another, each 64-byte aligned.
+size_t placeArray(size_t &used, size_t bytes)
+{
+    size_t at = (used + 63) / 64 * 64;
+    used = at + bytes;
+    return at;
+}
+
+} // namespace
+
+PersistentWorld::PersistentWorld()
+{
+    fd         = -1;
+    header     = nullptr;
+    mappedSize = 0;
+}
+
+PersistentWorld::~PersistentWorld()
+{
+    if (header != nullptr) {
+        munmap(header, mappedSize);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool PersistentWorld::map(size_t size, bool writable)
+{
+    void *memory = mmap(nullptr, size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        cerr << "Could not map the world file: " << strerror(errno) << endl;
+        return false;
+    }
+    header     = (PersistentWorldHeader *) memory;
+    mappedSize = size;
+    return true;
+}
+
+bool PersistentWorld::create(const string &path, const GeneratedWorld &world, uint32_t seed)
+{
+    EntityStore store;
+    world.populate(store);
+    size_t rooms = world.numberOfRooms, count = store.size();
+
+    size_t used = sizeof(PersistentWorldHeader);
+    size_t exitsAt      = placeArray(used, rooms * 4 * sizeof(int32_t));
+    size_t roomFlagsAt  = placeArray(used, rooms);
+    size_t positionAt   = placeArray(used, count * sizeof(int32_t));
+    size_t healthAt     = placeArray(used, count * sizeof(int32_t));
+    size_t staminaAt    = placeArray(used, count * sizeof(int32_t));
+    size_t weightAt     = placeArray(used, count * sizeof(float));
+    size_t multiplierAt = placeArray(used, count * sizeof(int32_t));
+    size_t flagsAt      = placeArray(used, count);
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, used) < 0) {
+        cerr << "Could not create " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    if (!map(used, true)) {
+        return false;
+    }
+
+    char *base = (char *) header;
+    memcpy(header->magic, WORLD_MAGIC, sizeof(WORLD_MAGIC));
+    header->version          = PersistentWorldHeader::VERSION;
+    header->seed             = seed;
+    header->fileSize         = used;
+    header->numberOfRooms    = rooms;
+    header->start            = world.start;
+    header->victory          = world.victory;
+    header->numberOfEntities = count;
+    header->tick             = 0;
+
+    header->exits       = (int32_t *) (base + exitsAt);
+    header->roomFlags   = (uint8_t *) (base + roomFlagsAt);
+    header->position    = (int32_t *) (base + positionAt);
+    header->health      = (int32_t *) (base + healthAt);
+    header->stamina     = (int32_t *) (base + staminaAt);
+    header->weight      = (float *)   (base + weightAt);
+    header->multiplier  = (int32_t *) (base + multiplierAt);
+    header->entityFlags = (uint8_t *) (base + flagsAt);
+
+    memcpy(header->exits.get(),       world.exits.data(),      rooms * 4 * sizeof(int32_t));
+    memcpy(header->roomFlags.get(),   world.flags.data(),      rooms);
+    memcpy(header->position.get(),    store.position.data(),   count * sizeof(int32_t));
+    memcpy(header->health.get(),      store.health.data(),     count * sizeof(int32_t));
+    memcpy(header->stamina.get(),     store.stamina.data(),    count * sizeof(int32_t));
+    memcpy(header->weight.get(),      store.weight.data(),     count * sizeof(float));
+    memcpy(header->multiplier.get(),  store.multiplier.data(), count * sizeof(int32_t));
+    memcpy(header->entityFlags.get(), store.flags.data(),      count);
+    return checkpoint();
+}
+
+bool PersistentWorld::open(const string &path)
+{
+    fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) < 0) {
+        cerr << "Could not open " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    if ((size_t) status.st_size < sizeof(PersistentWorldHeader) || !map(status.st_size, true)) {
+        cerr << path << " is too small to be a world file" << endl;
+        return false;
+    }
+    if (memcmp(header->magic, WORLD_MAGIC, sizeof(WORLD_MAGIC)) != 0
+        || header->version != PersistentWorldHeader::VERSION || header->fileSize != status.st_size) {
+        cerr << path << " isn't a world file, or was written by another version" << endl;
+        return false;
+    }
+
+    // Everything else the file says is checked before anything follows it: a damaged count
+    // or offset must not send a tick outside the mapping.
+    int64_t size = header->fileSize, rooms = header->numberOfRooms, count = header->numberOfEntities;
+    bool inside = rooms > 0 && rooms <= size && count >= 0 && count <= size
+               && header->start >= 0 && header->start < rooms && header->victory >= 0 && header->victory < rooms
+               && header->exits.fits(header, size, rooms * 4) && header->roomFlags.fits(header, size, rooms)
+               && header->position.fits(header, size, count) && header->health.fits(header, size, count)
+               && header->stamina.fits(header, size, count) && header->weight.fits(header, size, count)
+               && header->multiplier.fits(header, size, count) && header->entityFlags.fits(header, size, count);
+    for (int64_t i = 0; inside && i < rooms * 4; i++) {
+        inside = header->exits[i] >= -1 && header->exits[i] < rooms;
+    }
+    for (int64_t i = 0; inside && i < count; i++) {
+        // Only enemies move, and they move from the room they're in.
+        int32_t lowest = header->entityFlags[i] & EntityStore::ENEMY ? 0 : EntityStore::CARRIED;
+        inside = header->position[i] >= lowest && header->position[i] < rooms;
+    }
+    if (!inside) {
+        cerr << path << " is damaged: its sizes, offsets, exits or positions point outside the world" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool PersistentWorld::checkpoint()
+{
+    if (msync(header, mappedSize, MS_SYNC) < 0) {
+        cerr << "Could not write the world back: " << strerror(errno) << endl;
+        return false;
+    }
+    return true;
+}
+
+long PersistentWorld::tick(int staminaCost)
+{
+    // Counted only once every enemy has moved, so a tick cut short isn't taken as done.
+    long alive = EntityStore::wander(entities(), header->exits.get(), header->seed, header->tick, staminaCost);
+    header->tick++;
+    return alive;
+}
+
+PersistentWorldHeader *PersistentWorld::getHeader()
+{
+    return header;
+}
+
+EntityColumns PersistentWorld::entities()
+{
+    return {header->position.get(), header->health.get(), header->stamina.get(), header->weight.get(),
+            header->multiplier.get(), header->entityFlags.get(), (size_t) header->numberOfEntities};
+}
+
+bool runPersistentWorld(const string &path, long ticks, long checkpointEvery)
+{
+    PersistentWorld world;
+    auto start = chrono::steady_clock::now();
+    if (!world.open(path)) {
+        return false;
+    }
+    double opened = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    PersistentWorldHeader *header = world.getHeader();
+    cout << "Resumed " << path << " (" << header->fileSize / (1024 * 1024) << " MB, " << header->numberOfRooms
+         << " rooms, " << header->numberOfEntities << " entities) at tick " << header->tick
+         << " in " << opened * 1000 << " ms" << endl;
+
+    long alive = 0;
+    double syncing = 0;
+    start = chrono::steady_clock::now();
+    for (long i = 1; i <= ticks; i++) {
+        alive = world.tick(4);
+        if (checkpointEvery > 0 && i % checkpointEvery == 0) {
+            auto before = chrono::steady_clock::now();
+            if (!world.checkpoint()) {
+                return false;
+            }
+            syncing += chrono::duration<double>(chrono::steady_clock::now() - before).count();
+        }
+    }
+    double ran = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Ran " << ticks << " ticks in " << ran << "s (" << syncing << "s of it in checkpoints), now at tick "
+         << header->tick << " with " << alive << " enemies alive" << endl;
+    return world.checkpoint();
+}
+
+//worldarena.cpp
+WorldArena::WorldArena()
+{
+    used = 0;
+}
+
+void *WorldArena::allocate(size_t size)
+{
+    // Keep every object aligned the way new would.
+    size_t rounded = (size + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+    if (used + rounded > CAPACITY) {
+        throw bad_alloc();
+    }
+    void *pointer = memory + used;
+    used += rounded;
+    return pointer;
+}
+
+void *operator new(size_t size, WorldArena &arena)
+{
+    return arena.allocate(size);
+}
+
+void operator delete(void *, WorldArena &)
+{
+    // Only called if a constructor throws; the space goes with the Game.
+}
+
+// Everything the built-in world places in the arena (with room for rounding), checked
+// here where all the classes are complete.
+static_assert(NUMBER_OF_DEFAULT_ROOMS * (sizeof(Room) + alignof(max_align_t)) +
+              NUMBER_OF_DEFAULT_ITEMS * (sizeof(Weapon) + alignof(max_align_t)) +
+              NUMBER_OF_DEFAULT_ENEMIES * (sizeof(Enemy) + alignof(max_align_t)) +
+              20 * (sizeof(InputListener) + alignof(max_align_t)) <= WorldArena::CAPACITY,
+              "the built-in world doesn't fit in WorldArena::CAPACITY");
+
+//main.cpp
+int main(int argc, char *argv[])
+{
+    // zork --shared-world [players] [commands per player] [--rules file]
+    if (argc > 1 && string(argv[1]) == "--shared-world") {
+        int numberOfPlayers = argc > 2 ? atoi(argv[2]) : 8;
+        int commands = argc > 3 ? atoi(argv[3]) : 100000;
+        string rulesPath;
+        for (int i = 2; i + 1 < argc; i++) {
+            if (string(argv[i]) == "--rules") {
+                rulesPath = argv[i + 1];
+            }
+        }
+        return runSharedWorld(numberOfPlayers, commands, rulesPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --generate <grid|maze|small-world> [rooms] [seed] [threads] [--instantiate] [--reorder] [--simulate ticks] [--persist file]
+    if (argc > 1 && string(argv[1]) == "--generate") {
+        GeneratorSettings settings;
+        string shape = argc > 2 ? argv[2] : "grid";
+        settings.shape   = shape == "maze" ? GeneratorSettings::MAZE :
+                           shape == "small-world" ? GeneratorSettings::SMALL_WORLD : GeneratorSettings::GRID;
+        settings.rooms   = argc > 3 && argv[3][0] != '-' ? atol(argv[3]) : 1000000;
+        settings.seed    = argc > 4 && argv[4][0] != '-' ? strtoul(argv[4], nullptr, 10) : 1;
+        settings.threads = argc > 5 && argv[5][0] != '-' ? atoi(argv[5]) : 0;
+        bool   instantiate = false;
+        bool   reorder     = false;
+        int    ticks       = 0;
+        string persistPath;
+        for (int i = 3; i < argc; i++) {
+            if (string(argv[i]) == "--instantiate") {
+                instantiate = true;
+            } else if (string(argv[i]) == "--reorder") {
+                reorder = true;
+            } else if (string(argv[i]) == "--simulate" && i + 1 < argc) {
+                ticks = atoi(argv[i + 1]);
+            } else if (string(argv[i]) == "--persist" && i + 1 < argc) {
+                persistPath = argv[i + 1];
+            }
+        }
+        return runGenerator(settings, instantiate, ticks, persistPath, reorder) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --shard <grid|maze|small-world> [rooms] [max regions] [ticks] [players]
+    if (argc > 1 && string(argv[1]) == "--shard") {
+        GeneratorSettings settings;
+        string shape = argc > 2 ? argv[2] : "grid";
+        settings.shape = shape == "maze" ? GeneratorSettings::MAZE :
+                         shape == "small-world" ? GeneratorSettings::SMALL_WORLD : GeneratorSettings::GRID;
+        settings.rooms = argc > 3 ? atol(argv[3]) : 1000000;
+        int  regions   = argc > 4 ? atoi(argv[4]) : max(1u, thread::hardware_concurrency());
+        int  ticks     = argc > 5 ? atoi(argv[5]) : 100;
+        long players   = argc > 6 ? atol(argv[6]) : 10000;
+        return runShardedSimulation(settings, regions, ticks, players) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --resume <file> [ticks] [checkpoint every]
+    if (argc > 2 && string(argv[1]) == "--resume") {
+        long ticks           = argc > 3 ? atol(argv[3]) : 10;
+        long checkpointEvery = argc > 4 ? atol(argv[4]) : 5;
+        return runPersistentWorld(argv[2], ticks, checkpointEvery) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --serve <socket> [max sessions] [idle seconds]
+    if (argc > 2 && string(argv[1]) == "--serve") {
+        ServerSettings settings;
+        settings.path = argv[2];
+        if (argc > 3) {
+            settings.maxSessions = atoi(argv[3]);
+        }
+        if (argc > 4) {
+            settings.idleSeconds = atof(argv[4]);
+        }
+        return runServer(settings) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --serve-test [clients]
+    if (argc > 1 && string(argv[1]) == "--serve-test") {
+        return runServerTest(argc > 2 ? atoi(argv[2]) : 200) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --coroutines [sessions] [threads] [switches]
+    if (argc > 1 && string(argv[1]) == "--coroutines") {
+        int  sessions = argc > 2 ? atoi(argv[2]) : 20000;
+        int  threads  = argc > 3 ? atoi(argv[3]) : 1000;
+        long switches = argc > 4 ? atol(argv[4]) : 1000000;
+        return runCoroutineBenchmark(sessions, threads, switches) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --spectate [readers] [commands]
+    if (argc > 1 && string(argv[1]) == "--spectate") {
+        int  readers  = argc > 2 ? atoi(argv[2]) : 4;
+        long commands = argc > 3 ? atol(argv[3]) : 1000000;
+        return runSpectators(readers, commands) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --combat [attacks] [seed]
+    if (argc > 1 && string(argv[1]) == "--combat") {
+        long     pairs = argc > 2 ? atol(argv[2]) : 10000000;
+        uint32_t seed  = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1;
+        return runCombatBenchmark(pairs, seed) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --make-corpus <file> [sessions] [seed]
+    if (argc > 2 && string(argv[1]) == "--make-corpus") {
+        long     sessions = argc > 3 ? atol(argv[3]) : 10000;
+        uint32_t seed     = argc > 4 ? strtoul(argv[4], nullptr, 10) : 1;
+        return writeCorpus(argv[2], sessions, seed) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --bench <script> [rounds]
+    if (argc > 2 && string(argv[1]) == "--bench") {
+        int rounds = argc > 3 ? atoi(argv[3]) : 5;
+        return runBenchmark(argv[2], rounds) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --analyze <output prefix> <files...> [--threads n]
+    if (argc > 3 && string(argv[1]) == "--analyze") {
+        vector<string> paths;
+        int threads = 0;
+        for (int i = 3; i < argc; i++) {
+            if (string(argv[i]) == "--threads" && i + 1 < argc) {
+                threads = atoi(argv[++i]);
+            } else {
+                paths.push_back(argv[i]);
+            }
+        }
+        return runAnalytics(paths, argv[2], threads) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --alloc-check [warm-up commands] [measured commands] [first seed] [seeds]
+    if (argc > 1 && string(argv[1]) == "--alloc-check") {
+        long         warmup   = argc > 2 ? atol(argv[2]) : 10000;
+        long         measured = argc > 3 ? atol(argv[3]) : 100000;
+        unsigned int seed     = argc > 4 ? strtoul(argv[4], nullptr, 10) : 1;
+        int          seeds    = argc > 5 ? atoi(argv[5]) : 32;
+        return runAllocationCheck(warmup, measured, seed, max(seeds, 1)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --timeline-check [commands] [seed]
+    if (argc > 1 && string(argv[1]) == "--timeline-check") {
+        long         commands = argc > 2 ? atol(argv[2]) : 100000;
+        unsigned int seed     = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1;
+        return runTimelineCheck(commands, seed) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --rules-check [file] [events]
+    if (argc > 1 && string(argv[1]) == "--rules-check") {
+        string path   = argc > 2 ? argv[2] : "";
+        long   events = argc > 3 ? atol(argv[3]) : 10000000;
+        return runRulesCheck(path, events) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --soak [seconds] [sessions] [seed]
+    if (argc > 1 && string(argv[1]) == "--soak") {
+        SoakSettings settings;
+        settings.seconds  = argc > 2 ? atof(argv[2]) : 60;
+        settings.sessions = argc > 3 ? atoi(argv[3]) : 1;
+        settings.seed     = argc > 4 ? strtoul(argv[4], nullptr, 10) : time(nullptr);
+        return runSoak(settings) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // zork --journal <file>: log every command, and recover from the file if it exists.
+    // zork --memory-report: print memory use per subsystem (and any leaks) on exit.
+    // zork --json: JSON-lines requests and replies for bots instead of text.
+    // zork --profile: hardware counters per command, printed to stderr on exit.
+    // zork --rules <file>: play by the rules in the file instead of the built-in ones.
+    string journalPath;
+    string rulesPath;
+    bool   json = false;
+    CommandProfiler *profiler = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--journal" && i + 1 < argc) {
+            journalPath = argv[i + 1];
+        } else if (string(argv[i]) == "--memory-report") {
+            MemoryTracker::reportAtExit();
+        } else if (string(argv[i]) == "--json") {
+            json = true;
+        } else if (string(argv[i]) == "--profile" && profiler == nullptr) {
+            profiler = new CommandProfiler();
+        } else if (string(argv[i]) == "--rules" && i + 1 < argc) {
+            rulesPath = argv[i + 1];
+        }
+    }
+
+    // The journal's batching and the JSON mode's pipelining ask cin how much input is
+    // already buffered, which it only knows with a buffer of its own. A plain game keeps
+    // sharing stdio's, rather than allocating six stream buffers for nothing.
+    if (!journalPath.empty() || json) {
+        ios::sync_with_stdio(false);
+    }
+
+    if (json) {
+        // Nothing but replies may reach stdout, not even the welcome text.
+        EventManager::getInstance().mute();
+    }
+    Game game(journalPath.empty());
+    if (!rulesPath.empty()) {
+        ifstream file(rulesPath);
+        string   error;
+        if (!file) {
+            cerr << "Could not read " << rulesPath << endl;
+            return EXIT_FAILURE;
+        }
+        if (!game.loadRules(string(istreambuf_iterator<char>(file), istreambuf_iterator<char>()), error)) {
+            cerr << rulesPath << ", " << error << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // Owned here, so they're freed before the exit report looks for leaks.
+    unique_ptr<InputListener> input(new InputListener(&game));
+    input->setProfiler(profiler);
+    EventManager::getInstance().listen("input", input.get());
+
+    unique_ptr<Journal>         journal;
+    unique_ptr<JournalListener> journalListener;
+    if (!journalPath.empty()) {
+        journal.reset(new Journal(&game, journalPath));
+        if (!journal->open()) {
+            cerr << "Could not open journal " << journalPath << endl;
+            return EXIT_FAILURE;
+        }
+        journalListener.reset(new JournalListener(journal.get()));
+        EventManager::getInstance().listen("input", journalListener.get());
+    }
+
+    if (json) {
+        ProtocolServer server(&game, cin, cout);
+        server.run();
+    } else {
+        EventManager::getInstance().event_loop();
+    }
+    if (profiler != nullptr) {
+        profiler->report(cerr);
+        delete profiler;
+    }
+    return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,3 @@
+for f in *.cpp; do
+  ( out=$(g++ -std=c++20 -Wall -O0 -fsyntax-only $f 2>&1 | grep -E "warning|error" | head -3); echo "$f: ${out:-OK}" ) &
+done; wait